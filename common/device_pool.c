@@ -0,0 +1,206 @@
+#include "device_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void pool_init(DevicePool* pool, cl_context context, cl_device_id device_id, size_t block_size)
+{
+    cl_uint align_bits = 0;
+    cl_ulong max_alloc = 0;
+
+    memset(pool, 0, sizeof(DevicePool));
+    pool->context = context;
+    pool->enabled = block_size > 0;
+
+    clGetDeviceInfo(device_id, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(align_bits), &align_bits, NULL);
+    clGetDeviceInfo(device_id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc), &max_alloc, NULL);
+
+    pool->alignment = align_bits >= 8 ? align_bits / 8 : 128;
+    pool->block_size = block_size;
+    if (max_alloc > 0 && pool->block_size > max_alloc) {
+        pool->block_size = (size_t)max_alloc;
+    }
+}
+
+size_t pool_size_class(size_t size)
+{
+    if (size <= POOL_MIN_CLASS_SIZE) {
+        return POOL_MIN_CLASS_SIZE;
+    }
+    size_t power = POOL_MIN_CLASS_SIZE;
+    while (power * 2 <= size) {
+        power *= 2;
+    }
+    size_t step = power / 4;
+    return (size + step - 1) / step * step;
+}
+
+static DevicePoolEntry* new_entry(DevicePool* pool)
+{
+    if (pool->count == pool->capacity) {
+        int capacity = pool->capacity == 0 ? 16 : pool->capacity * 2;
+        DevicePoolEntry* entries = (DevicePoolEntry*)realloc(pool->entries, sizeof(DevicePoolEntry) * capacity);
+        if (entries == NULL) {
+            return NULL;
+        }
+        pool->entries = entries;
+        pool->capacity = capacity;
+    }
+    DevicePoolEntry* entry = &pool->entries[pool->count++];
+    memset(entry, 0, sizeof(DevicePoolEntry));
+    return entry;
+}
+
+static DevicePoolBlock* find_block(DevicePool* pool, size_t size, size_t* offset)
+{
+    for (int i = 0; i < pool->block_count; i++) {
+        DevicePoolBlock* block = &pool->blocks[i];
+        size_t start = (block->used + pool->alignment - 1) / pool->alignment * pool->alignment;
+        if (start + size <= block->size) {
+            *offset = start;
+            return block;
+        }
+    }
+
+    if (pool->block_count == pool->block_capacity) {
+        int capacity = pool->block_capacity == 0 ? 4 : pool->block_capacity * 2;
+        DevicePoolBlock* blocks = (DevicePoolBlock*)realloc(pool->blocks, sizeof(DevicePoolBlock) * capacity);
+        if (blocks == NULL) {
+            return NULL;
+        }
+        pool->blocks = blocks;
+        pool->block_capacity = capacity;
+    }
+
+    cl_int err;
+    cl_mem mem = clCreateBuffer(pool->context, CL_MEM_READ_WRITE, pool->block_size, NULL, &err);
+    if (err != CL_SUCCESS) {
+        return NULL;
+    }
+    pool->create_count++;
+    pool->reserved_bytes += pool->block_size;
+
+    DevicePoolBlock* block = &pool->blocks[pool->block_count++];
+    block->mem = mem;
+    block->size = pool->block_size;
+    block->used = 0;
+    *offset = 0;
+    return block;
+}
+
+cl_mem pool_acquire(DevicePool* pool, size_t size, cl_int* err)
+{
+    size_t class_size = pool->enabled ? pool_size_class(size) : size;
+    DevicePoolEntry* entry;
+
+    pool->acquire_count++;
+
+    if (pool->enabled) {
+        for (int i = 0; i < pool->count; i++) {
+            if (!pool->entries[i].in_use && pool->entries[i].size == class_size) {
+                entry = &pool->entries[i];
+                entry->in_use = 1;
+                pool->reuse_count++;
+                pool->current_bytes += class_size;
+                if (pool->current_bytes > pool->peak_bytes) {
+                    pool->peak_bytes = pool->current_bytes;
+                }
+                *err = CL_SUCCESS;
+                return entry->mem;
+            }
+        }
+    }
+
+    entry = new_entry(pool);
+    if (entry == NULL) {
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return NULL;
+    }
+
+    size_t offset = 0;
+    DevicePoolBlock* block = NULL;
+    if (pool->enabled && class_size <= pool->block_size) {
+        block = find_block(pool, class_size, &offset);
+    }
+
+    if (block != NULL) {
+        cl_buffer_region region = {offset, class_size};
+        entry->mem = clCreateSubBuffer(block->mem, CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &region, err);
+        if (*err != CL_SUCCESS) {
+            pool->count--;
+            return NULL;
+        }
+        entry->parent = block->mem;
+        entry->offset = offset;
+        block->used = offset + class_size;
+    } else {
+        entry->mem = clCreateBuffer(pool->context, CL_MEM_READ_WRITE, class_size, NULL, err);
+        if (*err != CL_SUCCESS) {
+            pool->count--;
+            return NULL;
+        }
+        pool->create_count++;
+        pool->reserved_bytes += class_size;
+    }
+
+    entry->size = class_size;
+    entry->in_use = 1;
+    pool->current_bytes += class_size;
+    if (pool->current_bytes > pool->peak_bytes) {
+        pool->peak_bytes = pool->current_bytes;
+    }
+    return entry->mem;
+}
+
+void pool_release(DevicePool* pool, cl_mem mem)
+{
+    for (int i = 0; i < pool->count; i++) {
+        DevicePoolEntry* entry = &pool->entries[i];
+        if (entry->mem != mem || !entry->in_use) {
+            continue;
+        }
+        pool->current_bytes -= entry->size;
+        if (pool->enabled) {
+            entry->in_use = 0;
+        } else {
+            clReleaseMemObject(entry->mem);
+            pool->reserved_bytes -= entry->size;
+            pool->entries[i] = pool->entries[--pool->count];
+        }
+        return;
+    }
+}
+
+int pool_view(const DevicePool* pool, cl_mem mem, cl_mem* parent, size_t* offset)
+{
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->entries[i].mem == mem) {
+            *parent = pool->entries[i].parent != NULL ? pool->entries[i].parent : mem;
+            *offset = pool->entries[i].offset;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void pool_print_stats(const DevicePool* pool, const char* label)
+{
+    printf("%s: %lu acquires, %lu reused, %lu clCreateBuffer calls, current %.1f MB, peak %.1f MB, reserved %.1f MB\n",
+           label, pool->acquire_count, pool->reuse_count, pool->create_count,
+           pool->current_bytes / 1048576.0, pool->peak_bytes / 1048576.0, pool->reserved_bytes / 1048576.0);
+}
+
+void pool_destroy(DevicePool* pool)
+{
+    // Sub-buffers first, then the blocks they were carved from.
+    for (int i = 0; i < pool->count; i++) {
+        clReleaseMemObject(pool->entries[i].mem);
+    }
+    for (int i = 0; i < pool->block_count; i++) {
+        clReleaseMemObject(pool->blocks[i].mem);
+    }
+    free(pool->entries);
+    free(pool->blocks);
+    memset(pool, 0, sizeof(DevicePool));
+}
@@ -0,0 +1,104 @@
+#ifndef DEVICE_POOL_H
+#define DEVICE_POOL_H
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+#define POOL_DEFAULT_BLOCK_SIZE ((size_t)256 * 1024 * 1024)
+#define POOL_MIN_CLASS_SIZE ((size_t)4096)
+
+/**
+ * One handed-out region: a sub-buffer of a block, or a dedicated buffer
+ * when the request does not fit in a block (parent == NULL).
+ */
+typedef struct {
+    cl_mem mem;
+    cl_mem parent;
+    size_t offset;
+    size_t size;
+    int in_use;
+} DevicePoolEntry;
+
+typedef struct {
+    cl_mem mem;
+    size_t size;
+    size_t used;
+} DevicePoolBlock;
+
+/**
+ * Device memory arena. Large blocks are allocated once and split into
+ * aligned sub-buffers; released regions are kept and reused by later
+ * requests of the same size class.
+ *
+ * A released sub-buffer is only handed out again for a request of exactly
+ * its size class; it is never split or merged with its neighbours. Block
+ * space is not reclaimed either: a block only grows its used offset, so
+ * under a mix of sizes that do not repeat, reserved_bytes keeps growing
+ * until pool_destroy. Callers with such patterns should pool_destroy and
+ * pool_init between phases.
+ *
+ * With block_size == 0 the pool is disabled: every acquire calls
+ * clCreateBuffer and every release frees the buffer, but the statistics
+ * are still collected so the two modes can be compared.
+ */
+typedef struct {
+    cl_context context;
+    int enabled;
+    size_t alignment;
+    size_t block_size;
+
+    DevicePoolBlock* blocks;
+    int block_count;
+    int block_capacity;
+
+    DevicePoolEntry* entries;
+    int count;
+    int capacity;
+
+    size_t current_bytes;
+    size_t peak_bytes;
+    size_t reserved_bytes;
+    unsigned long acquire_count;
+    unsigned long reuse_count;
+    unsigned long create_count;
+} DevicePool;
+
+/**
+ * device_id: Used for the sub-buffer alignment and the maximal block size
+ * block_size: Size of the pre-allocated blocks, 0 disables pooling
+ */
+void pool_init(DevicePool* pool, cl_context context, cl_device_id device_id, size_t block_size);
+
+/**
+ * Return a free region of at least size bytes, creating one if needed.
+ *
+ * err: CL_SUCCESS or the OpenCL error code
+ */
+cl_mem pool_acquire(DevicePool* pool, size_t size, cl_int* err);
+
+/**
+ * Give the region back to the pool. It stays allocated for reuse.
+ */
+void pool_release(DevicePool* pool, cl_mem mem);
+
+/**
+ * Offset view of a region: the block it lives in and its byte offset.
+ * For kernels that take a base buffer and an offset instead of a sub-buffer.
+ *
+ * Returns 0 when mem does not belong to the pool
+ */
+int pool_view(const DevicePool* pool, cl_mem mem, cl_mem* parent, size_t* offset);
+
+/**
+ * Round a request up to its size class (4 classes per power of two).
+ */
+size_t pool_size_class(size_t size);
+
+void pool_print_stats(const DevicePool* pool, const char* label);
+
+/**
+ * Release every region and block of the pool.
+ */
+void pool_destroy(DevicePool* pool);
+
+#endif
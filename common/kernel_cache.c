@@ -0,0 +1,359 @@
+#include "kernel_cache.h"
+#include "kernel_loader.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <utime.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define make_directory(path) _mkdir(path)
+#else
+#define make_directory(path) mkdir(path, 0755)
+#endif
+
+#define DEFAULT_DISK_CAPACITY 32
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// FNV-1a, only used to name the cached binaries.
+static unsigned long long hash_string(unsigned long long hash, const char* text)
+{
+    if (hash == 0) {
+        hash = 1469598103934665603ULL;
+    }
+    for (; *text; text++) {
+        hash ^= (unsigned char)*text;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+cl_int kernel_cache_init(KernelCache* cache, cl_context context, cl_device_id device_id,
+                         const char* const path, const char* base_options, int capacity, const char* cache_dir)
+{
+    int error_code;
+    char info[256];
+
+    memset(cache, 0, sizeof(KernelCache));
+    cache->context = context;
+    cache->device_id = device_id;
+    cache->capacity = capacity > 0 ? capacity : 1;
+    cache->disk_capacity = DEFAULT_DISK_CAPACITY;
+    cache->min_uses = 2;
+    if (base_options != NULL) {
+        strncpy(cache->base_options, base_options, KERNEL_CACHE_OPTIONS_LENGTH - 1);
+    }
+
+    cache->source = load_kernel_source(path, &error_code);
+    if (error_code != 0) {
+        return CL_INVALID_VALUE;
+    }
+
+    cache->entries = (KernelCacheEntry*)calloc(cache->capacity, sizeof(KernelCacheEntry));
+    if (cache->entries == NULL) {
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+
+    // Binaries are only valid for the same device and driver.
+    cache->device_hash = hash_string(0, cache->source);
+    if (clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(info), info, NULL) == CL_SUCCESS) {
+        cache->device_hash = hash_string(cache->device_hash, info);
+    }
+    if (clGetDeviceInfo(device_id, CL_DRIVER_VERSION, sizeof(info), info, NULL) == CL_SUCCESS) {
+        cache->device_hash = hash_string(cache->device_hash, info);
+    }
+
+    if (cache_dir != NULL) {
+        strncpy(cache->cache_dir, cache_dir, KERNEL_CACHE_OPTIONS_LENGTH - 1);
+        make_directory(cache->cache_dir);
+    }
+    return CL_SUCCESS;
+}
+
+int kernel_cache_should_specialize(KernelCache* cache, const char* options)
+{
+    KernelCacheShape* shape = NULL;
+
+    for (int i = 0; i < cache->shape_count; i++) {
+        if (strcmp(cache->shapes[i].options, options) == 0) {
+            shape = &cache->shapes[i];
+            break;
+        }
+    }
+    if (shape == NULL) {
+        if (cache->shape_count < KERNEL_CACHE_SHAPES) {
+            shape = &cache->shapes[cache->shape_count++];
+        } else {
+            // Forget the rarest shape.
+            shape = &cache->shapes[0];
+            for (int i = 1; i < KERNEL_CACHE_SHAPES; i++) {
+                if (cache->shapes[i].uses < shape->uses) {
+                    shape = &cache->shapes[i];
+                }
+            }
+        }
+        strncpy(shape->options, options, KERNEL_CACHE_OPTIONS_LENGTH - 1);
+        shape->options[KERNEL_CACHE_OPTIONS_LENGTH - 1] = 0;
+        shape->uses = 0;
+    }
+
+    shape->uses++;
+    return shape->uses >= cache->min_uses;
+}
+
+static void binary_path(const KernelCache* cache, const char* options, char* path, size_t size)
+{
+    unsigned long long hash = hash_string(cache->device_hash, cache->base_options);
+    hash = hash_string(hash, "|");
+    hash = hash_string(hash, options);
+    snprintf(path, size, "%s/%016llx.bin", cache->cache_dir, hash);
+}
+
+static cl_int build(KernelCache* cache, cl_program program, const char* options)
+{
+    char all_options[2 * KERNEL_CACHE_OPTIONS_LENGTH + 2];
+    snprintf(all_options, sizeof(all_options), "%s %s", cache->base_options, options);
+
+    cl_int err = clBuildProgram(program, 1, &cache->device_id, all_options, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        size_t log_size;
+        clGetProgramBuildInfo(program, cache->device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+        char* log = (char*)malloc(log_size + 1);
+        clGetProgramBuildInfo(program, cache->device_id, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
+        log[log_size] = 0;
+        printf("Build error (%s)! Code: %d\nBuild log : %s\n", all_options, err, log);
+        free(log);
+    }
+    return err;
+}
+
+static cl_program load_binary(KernelCache* cache, const char* options)
+{
+    char path[2 * KERNEL_CACHE_OPTIONS_LENGTH];
+    binary_path(cache, options, path, sizeof(path));
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    unsigned char* binary = (unsigned char*)malloc(size > 0 ? size : 1);
+    size_t read = fread(binary, 1, size, file);
+    fclose(file);
+
+    cl_int err, status;
+    size_t binary_size = (size_t)size;
+    cl_program program = NULL;
+    if (size > 0 && read == (size_t)size) {
+        program = clCreateProgramWithBinary(cache->context, 1, &cache->device_id, &binary_size,
+                                            (const unsigned char**)&binary, &status, &err);
+        if (err != CL_SUCCESS || status != CL_SUCCESS || build(cache, program, options) != CL_SUCCESS) {
+            if (program != NULL) {
+                clReleaseProgram(program);
+            }
+            program = NULL;
+        }
+    }
+    free(binary);
+
+    if (program == NULL) {
+        remove(path);
+    } else {
+        // The modification time is the disk LRU order.
+        utime(path, NULL);
+    }
+    return program;
+}
+
+static void trim_disk(KernelCache* cache)
+{
+    for (;;) {
+        DIR* dir = opendir(cache->cache_dir);
+        if (dir == NULL) {
+            return;
+        }
+        int files = 0;
+        time_t oldest_time = 0;
+        char oldest[2 * KERNEL_CACHE_OPTIONS_LENGTH + 256] = "";
+        struct dirent* item;
+        while ((item = readdir(dir)) != NULL) {
+            size_t length = strlen(item->d_name);
+            if (length < 4 || strcmp(item->d_name + length - 4, ".bin") != 0) {
+                continue;
+            }
+            char path[2 * KERNEL_CACHE_OPTIONS_LENGTH + 256];
+            struct stat info;
+            snprintf(path, sizeof(path), "%s/%s", cache->cache_dir, item->d_name);
+            if (stat(path, &info) != 0) {
+                continue;
+            }
+            files++;
+            if (oldest[0] == 0 || info.st_mtime < oldest_time) {
+                oldest_time = info.st_mtime;
+                strcpy(oldest, path);
+            }
+        }
+        closedir(dir);
+        if (files <= cache->disk_capacity || oldest[0] == 0) {
+            return;
+        }
+        remove(oldest);
+    }
+}
+
+static void save_binary(KernelCache* cache, cl_program program, const char* options)
+{
+    size_t size = 0;
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size), &size, NULL) != CL_SUCCESS || size == 0) {
+        return;
+    }
+    unsigned char* binary = (unsigned char*)malloc(size);
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binary), &binary, NULL) == CL_SUCCESS) {
+        char path[2 * KERNEL_CACHE_OPTIONS_LENGTH];
+        binary_path(cache, options, path, sizeof(path));
+        FILE* file = fopen(path, "wb");
+        if (file != NULL) {
+            fwrite(binary, 1, size, file);
+            fclose(file);
+        }
+    }
+    free(binary);
+    trim_disk(cache);
+}
+
+static void release_entry(KernelCacheEntry* entry)
+{
+    for (int i = 0; i < entry->kernel_count; i++) {
+        clReleaseKernel(entry->kernels[i]);
+    }
+    clReleaseProgram(entry->program);
+}
+
+cl_program kernel_cache_get(KernelCache* cache, const char* options, double* compile_ms, cl_int* err)
+{
+    KernelCacheEntry* slot = NULL;
+
+    cache->clock++;
+    if (compile_ms != NULL) {
+        *compile_ms = 0.0;
+    }
+
+    for (int i = 0; i < cache->count; i++) {
+        if (strcmp(cache->entries[i].options, options) == 0) {
+            cache->entries[i].last_use = cache->clock;
+            cache->hits++;
+            *err = CL_SUCCESS;
+            return cache->entries[i].program;
+        }
+    }
+
+    double start = now_ms();
+    cl_program program = cache->cache_dir[0] ? load_binary(cache, options) : NULL;
+    if (program != NULL) {
+        cache->disk_hits++;
+    } else {
+        program = clCreateProgramWithSource(cache->context, 1, (const char**)&cache->source, NULL, err);
+        if (*err != CL_SUCCESS) {
+            return NULL;
+        }
+        *err = build(cache, program, options);
+        if (*err != CL_SUCCESS) {
+            clReleaseProgram(program);
+            return NULL;
+        }
+        cache->builds++;
+        if (cache->cache_dir[0]) {
+            save_binary(cache, program, options);
+        }
+    }
+    double elapsed = now_ms() - start;
+    cache->compile_ms_total += elapsed;
+    if (compile_ms != NULL) {
+        *compile_ms = elapsed;
+    }
+
+    if (cache->count < cache->capacity) {
+        slot = &cache->entries[cache->count++];
+    } else {
+        slot = &cache->entries[0];
+        for (int i = 1; i < cache->count; i++) {
+            if (cache->entries[i].last_use < slot->last_use) {
+                slot = &cache->entries[i];
+            }
+        }
+        // Kernels created outside the cache keep the evicted program alive until they are released.
+        release_entry(slot);
+        cache->evictions++;
+    }
+
+    memset(slot, 0, sizeof(KernelCacheEntry));
+    strncpy(slot->options, options, KERNEL_CACHE_OPTIONS_LENGTH - 1);
+    slot->options[KERNEL_CACHE_OPTIONS_LENGTH - 1] = 0;
+    slot->program = program;
+    slot->last_use = cache->clock;
+    slot->compile_ms = elapsed;
+
+    *err = CL_SUCCESS;
+    return program;
+}
+
+cl_kernel kernel_cache_get_kernel(KernelCache* cache, const char* options, const char* name,
+                                  double* compile_ms, cl_int* err)
+{
+    cl_program program = kernel_cache_get(cache, options, compile_ms, err);
+    if (program == NULL) {
+        return NULL;
+    }
+
+    KernelCacheEntry* entry = NULL;
+    for (int i = 0; i < cache->count && entry == NULL; i++) {
+        if (cache->entries[i].program == program) {
+            entry = &cache->entries[i];
+        }
+    }
+    for (int i = 0; i < entry->kernel_count; i++) {
+        if (strcmp(entry->kernel_names[i], name) == 0) {
+            return entry->kernels[i];
+        }
+    }
+    if (entry->kernel_count == KERNEL_CACHE_KERNELS || strlen(name) >= KERNEL_CACHE_NAME_LENGTH) {
+        *err = CL_OUT_OF_RESOURCES;
+        return NULL;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, name, err);
+    if (*err != CL_SUCCESS) {
+        return NULL;
+    }
+    strcpy(entry->kernel_names[entry->kernel_count], name);
+    entry->kernels[entry->kernel_count++] = kernel;
+    return kernel;
+}
+
+void kernel_cache_print_stats(const KernelCache* cache, const char* label)
+{
+    printf("%s: %lu memory hits, %lu disk hits, %lu builds, %lu evictions, %.1f ms compile/load in total\n",
+           label, cache->hits, cache->disk_hits, cache->builds, cache->evictions, cache->compile_ms_total);
+}
+
+void kernel_cache_release(KernelCache* cache)
+{
+    for (int i = 0; i < cache->count; i++) {
+        release_entry(&cache->entries[i]);
+    }
+    free(cache->entries);
+    free(cache->source);
+    memset(cache, 0, sizeof(KernelCache));
+}
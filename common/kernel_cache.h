@@ -0,0 +1,102 @@
+#ifndef KERNEL_CACHE_H
+#define KERNEL_CACHE_H
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+#define KERNEL_CACHE_OPTIONS_LENGTH 256
+#define KERNEL_CACHE_SHAPES 64
+#define KERNEL_CACHE_KERNELS 8
+#define KERNEL_CACHE_NAME_LENGTH 64
+
+typedef struct {
+    char options[KERNEL_CACHE_OPTIONS_LENGTH];
+    cl_program program;
+    unsigned long last_use;
+    double compile_ms;
+    // Kernels created from the program, released together with it.
+    cl_kernel kernels[KERNEL_CACHE_KERNELS];
+    char kernel_names[KERNEL_CACHE_KERNELS][KERNEL_CACHE_NAME_LENGTH];
+    int kernel_count;
+} KernelCacheEntry;
+
+typedef struct {
+    char options[KERNEL_CACHE_OPTIONS_LENGTH];
+    int uses;
+} KernelCacheShape;
+
+/**
+ * Programs built from one source with problem specific -D options.
+ *
+ * At most capacity programs are kept in memory, the least recently used
+ * one is released first. When cache_dir is set, the device binaries are
+ * also stored there (at most disk_capacity files, oldest removed first),
+ * so a later run only has to load the binary.
+ */
+typedef struct {
+    cl_context context;
+    cl_device_id device_id;
+    char* source;
+    char base_options[KERNEL_CACHE_OPTIONS_LENGTH];
+    char cache_dir[KERNEL_CACHE_OPTIONS_LENGTH];
+    unsigned long long device_hash;
+    int capacity;
+    int disk_capacity;
+    int min_uses;
+
+    KernelCacheEntry* entries;
+    int count;
+    unsigned long clock;
+
+    KernelCacheShape shapes[KERNEL_CACHE_SHAPES];
+    int shape_count;
+
+    unsigned long hits;
+    unsigned long disk_hits;
+    unsigned long builds;
+    unsigned long evictions;
+    double compile_ms_total;
+} KernelCache;
+
+/**
+ * path: Path of the kernel source
+ * base_options: Options added to every build (may be NULL)
+ * capacity: Number of specialized programs kept in memory
+ * cache_dir: Directory of the binary cache, NULL disables it
+ *
+ * Returns CL_SUCCESS or CL_INVALID_VALUE when the source cannot be loaded
+ */
+cl_int kernel_cache_init(KernelCache* cache, cl_context context, cl_device_id device_id,
+                         const char* const path, const char* base_options, int capacity, const char* cache_dir);
+
+/**
+ * Count one request of the given specialization and decide whether it is
+ * common enough (requested at least min_uses times) to be worth a
+ * specialized build. Uncommon shapes should use the generic kernel.
+ */
+int kernel_cache_should_specialize(KernelCache* cache, const char* options);
+
+/**
+ * Return the program built with the given options, from memory, from the
+ * disk cache or by compiling it. The cache owns the returned program.
+ *
+ * compile_ms: Time spent loading or building it, 0 on a memory hit (may be NULL)
+ */
+cl_program kernel_cache_get(KernelCache* cache, const char* options, double* compile_ms, cl_int* err);
+
+/**
+ * Return the named kernel of the program built with the given options.
+ * The kernel is created once per cached program and is owned by the
+ * cache: the caller sets every argument before a launch and does not
+ * release it. At most KERNEL_CACHE_KERNELS kernels are kept per program.
+ *
+ * compile_ms: As for kernel_cache_get (may be NULL)
+ */
+cl_kernel kernel_cache_get_kernel(KernelCache* cache, const char* options, const char* name,
+                                  double* compile_ms, cl_int* err);
+
+void kernel_cache_print_stats(const KernelCache* cache, const char* label);
+
+void kernel_cache_release(KernelCache* cache);
+
+#endif
@@ -0,0 +1,205 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#include "numa_topology.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUMA_PAGE_SIZE 4096
+
+static void add_cpu(NumaTopology* topology, int node, int cpu)
+{
+    if (cpu >= 0 && cpu < NUMA_MAX_CPUS) {
+        topology->cpu_mask[node][cpu / 64] |= 1ULL << (cpu % 64);
+        topology->cpu_count[node]++;
+    }
+}
+
+// cpulist format: "0-15,32-47"
+static void parse_cpu_list(NumaTopology* topology, int node, const char* list)
+{
+    const char* p = list;
+    while (*p != '\0' && *p != '\n') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p) {
+            break;
+        }
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            add_cpu(topology, node, (int)cpu);
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+}
+
+int numa_detect(NumaTopology* topology)
+{
+    memset(topology, 0, sizeof(NumaTopology));
+
+#ifdef __linux__
+    // The node ids may have gaps, so every possible id is tried.
+    for (int id = 0; id < 256 && topology->node_count < NUMA_MAX_NODES; id++) {
+        char path[128];
+        char list[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+        FILE* file = fopen(path, "r");
+        if (file == NULL) {
+            continue;
+        }
+        if (fgets(list, sizeof(list), file) != NULL) {
+            int node = topology->node_count;
+            parse_cpu_list(topology, node, list);
+            // Memory-only nodes cannot run work-items.
+            if (topology->cpu_count[node] > 0) {
+                topology->node_ids[node] = id;
+                topology->node_count++;
+            } else {
+                memset(topology->cpu_mask[node], 0, sizeof(topology->cpu_mask[node]));
+            }
+        }
+        fclose(file);
+    }
+#endif
+
+    if (topology->node_count == 0) {
+        topology->node_count = 1;
+        topology->node_ids[0] = 0;
+    }
+    return topology->node_count;
+}
+
+void numa_print(const NumaTopology* topology)
+{
+    for (int node = 0; node < topology->node_count; node++) {
+        if (topology->cpu_count[node] > 0) {
+            printf("NUMA node %d: %d CPUs\n", topology->node_ids[node], topology->cpu_count[node]);
+        } else {
+            printf("NUMA node %d: no topology information, threads are not pinned\n", topology->node_ids[node]);
+        }
+    }
+}
+
+void* numa_alloc(size_t bytes)
+{
+#ifdef __linux__
+    void* memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+#else
+    size_t rounded = (bytes + NUMA_PAGE_SIZE - 1) / NUMA_PAGE_SIZE * NUMA_PAGE_SIZE;
+    return aligned_alloc(NUMA_PAGE_SIZE, rounded);
+#endif
+}
+
+void numa_free(void* memory, size_t bytes)
+{
+    if (memory == NULL) {
+        return;
+    }
+#ifdef __linux__
+    munmap(memory, bytes);
+#else
+    free(memory);
+#endif
+}
+
+typedef struct {
+    const NumaTopology* topology;
+    int node;
+    NumaNodeTask task;
+    void* arg;
+} NodeThread;
+
+static void* node_thread(void* data)
+{
+    NodeThread* thread = (NodeThread*)data;
+
+#ifdef __linux__
+    const NumaTopology* topology = thread->topology;
+    if (topology->cpu_count[thread->node] > 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < NUMA_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+            if (topology->cpu_mask[thread->node][cpu / 64] & (1ULL << (cpu % 64))) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        // Placement is only a hint: without it the task still runs, just unpinned.
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#endif
+
+    thread->task(thread->node, thread->arg);
+    return NULL;
+}
+
+int numa_run_on_nodes(const NumaTopology* topology, int node_count, NumaNodeTask task, void* const args[])
+{
+    NodeThread threads[NUMA_MAX_NODES];
+    pthread_t handles[NUMA_MAX_NODES];
+    int started = 0;
+    int result = 0;
+
+    if (node_count > topology->node_count) {
+        node_count = topology->node_count;
+    }
+    for (int node = 0; node < node_count; node++) {
+        threads[node].topology = topology;
+        threads[node].node = node;
+        threads[node].task = task;
+        threads[node].arg = args[node];
+        if (pthread_create(&handles[node], NULL, node_thread, &threads[node]) != 0) {
+            result = -1;
+            break;
+        }
+        started++;
+    }
+    for (int node = 0; node < started; node++) {
+        pthread_join(handles[node], NULL);
+    }
+    return result;
+}
+
+cl_int numa_create_sub_devices(cl_device_id device_id, cl_device_id* sub_devices, cl_uint max_count, cl_uint* count)
+{
+    cl_device_partition_property properties[] = {
+        CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, CL_DEVICE_AFFINITY_DOMAIN_NUMA, 0
+    };
+    cl_uint available = 0;
+
+    *count = 0;
+    cl_int err = clCreateSubDevices(device_id, properties, 0, NULL, &available);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    // The call has to receive every sub-device, the ones above max_count are released.
+    cl_device_id* all = (cl_device_id*)malloc(sizeof(cl_device_id) * available);
+    if (all == NULL) {
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    err = clCreateSubDevices(device_id, properties, available, all, NULL);
+    if (err == CL_SUCCESS) {
+        for (cl_uint i = 0; i < available; i++) {
+            if (i < max_count) {
+                sub_devices[(*count)++] = all[i];
+            } else {
+                clReleaseDevice(all[i]);
+            }
+        }
+    }
+    free(all);
+    return err;
+}
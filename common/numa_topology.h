@@ -0,0 +1,60 @@
+#ifndef NUMA_TOPOLOGY_H
+#define NUMA_TOPOLOGY_H
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+#include <stddef.h>
+
+#define NUMA_MAX_NODES 16
+#define NUMA_MAX_CPUS 1024
+
+/**
+ * NUMA nodes of the host with their CPUs, read from
+ * /sys/devices/system/node. Without NUMA information (or on other
+ * systems) there is a single node without a CPU mask, and its threads
+ * are not pinned.
+ */
+typedef struct {
+    int node_count;
+    int node_ids[NUMA_MAX_NODES];
+    int cpu_count[NUMA_MAX_NODES];
+    unsigned long long cpu_mask[NUMA_MAX_NODES][NUMA_MAX_CPUS / 64];
+} NumaTopology;
+
+/**
+ * Returns the number of nodes found (at least 1)
+ */
+int numa_detect(NumaTopology* topology);
+
+void numa_print(const NumaTopology* topology);
+
+/**
+ * Page aligned memory that is not touched yet, so its pages are placed on
+ * the node of the thread that first writes them.
+ */
+void* numa_alloc(size_t bytes);
+
+void numa_free(void* memory, size_t bytes);
+
+typedef void (*NumaNodeTask)(int node, void* arg);
+
+/**
+ * Run task(node, args[node]) for the first node_count nodes in parallel,
+ * each on a thread pinned to the CPUs of its node, and wait for all.
+ * Used for the first touch of node local memory.
+ *
+ * Returns 0 on success, -1 when a thread could not be started
+ */
+int numa_run_on_nodes(const NumaTopology* topology, int node_count, NumaNodeTask task, void* const args[]);
+
+/**
+ * Partition a CPU device into one sub-device per NUMA node
+ * (CL_DEVICE_AFFINITY_DOMAIN_NUMA). The runtimes list the sub-devices in
+ * node order, so sub_devices[i] is assumed to run on the i-th node of
+ * numa_detect.
+ *
+ * count: Number of sub-devices created (at most max_count)
+ */
+cl_int numa_create_sub_devices(cl_device_id device_id, cl_device_id* sub_devices, cl_uint max_count, cl_uint* count);
+
+#endif
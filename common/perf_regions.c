@@ -0,0 +1,330 @@
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perf_regions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    int enabled;
+    const char* output;
+    int leader;
+    int fds[PERF_COUNTER_COUNT];
+    // Position of the counter in a group read, -1 when it could not be opened.
+    int slot[PERF_COUNTER_COUNT];
+    int opened;
+
+    PerfRegion regions[PERF_REGIONS_MAX];
+    int region_count;
+
+    int stack[PERF_REGIONS_MAX_DEPTH];
+    double start_ms[PERF_REGIONS_MAX_DEPTH];
+    unsigned long long start_counts[PERF_REGIONS_MAX_DEPTH][PERF_COUNTER_COUNT];
+    int depth;
+} PerfState;
+
+static PerfState state;
+static _Thread_local int owner_thread;
+
+static const char* const counter_names[PERF_COUNTER_COUNT] = {
+    "cycles", "instructions", "cache_misses", "branch_misses"
+};
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+#ifdef __linux__
+static int open_counter(unsigned long long config, int group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = group_fd == -1;
+    // User space only, this is allowed up to perf_event_paranoid 2.
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+static void open_counters(void)
+{
+    state.leader = -1;
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        state.fds[c] = -1;
+        state.slot[c] = -1;
+    }
+
+#ifdef __linux__
+    static const unsigned long long configs[PERF_COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    // One group: a single read returns every counter for the same interval.
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        int fd = open_counter(configs[c], state.leader);
+        if (fd < 0) {
+            continue;
+        }
+        if (state.leader < 0) {
+            state.leader = fd;
+        }
+        state.fds[c] = fd;
+        state.slot[c] = state.opened++;
+    }
+    if (state.leader >= 0) {
+        ioctl(state.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(state.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+}
+
+static void read_counts(unsigned long long counts[PERF_COUNTER_COUNT])
+{
+    memset(counts, 0, sizeof(unsigned long long) * PERF_COUNTER_COUNT);
+
+#ifdef __linux__
+    unsigned long long values[3 + PERF_COUNTER_COUNT];
+    if (state.leader < 0 || read(state.leader, values, sizeof(values)) < (ssize_t)(sizeof(unsigned long long) * 3)) {
+        return;
+    }
+    unsigned long long enabled = values[1];
+    unsigned long long running = values[2];
+    if (running == 0) {
+        return;
+    }
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (state.slot[c] >= 0 && (unsigned long long)state.slot[c] < values[0]) {
+            unsigned long long value = values[3 + state.slot[c]];
+            // Scaled up when the kernel had to multiplex the group with other events.
+            counts[c] = running < enabled ? (unsigned long long)((double)value * enabled / running) : value;
+        }
+    }
+#endif
+}
+
+void perf_regions_init(void)
+{
+    const char* output = getenv("PERF_REGIONS");
+
+    memset(&state, 0, sizeof(PerfState));
+    if (output == NULL || output[0] == '\0' || strcmp(output, "0") == 0) {
+        return;
+    }
+    state.enabled = 1;
+    state.output = output;
+    owner_thread = 1;
+    open_counters();
+    if (state.opened == 0) {
+        fprintf(stderr, "[WARNING] perf_event_open is not available, the regions only get wall time\n");
+    }
+}
+
+static int find_region(const char* name)
+{
+    char path[PERF_REGIONS_NAME_LENGTH];
+    int parent = state.depth > 0 ? state.stack[state.depth - 1] : -1;
+
+    if (parent >= 0) {
+        snprintf(path, sizeof(path), "%s/%s", state.regions[parent].path, name);
+    } else {
+        snprintf(path, sizeof(path), "%s", name);
+    }
+    for (int i = 0; i < state.region_count; i++) {
+        if (strcmp(state.regions[i].path, path) == 0) {
+            return i;
+        }
+    }
+    if (state.region_count == PERF_REGIONS_MAX) {
+        return -1;
+    }
+    PerfRegion* region = &state.regions[state.region_count];
+    memset(region, 0, sizeof(PerfRegion));
+    strcpy(region->path, path);
+    region->depth = state.depth;
+    return state.region_count++;
+}
+
+void perf_region_begin(const char* name)
+{
+    if (!state.enabled || !owner_thread) {
+        return;
+    }
+    // Deeper regions are only counted, so begin and end stay paired.
+    if (state.depth >= PERF_REGIONS_MAX_DEPTH) {
+        state.depth++;
+        return;
+    }
+    int depth = state.depth;
+    state.stack[depth] = find_region(name);
+    state.depth++;
+    // Counters are read last, the bookkeeping above is not part of the region.
+    state.start_ms[depth] = now_ms();
+    read_counts(state.start_counts[depth]);
+}
+
+void perf_region_end(void)
+{
+    unsigned long long counts[PERF_COUNTER_COUNT];
+
+    if (!state.enabled || !owner_thread || state.depth == 0) {
+        return;
+    }
+    read_counts(counts);
+    double end_ms = now_ms();
+    int depth = --state.depth;
+    if (depth >= PERF_REGIONS_MAX_DEPTH || state.stack[depth] < 0) {
+        return;
+    }
+    PerfRegion* region = &state.regions[state.stack[depth]];
+    region->calls++;
+    region->ms += end_ms - state.start_ms[depth];
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (counts[c] > state.start_counts[depth][c]) {
+            region->counts[c] += counts[c] - state.start_counts[depth][c];
+        }
+    }
+}
+
+// Paths in tree order: a region is followed by the regions nested in it.
+static int compare_paths(const void* a, const void* b)
+{
+    const unsigned char* p = (const unsigned char*)((const PerfRegion*)a)->path;
+    const unsigned char* q = (const unsigned char*)((const PerfRegion*)b)->path;
+    while (*p != '\0' && *p == *q) {
+        p++;
+        q++;
+    }
+    int x = *p == '/' ? 1 : *p;
+    int y = *q == '/' ? 1 : *q;
+    return x - y;
+}
+
+// A sorted copy, the indices on the region stack stay valid.
+static PerfRegion* sorted_regions(void)
+{
+    PerfRegion* sorted = (PerfRegion*)malloc(sizeof(PerfRegion) * (state.region_count > 0 ? state.region_count : 1));
+    if (sorted != NULL) {
+        memcpy(sorted, state.regions, sizeof(PerfRegion) * state.region_count);
+        qsort(sorted, state.region_count, sizeof(PerfRegion), compare_paths);
+    }
+    return sorted;
+}
+
+static void print_count(FILE* file, PerfCounter counter, unsigned long long value)
+{
+    if (state.slot[counter] >= 0) {
+        fprintf(file, " %12.3f", value / 1e6);
+    } else {
+        fprintf(file, " %12s", "-");
+    }
+}
+
+// Misses per thousand instructions
+static void print_mpki(FILE* file, PerfCounter counter, const PerfRegion* region)
+{
+    if (state.slot[counter] >= 0 && state.slot[PERF_INSTRUCTIONS] >= 0 && region->counts[PERF_INSTRUCTIONS] > 0) {
+        fprintf(file, " %7.2f", 1000.0 * region->counts[counter] / region->counts[PERF_INSTRUCTIONS]);
+    } else {
+        fprintf(file, " %7s", "-");
+    }
+}
+
+void perf_regions_print(FILE* file)
+{
+    PerfRegion* sorted = sorted_regions();
+    if (sorted == NULL) {
+        return;
+    }
+    fprintf(file, "%-40s %8s %10s %12s %12s %5s %12s %7s %12s %7s\n", "region", "calls", "ms", "Mcycles", "Minstr",
+            "IPC", "Mcache miss", "MPKI", "Mbranch miss", "MPKI");
+    for (int i = 0; i < state.region_count; i++) {
+        const PerfRegion* region = &sorted[i];
+        const char* name = strrchr(region->path, '/');
+        char label[PERF_REGIONS_NAME_LENGTH];
+        snprintf(label, sizeof(label), "%*s%s", region->depth * 2, "", name != NULL ? name + 1 : region->path);
+
+        fprintf(file, "%-40s %8lu %10.3f", label, region->calls, region->ms);
+        print_count(file, PERF_CYCLES, region->counts[PERF_CYCLES]);
+        print_count(file, PERF_INSTRUCTIONS, region->counts[PERF_INSTRUCTIONS]);
+        if (state.slot[PERF_CYCLES] >= 0 && state.slot[PERF_INSTRUCTIONS] >= 0 && region->counts[PERF_CYCLES] > 0) {
+            fprintf(file, " %5.2f", (double)region->counts[PERF_INSTRUCTIONS] / region->counts[PERF_CYCLES]);
+        } else {
+            fprintf(file, " %5s", "-");
+        }
+        print_count(file, PERF_CACHE_MISSES, region->counts[PERF_CACHE_MISSES]);
+        print_mpki(file, PERF_CACHE_MISSES, region);
+        print_count(file, PERF_BRANCH_MISSES, region->counts[PERF_BRANCH_MISSES]);
+        print_mpki(file, PERF_BRANCH_MISSES, region);
+        fprintf(file, "\n");
+    }
+    free(sorted);
+}
+
+void perf_regions_write_csv(FILE* file)
+{
+    PerfRegion* sorted = sorted_regions();
+    if (sorted == NULL) {
+        return;
+    }
+    fprintf(file, "path,depth,calls,ms");
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        fprintf(file, ",%s", counter_names[c]);
+    }
+    fprintf(file, "\n");
+    for (int i = 0; i < state.region_count; i++) {
+        const PerfRegion* region = &sorted[i];
+        fprintf(file, "%s,%d,%lu,%.6f", region->path, region->depth, region->calls, region->ms);
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            if (state.slot[c] >= 0) {
+                fprintf(file, ",%llu", region->counts[c]);
+            } else {
+                fprintf(file, ",");
+            }
+        }
+        fprintf(file, "\n");
+    }
+    free(sorted);
+}
+
+void perf_regions_finish(void)
+{
+    if (!state.enabled) {
+        return;
+    }
+    if (state.depth > 0) {
+        fprintf(stderr, "[WARNING] %d perf regions were not ended\n", state.depth);
+    }
+    printf("\n");
+    perf_regions_print(stdout);
+    if (strcmp(state.output, "1") != 0 && strcmp(state.output, "table") != 0) {
+        FILE* file = fopen(state.output, "w");
+        if (file == NULL) {
+            fprintf(stderr, "[ERROR] Cannot write %s\n", state.output);
+        } else {
+            perf_regions_write_csv(file);
+            fclose(file);
+        }
+    }
+
+#ifdef __linux__
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (state.fds[c] >= 0) {
+            close(state.fds[c]);
+        }
+    }
+#endif
+    state.enabled = 0;
+}
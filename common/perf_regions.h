@@ -0,0 +1,67 @@
+#ifndef PERF_REGIONS_H
+#define PERF_REGIONS_H
+
+#include <stdio.h>
+
+#define PERF_REGIONS_MAX 64
+#define PERF_REGIONS_MAX_DEPTH 16
+#define PERF_REGIONS_NAME_LENGTH 128
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+} PerfCounter;
+
+/**
+ * Totals of one region, keyed by its path ("outer/inner"), so the same
+ * function reached from different callers is reported separately.
+ */
+typedef struct {
+    char path[PERF_REGIONS_NAME_LENGTH];
+    int depth;
+    unsigned long calls;
+    double ms;
+    unsigned long long counts[PERF_COUNTER_COUNT];
+} PerfRegion;
+
+/**
+ * Named host regions measured with Linux perf_event_open counters
+ * (user space cycles, instructions, cache misses and branch misses of
+ * the calling thread).
+ *
+ * Enabled by the PERF_REGIONS environment variable: "1" or "table" prints
+ * the summary table at perf_regions_finish, any other value is a file
+ * path the table is also written to as CSV. Counters the kernel refuses
+ * (perf_event_paranoid, virtual machines, other systems) are left out of
+ * the output; the regions still get calls and wall time.
+ *
+ * Only the thread that called perf_regions_init is measured, regions on
+ * other threads (e.g. OpenCL event callbacks) are ignored.
+ */
+void perf_regions_init(void);
+
+/**
+ * Regions nest: a region begun inside another one is reported under it.
+ * Begin and end have to pair up like a stack.
+ */
+void perf_region_begin(const char* name);
+void perf_region_end(void);
+
+void perf_regions_print(FILE* file);
+
+/**
+ * One line per region: path,depth,calls,ms,cycles,instructions,
+ * cache_misses,branch_misses (unavailable counters are empty).
+ */
+void perf_regions_write_csv(FILE* file);
+
+/**
+ * Print and write the output selected by PERF_REGIONS, then close the
+ * counters.
+ */
+void perf_regions_finish(void);
+
+#endif
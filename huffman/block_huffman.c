@@ -0,0 +1,190 @@
+#include "block_huffman.h"
+#include "huffman_tree.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int usedSymbols(const HuffmanTable *table) {
+    int count = 0;
+    for (int s = 0; s < 256; s++) {
+        count += table->codeLengths[s] > 0;
+    }
+    return count;
+}
+
+size_t huffmanTableHeaderSize(const HuffmanTable *table) {
+    return 2 + 2 * (size_t)usedSymbols(table);
+}
+
+// Egy uj tabla becsult koltsege bitekben: a blokk entropiaja (ennel egy Huffman tabla
+// sem lehet jobb) a szokasos tobblettel, plusz a tabla fejlece.
+static double newTableBits(const int *frequencies, int count) {
+    double bits = 0.0;
+    int symbols = 0;
+    for (int s = 0; s < 256; s++) {
+        if (frequencies[s] > 0) {
+            bits -= frequencies[s] * log2((double)frequencies[s] / count);
+            symbols++;
+        }
+    }
+    return bits * (1.0 + BLOCK_HUFFMAN_REUSE_SLACK) + 8.0 * (2 + 2 * symbols);
+}
+
+// A blokk kodolt merete a megadott tablaval, -1 ha valamelyik szimbolumnak nincs kodja.
+static double tableBits(const int *frequencies, const HuffmanTable *table) {
+    double bits = 0.0;
+    for (int s = 0; s < 256; s++) {
+        if (frequencies[s] > 0) {
+            if (table->codeLengths[s] == 0) {
+                return -1.0;
+            }
+            bits += (double)frequencies[s] * table->codeLengths[s];
+        }
+    }
+    return bits;
+}
+
+int planHuffmanBlocks(const int *block_frequencies, int input_size, int block_size, BlockHuffmanPlan *plan) {
+    memset(plan, 0, sizeof(BlockHuffmanPlan));
+    plan->block_size = block_size;
+    plan->block_count = (input_size + block_size - 1) / block_size;
+    plan->block_table = (int *)malloc(sizeof(int) * (plan->block_count > 0 ? plan->block_count : 1));
+    plan->tables = (HuffmanTable *)malloc(sizeof(HuffmanTable) * (plan->block_count > 0 ? plan->block_count : 1));
+    if (plan->block_table == NULL || plan->tables == NULL) {
+        freeHuffmanBlockPlan(plan);
+        return -1;
+    }
+
+    for (int b = 0; b < plan->block_count; b++) {
+        const int *frequencies = block_frequencies + (size_t)b * 256;
+        int count = b == plan->block_count - 1 ? input_size - b * block_size : block_size;
+
+        if (plan->table_count > 0) {
+            // Olcso becsles fa epites nelkul: marad a regi tabla, ha nem dragabb egy uj tablanal.
+            double reuse_bits = tableBits(frequencies, &plan->tables[plan->table_count - 1]);
+            if (reuse_bits >= 0.0 && reuse_bits <= newTableBits(frequencies, count)) {
+                plan->block_table[b] = plan->table_count - 1;
+                continue;
+            }
+        }
+
+        HuffmanTable *table = &plan->tables[plan->table_count];
+        memset(table, 0, sizeof(HuffmanTable));
+        buildHuffmanCodes((int *)frequencies, table->huffmanCodes, table->codeLengths);
+        canonicalHuffmanCodes(table->codeLengths, table->huffmanCodes);
+        plan->block_table[b] = plan->table_count++;
+    }
+    return 0;
+}
+
+void freeHuffmanBlockPlan(BlockHuffmanPlan *plan) {
+    free(plan->block_table);
+    free(plan->tables);
+    memset(plan, 0, sizeof(BlockHuffmanPlan));
+}
+
+size_t blockHuffmanBound(const BlockHuffmanPlan *plan, const unsigned char *input, int input_size) {
+    size_t size = ENTROPY_STREAM_HEADER_SIZE;
+    for (int b = 0; b < plan->block_count; b++) {
+        int offset = b * plan->block_size;
+        int count = b == plan->block_count - 1 ? input_size - offset : plan->block_size;
+        const HuffmanTable *table = &plan->tables[plan->block_table[b]];
+        size += 1 + huffmanTableHeaderSize(table) + 4 + packedHuffmanSize(input + offset, count, table->codeLengths);
+    }
+    return size;
+}
+
+size_t writeHuffmanBlocks(const BlockHuffmanPlan *plan, const int *encoded_data,
+                          const unsigned char *input, int input_size, unsigned char *output) {
+    unsigned char *p = output;
+
+    writeEntropyHeader(p, ENTROPY_CODEC_HUFFMAN_BLOCKS, (uint32_t)input_size, (uint32_t)plan->block_size);
+    p += ENTROPY_STREAM_HEADER_SIZE;
+
+    for (int b = 0; b < plan->block_count; b++) {
+        int offset = b * plan->block_size;
+        int count = b == plan->block_count - 1 ? input_size - offset : plan->block_size;
+        const HuffmanTable *table = &plan->tables[plan->block_table[b]];
+        int new_table = b == 0 || plan->block_table[b] != plan->block_table[b - 1];
+
+        *p++ = (unsigned char)new_table;
+        if (new_table) {
+            putStreamU16(p, (uint32_t)usedSymbols(table));
+            p += 2;
+            for (int s = 0; s < 256; s++) {
+                if (table->codeLengths[s] > 0) {
+                    *p++ = (unsigned char)s;
+                    *p++ = table->codeLengths[s];
+                }
+            }
+        }
+
+        size_t bits = packHuffmanBits(encoded_data + offset, input + offset, count, table->codeLengths, p + 4);
+        putStreamU32(p, (uint32_t)bits);
+        p += 4 + (bits + 7) / 8;
+    }
+    return (size_t)(p - output);
+}
+
+int readHuffmanBlocks(const unsigned char *stream, size_t stream_size, unsigned char *output, int output_capacity) {
+    const unsigned char *p = stream;
+    const unsigned char *end = stream + stream_size;
+    EntropyStreamHeader header;
+    HuffmanTable table;
+
+    memset(&table, 0, sizeof(table));
+    if (readEntropyHeader(stream, stream_size, &header) != 0 || header.codec != ENTROPY_CODEC_HUFFMAN_BLOCKS) {
+        return -1;
+    }
+    int input_size = (int)header.input_size;
+    int block_size = (int)header.param;
+    p += ENTROPY_STREAM_HEADER_SIZE;
+    if (input_size < 0 || input_size > output_capacity || block_size <= 0) {
+        return -1;
+    }
+    int block_count = (input_size + block_size - 1) / block_size;
+
+    for (int b = 0; b < block_count; b++) {
+        int offset = b * block_size;
+        int count = b == block_count - 1 ? input_size - offset : block_size;
+
+        if (p >= end) {
+            return -1;
+        }
+        int new_table = *p++;
+        if (new_table) {
+            if (end - p < 2) {
+                return -1;
+            }
+            int symbols = (int)getStreamU16(p);
+            p += 2;
+            if (symbols > 256 || end - p < 2 * symbols) {
+                return -1;
+            }
+            memset(&table, 0, sizeof(table));
+            for (int i = 0; i < symbols; i++) {
+                if (p[1] == 0 || p[1] > 31) {
+                    return -1;
+                }
+                table.codeLengths[p[0]] = p[1];
+                p += 2;
+            }
+            canonicalHuffmanCodes(table.codeLengths, table.huffmanCodes);
+        } else if (b == 0) {
+            return -1;
+        }
+
+        if (end - p < 4) {
+            return -1;
+        }
+        size_t bits = getStreamU32(p);
+        p += 4;
+        if ((size_t)(end - p) < (bits + 7) / 8
+            || decodeHuffmanBits(p, bits, table.huffmanCodes, table.codeLengths, output + offset, count) != 0) {
+            return -1;
+        }
+        p += (bits + 7) / 8;
+    }
+    return input_size;
+}
@@ -0,0 +1,76 @@
+#ifndef BLOCK_HUFFMAN_H
+#define BLOCK_HUFFMAN_H
+
+#include "entropy_stream.h"
+
+#define BLOCK_HUFFMAN_DEFAULT_BLOCK_SIZE 65536
+#define BLOCK_HUFFMAN_MAX_BLOCK_SIZE (1 << 20)
+
+/**
+ * Allowed excess of the reused table over the entropy of the block,
+ * relative to the entropy. A new Huffman table is rarely closer than a
+ * few percent to the entropy, so below this the old table is kept.
+ */
+#define BLOCK_HUFFMAN_REUSE_SLACK 0.03
+
+typedef struct {
+    int huffmanCodes[256];
+    unsigned char codeLengths[256];
+} HuffmanTable;
+
+/**
+ * Table choice of every block. Consecutive blocks share a table while the
+ * estimated cost of reusing it stays below the cost of a new one.
+ */
+typedef struct {
+    int block_size;
+    int block_count;
+    int table_count;
+    int *block_table;
+    HuffmanTable *tables;
+} BlockHuffmanPlan;
+
+/**
+ * Choose the table of every block from the per-block histograms.
+ *
+ * block_frequencies: block_count x 256 counts
+ *
+ * Returns 0 on success, -1 when out of memory
+ */
+int planHuffmanBlocks(const int *block_frequencies, int input_size, int block_size, BlockHuffmanPlan *plan);
+
+void freeHuffmanBlockPlan(BlockHuffmanPlan *plan);
+
+/**
+ * Size in bytes of the table header of one table.
+ */
+size_t huffmanTableHeaderSize(const HuffmanTable *table);
+
+/**
+ * Upper bound of the stream size.
+ */
+size_t blockHuffmanBound(const BlockHuffmanPlan *plan, const unsigned char *input, int input_size);
+
+/**
+ * Write the stream from the per-symbol codes of the encode_blocks kernel.
+ *
+ * Stream layout (little endian, byte aligned blocks):
+ *   EntropyStreamHeader (codec ENTROPY_CODEC_HUFFMAN_BLOCKS, param = block size)
+ *   per block: uint8 new_table
+ *              if new_table: uint16 symbol_count, symbol_count x (uint8 symbol, uint8 length)
+ *              uint32 bit_count, (bit_count + 7) / 8 bytes of MSB-first codes
+ * The codes are canonical, so the lengths describe the table.
+ *
+ * Returns the number of bytes written
+ */
+size_t writeHuffmanBlocks(const BlockHuffmanPlan *plan, const int *encoded_data,
+                          const unsigned char *input, int input_size, unsigned char *output);
+
+/**
+ * Decode a stream written by writeHuffmanBlocks.
+ *
+ * Returns the number of decoded bytes or -1 on a corrupt stream
+ */
+int readHuffmanBlocks(const unsigned char *stream, size_t stream_size, unsigned char *output, int output_capacity);
+
+#endif
@@ -0,0 +1,54 @@
+#include "entropy_stream.h"
+#include "block_huffman.h"
+#include "rans.h"
+
+void putStreamU16(unsigned char *p, uint32_t value) {
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+}
+
+void putStreamU32(unsigned char *p, uint32_t value) {
+    putStreamU16(p, value & 0xffff);
+    putStreamU16(p + 2, value >> 16);
+}
+
+uint32_t getStreamU16(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+uint32_t getStreamU32(const unsigned char *p) {
+    return getStreamU16(p) | (getStreamU16(p + 2) << 16);
+}
+
+void writeEntropyHeader(unsigned char *output, EntropyCodec codec, uint32_t input_size, uint32_t param) {
+    putStreamU32(output, ENTROPY_STREAM_MAGIC);
+    putStreamU32(output + 4, (uint32_t)codec);
+    putStreamU32(output + 8, input_size);
+    putStreamU32(output + 12, param);
+}
+
+int readEntropyHeader(const unsigned char *stream, size_t stream_size, EntropyStreamHeader *header) {
+    if (stream_size < ENTROPY_STREAM_HEADER_SIZE || getStreamU32(stream) != ENTROPY_STREAM_MAGIC) {
+        return -1;
+    }
+    header->magic = ENTROPY_STREAM_MAGIC;
+    header->codec = getStreamU32(stream + 4);
+    header->input_size = getStreamU32(stream + 8);
+    header->param = getStreamU32(stream + 12);
+    return 0;
+}
+
+int decodeEntropyStream(const unsigned char *stream, size_t stream_size, unsigned char *output, int output_capacity) {
+    EntropyStreamHeader header;
+    if (readEntropyHeader(stream, stream_size, &header) != 0) {
+        return -1;
+    }
+    switch (header.codec) {
+    case ENTROPY_CODEC_HUFFMAN_BLOCKS:
+        return readHuffmanBlocks(stream, stream_size, output, output_capacity);
+    case ENTROPY_CODEC_RANS:
+        return ransDecodeStream(stream, stream_size, output, output_capacity);
+    default:
+        return -1;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef ENTROPY_STREAM_H
+#define ENTROPY_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ENTROPY_STREAM_MAGIC 0x48435245u
+
+typedef enum {
+    ENTROPY_CODEC_HUFFMAN_BLOCKS = 1,
+    ENTROPY_CODEC_RANS = 2
+} EntropyCodec;
+
+/**
+ * Common header of every encoded stream (little endian). The codec
+ * specific payload follows it directly.
+ *
+ * param: Block size for ENTROPY_CODEC_HUFFMAN_BLOCKS, number of
+ *        interleaved states for ENTROPY_CODEC_RANS
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t codec;
+    uint32_t input_size;
+    uint32_t param;
+} EntropyStreamHeader;
+
+#define ENTROPY_STREAM_HEADER_SIZE 16
+
+void putStreamU16(unsigned char *p, uint32_t value);
+void putStreamU32(unsigned char *p, uint32_t value);
+uint32_t getStreamU16(const unsigned char *p);
+uint32_t getStreamU32(const unsigned char *p);
+
+void writeEntropyHeader(unsigned char *output, EntropyCodec codec, uint32_t input_size, uint32_t param);
+
+/**
+ * Returns 0 on success, -1 when the stream is too short or the magic is wrong
+ */
+int readEntropyHeader(const unsigned char *stream, size_t stream_size, EntropyStreamHeader *header);
+
+/**
+ * Decode a stream of any codec.
+ *
+ * Returns the number of decoded bytes or -1 on a corrupt stream
+ */
+int decodeEntropyStream(const unsigned char *stream, size_t stream_size, unsigned char *output, int output_capacity);
+
+#endif
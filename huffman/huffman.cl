@@ -1,3 +1,31 @@
+#ifdef ALPHABET_SIZE
+// Specializalt valtozat: ha ismert, hogy minden szimbolum kisebb ALPHABET_SIZE-nal,
+// a munkacsoport a lokalis memoriaban szamol, es csak a vegen ir a globalis tombbe.
+__kernel void calculate_frequencies(__global const uchar *input,
+                                    __global int *frequencies,
+                                    int input_size) {
+    __local int local_frequencies[ALPHABET_SIZE];
+    int gid = get_global_id(0);
+    int lid = get_local_id(0);
+    int local_size = get_local_size(0);
+
+    for (int i = lid; i < ALPHABET_SIZE; i += local_size) {
+        local_frequencies[i] = 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (gid < input_size) {
+        atomic_inc(&local_frequencies[input[gid]]);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int i = lid; i < ALPHABET_SIZE; i += local_size) {
+        if (local_frequencies[i] > 0) {
+            atomic_add(&frequencies[i], local_frequencies[i]);
+        }
+    }
+}
+#else
 __kernel void calculate_frequencies(__global const uchar *input,
                                     __global int *frequencies,
                                     int input_size) {
@@ -7,6 +35,7 @@ __kernel void calculate_frequencies(__global const uchar *input,
         atomic_inc(&frequencies[input[gid]]);
     }
 }
+#endif
 
 __kernel void encode_input(__global const uchar *input,
                            __global int *huffman_codes,
@@ -19,4 +48,130 @@ __kernel void encode_input(__global const uchar *input,
         uchar symbol = input[gid];
         encoded_data[gid] = huffman_codes[symbol];
     }
-}
\ No newline at end of file
+}
+
+// Blokkonkenti hisztogram egyetlen inditassal: a block_size hosszu blokkok
+// mind sajat 256 elemu frekvencia tablat kapnak.
+__kernel void calculate_block_frequencies(__global const uchar *input,
+                                          __global int *block_frequencies,
+                                          int input_size,
+                                          int block_size) {
+    int gid = get_global_id(0);
+
+    if (gid < input_size) {
+        atomic_inc(&block_frequencies[(gid / block_size) * 256 + input[gid]]);
+    }
+}
+
+// Kodolas blokkonkent kulonbozo tablaval (block_table: a blokk tablajanak indexe).
+__kernel void encode_blocks(__global const uchar *input,
+                            __global const int *huffman_codes,
+                            __global const int *block_table,
+                            __global int *encoded_data,
+                            int input_size,
+                            int block_size) {
+    int gid = get_global_id(0);
+
+    if (gid < input_size) {
+        int table = block_table[gid / block_size];
+        encoded_data[gid] = huffman_codes[table * 256 + input[gid]];
+    }
+}
+
+// rANS: RANS_PROB_BITS bites kvantalt frekvenciak, 32 bites allapot, 16 bites renormalizalas.
+// A lane. sav a lane, lane + lanes, ... indexu szimbolumokat kodolja, igy a szomszedos
+// munkaelemek szomszedos bajtokat olvasnak.
+#define RANS_PROB_BITS 12
+#define RANS_STATE_LOW 65536u
+
+__kernel void rans_encode(__global const uchar *input,
+                          __global const ushort *freqs,
+                          __global const ushort *starts,
+                          __global ushort *lane_words,
+                          __global uint *lane_counts,
+                          int input_size,
+                          int lanes,
+                          int lane_capacity) {
+    __local ushort local_freq[256];
+    __local ushort local_start[256];
+    int lane = get_global_id(0);
+    int lid = get_local_id(0);
+
+    for (int i = lid; i < 256; i += get_local_size(0)) {
+        local_freq[i] = freqs[i];
+        local_start[i] = starts[i];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (lane >= lanes) {
+        return;
+    }
+
+    int count = lane < input_size ? (input_size - 1 - lane) / lanes + 1 : 0;
+    __global ushort *out = lane_words + (size_t)lane * lane_capacity;
+    int pos = lane_capacity;
+    uint x = RANS_STATE_LOW;
+
+    // Visszafele kodolunk, hogy a dekodolo elorefele olvashasson.
+    for (int k = count - 1; k >= 0; k--) {
+        uchar s = input[k * lanes + lane];
+        uint freq = local_freq[s];
+        if ((ulong)x >= (ulong)((RANS_STATE_LOW >> RANS_PROB_BITS) << 16) * freq) {
+            out[--pos] = (ushort)(x & 0xffff);
+            x >>= 16;
+        }
+        x = ((x / freq) << RANS_PROB_BITS) + (x % freq) + local_start[s];
+    }
+
+    out[--pos] = (ushort)(x >> 16);
+    out[--pos] = (ushort)(x & 0xffff);
+    lane_counts[lane] = lane_capacity - pos;
+}
+
+__kernel void rans_decode(__global const ushort *words,
+                          __global const uint *lane_offsets,
+                          __global const uchar *slot_symbols,
+                          __global const ushort *freqs,
+                          __global const ushort *starts,
+                          __global uchar *output,
+                          int input_size,
+                          int lanes) {
+    __local uchar local_slots[1 << RANS_PROB_BITS];
+    __local ushort local_freq[256];
+    __local ushort local_start[256];
+    int lane = get_global_id(0);
+    int lid = get_local_id(0);
+    int local_size = get_local_size(0);
+
+    for (int i = lid; i < (1 << RANS_PROB_BITS); i += local_size) {
+        local_slots[i] = slot_symbols[i];
+    }
+    for (int i = lid; i < 256; i += local_size) {
+        local_freq[i] = freqs[i];
+        local_start[i] = starts[i];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (lane >= lanes) {
+        return;
+    }
+
+    int count = lane < input_size ? (input_size - 1 - lane) / lanes + 1 : 0;
+    uint pos = lane_offsets[lane];
+    uint end = lane_offsets[lane + 1];
+    uint x = words[pos] | ((uint)words[pos + 1] << 16);
+    pos += 2;
+
+    for (int k = 0; k < count; k++) {
+        uint slot = x & ((1 << RANS_PROB_BITS) - 1);
+        uchar s = local_slots[slot];
+        output[k * lanes + lane] = s;
+        x = local_freq[s] * (x >> RANS_PROB_BITS) + slot - local_start[s];
+        if (x < RANS_STATE_LOW) {
+            if (pos >= end) {
+                return;
+            }
+            x = (x << 16) | words[pos++];
+        }
+    }
+}
@@ -0,0 +1,241 @@
+#include "huffman_tree.h"
+#include "perf_regions.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+PriorityQueue* createPriorityQueue() {
+    PriorityQueue *queue = (PriorityQueue*)malloc(sizeof(PriorityQueue));
+    queue->head = NULL;
+    return queue;
+}
+
+void enqueue(PriorityQueue *queue, HuffmanNode *node) {
+    PriorityQueueNode *newNode = (PriorityQueueNode*)malloc(sizeof(PriorityQueueNode));
+    newNode->node = node;
+    newNode->next = NULL;
+
+    if (queue->head == NULL || queue->head->node->frequency > node->frequency) {
+        newNode->next = queue->head;
+        queue->head = newNode;
+    } else {
+        PriorityQueueNode *current = queue->head;
+        while (current->next != NULL && current->next->node->frequency <= node->frequency) {
+            current = current->next;
+        }
+        newNode->next = current->next;
+        current->next = newNode;
+    }
+}
+
+HuffmanNode* dequeue(PriorityQueue *queue) {
+    if (queue->head == NULL) {
+        return NULL;
+    }
+    PriorityQueueNode *temp = queue->head;
+    HuffmanNode *node = temp->node;
+    queue->head = queue->head->next;
+    free(temp);
+    return node;
+}
+
+HuffmanNode* buildHuffmanTree(int frequencies[]) {
+    PriorityQueue *queue = createPriorityQueue();
+
+    for (int i = 0; i < 256; i++) {
+        if (frequencies[i] > 0) {
+            HuffmanNode *node = (HuffmanNode*)malloc(sizeof(HuffmanNode));
+            node->data = (unsigned char)i;
+            node->frequency = frequencies[i];
+            node->left = node->right = NULL;
+            enqueue(queue, node);
+        }
+    }
+
+    while (queue->head != NULL && queue->head->next != NULL) {
+        HuffmanNode *left = dequeue(queue);
+        HuffmanNode *right = dequeue(queue);
+
+        HuffmanNode *newNode = (HuffmanNode*)malloc(sizeof(HuffmanNode));
+        newNode->data = 0;
+        newNode->frequency = left->frequency + right->frequency;
+        newNode->left = left;
+        newNode->right = right;
+
+        enqueue(queue, newNode);
+    }
+
+    HuffmanNode *root = dequeue(queue);
+    free(queue);
+    return root;
+}
+
+void generateHuffmanCodes(HuffmanNode *root, int huffmanCodes[], unsigned char codeLengths[], int code, int depth) {
+    if (root->left == NULL && root->right == NULL) {
+        huffmanCodes[root->data] = code;
+        codeLengths[root->data] = depth;
+        return;
+    }
+
+    if (root->left != NULL) {
+        generateHuffmanCodes(root->left, huffmanCodes, codeLengths, (code << 1), depth + 1);
+    }
+
+    if (root->right != NULL) {
+        generateHuffmanCodes(root->right, huffmanCodes, codeLengths, (code << 1) | 1, depth + 1);
+    }
+}
+
+void freeHuffmanTree(HuffmanNode *root) {
+    if (root == NULL) {
+        return;
+    }
+    freeHuffmanTree(root->left);
+    freeHuffmanTree(root->right);
+    free(root);
+}
+
+void buildHuffmanCodes(int frequencies[], int huffmanCodes[], unsigned char codeLengths[]) {
+    memset(huffmanCodes, 0, sizeof(int) * 256);
+    memset(codeLengths, 0, sizeof(unsigned char) * 256);
+
+    perf_region_begin("buildHuffmanCodes");
+    perf_region_begin("buildHuffmanTree");
+    HuffmanNode *root = buildHuffmanTree(frequencies);
+    perf_region_end();
+    if (root == NULL) {
+        perf_region_end();
+        return;
+    }
+    if (root->left == NULL && root->right == NULL) {
+        // Egyetlen szimbolum eseten is legyen 1 bites kod, kulonben nem dekodolhato.
+        codeLengths[root->data] = 1;
+    } else {
+        // A rekurzio miatt a regio a hivas korul van, nem a fuggvenyben.
+        perf_region_begin("generateHuffmanCodes");
+        generateHuffmanCodes(root, huffmanCodes, codeLengths, 0, 0);
+        perf_region_end();
+    }
+    freeHuffmanTree(root);
+    perf_region_end();
+}
+
+void canonicalHuffmanCodes(const unsigned char codeLengths[], int huffmanCodes[]) {
+    int code = 0;
+    int previous_length = 0;
+
+    memset(huffmanCodes, 0, sizeof(int) * 256);
+    for (int length = 1; length < 32; length++) {
+        for (int s = 0; s < 256; s++) {
+            if (codeLengths[s] != length) {
+                continue;
+            }
+            code <<= length - previous_length;
+            previous_length = length;
+            huffmanCodes[s] = code++;
+        }
+    }
+}
+
+size_t packedHuffmanSize(const unsigned char *input, int input_size, const unsigned char codeLengths[]) {
+    size_t bits = 0;
+    for (int i = 0; i < input_size; i++) {
+        bits += codeLengths[input[i]];
+    }
+    return (bits + 7) / 8;
+}
+
+size_t packHuffmanBits(const int *encoded_data, const unsigned char *input, int input_size,
+                       const unsigned char codeLengths[], unsigned char *output) {
+    size_t bit = 0;
+    unsigned int buffer = 0;
+    int filled = 0;
+
+    perf_region_begin("packHuffmanBits");
+    for (int i = 0; i < input_size; i++) {
+        int length = codeLengths[input[i]];
+        unsigned int code = (unsigned int)encoded_data[i];
+        for (int j = length - 1; j >= 0; j--) {
+            buffer = (buffer << 1) | ((code >> j) & 1);
+            if (++filled == 8) {
+                output[bit / 8] = (unsigned char)buffer;
+                buffer = 0;
+                filled = 0;
+            }
+            bit++;
+        }
+    }
+    if (filled > 0) {
+        output[bit / 8] = (unsigned char)(buffer << (8 - filled));
+    }
+    perf_region_end();
+    return bit;
+}
+
+int decodeHuffmanBits(const unsigned char *packed, size_t bit_count,
+                      const int huffmanCodes[], const unsigned char codeLengths[],
+                      unsigned char *output, int output_size) {
+    // Binaris trie a kodokbol: children[node][bit], a levelek -1 - szimbolum erteket kapnak.
+    int children[512][2];
+    int node_count = 1;
+    int symbols = 0;
+
+    memset(children, 0, sizeof(children));
+    for (int s = 0; s < 256; s++) {
+        if (codeLengths[s] == 0) {
+            continue;
+        }
+        if (codeLengths[s] > 31) {
+            return -1;
+        }
+        symbols++;
+        int node = 0;
+        // Egymas elotagjat alkoto kodok hibasak: a level nem irhato felul, es nem folytathato.
+        for (int j = codeLengths[s] - 1; j >= 0; j--) {
+            int b = (huffmanCodes[s] >> j) & 1;
+            if (j == 0) {
+                if (children[node][b] != 0) {
+                    return -1;
+                }
+                children[node][b] = -1 - s;
+            } else {
+                if (children[node][b] < 0) {
+                    return -1;
+                }
+                if (children[node][b] == 0) {
+                    if (node_count == 512) {
+                        return -1;
+                    }
+                    children[node][b] = node_count++;
+                }
+                node = children[node][b];
+            }
+        }
+    }
+
+    if (symbols == 0) {
+        return output_size == 0 ? 0 : -1;
+    }
+
+    size_t bit = 0;
+    for (int i = 0; i < output_size; i++) {
+        int node = 0;
+        for (;;) {
+            if (bit >= bit_count) {
+                return -1;
+            }
+            int b = (packed[bit / 8] >> (7 - bit % 8)) & 1;
+            bit++;
+            int next = children[node][b];
+            if (next < 0) {
+                output[i] = (unsigned char)(-1 - next);
+                break;
+            }
+            if (next == 0) {
+                return -1;
+            }
+            node = next;
+        }
+    }
+    return 0;
+}
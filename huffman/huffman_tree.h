@@ -0,0 +1,71 @@
+#ifndef HUFFMAN_TREE_H
+#define HUFFMAN_TREE_H
+
+#include <stddef.h>
+
+typedef struct HuffmanNode {
+    unsigned char data;
+    int frequency;
+    struct HuffmanNode *left, *right;
+} HuffmanNode;
+
+typedef struct PriorityQueueNode {
+    HuffmanNode *node;
+    struct PriorityQueueNode *next;
+} PriorityQueueNode;
+
+typedef struct PriorityQueue {
+    PriorityQueueNode *head;
+} PriorityQueue;
+
+PriorityQueue* createPriorityQueue();
+void enqueue(PriorityQueue *queue, HuffmanNode *node);
+HuffmanNode* dequeue(PriorityQueue *queue);
+
+/**
+ * Build the Huffman tree of the 256 byte frequencies.
+ * Returns NULL when every frequency is zero.
+ */
+HuffmanNode* buildHuffmanTree(int frequencies[]);
+
+void generateHuffmanCodes(HuffmanNode *root, int huffmanCodes[], unsigned char codeLengths[], int code, int depth);
+void freeHuffmanTree(HuffmanNode *root);
+
+/**
+ * Tree building and code generation in one step. A single distinct
+ * symbol gets a 1 bit code so that the stream stays decodable.
+ */
+void buildHuffmanCodes(int frequencies[], int huffmanCodes[], unsigned char codeLengths[]);
+
+/**
+ * Reassign the codes in canonical order (by length, then by symbol), so
+ * that the code lengths alone describe the table.
+ */
+void canonicalHuffmanCodes(const unsigned char codeLengths[], int huffmanCodes[]);
+
+/**
+ * Pack the per-symbol codes of encode_input into an MSB-first bit stream.
+ *
+ * encoded_data: Code of every input symbol (output of the encode_input kernel)
+ * output: At least packedHuffmanSize(...) bytes
+ *
+ * Returns the number of bits written
+ */
+size_t packHuffmanBits(const int *encoded_data, const unsigned char *input, int input_size,
+                       const unsigned char codeLengths[], unsigned char *output);
+
+/**
+ * Upper bound of the packed size in bytes.
+ */
+size_t packedHuffmanSize(const unsigned char *input, int input_size, const unsigned char codeLengths[]);
+
+/**
+ * Decode output_size symbols from an MSB-first bit stream.
+ *
+ * Returns 0 on success, -1 on a corrupt stream
+ */
+int decodeHuffmanBits(const unsigned char *packed, size_t bit_count,
+                      const int huffmanCodes[], const unsigned char codeLengths[],
+                      unsigned char *output, int output_size);
+
+#endif
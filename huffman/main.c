@@ -3,52 +3,26 @@
 #include <string.h>
 #define CL_TARGET_OPENCL_VERSION 220
 #include <CL/cl.h>
+#ifndef DEVICE_TYPE
+#define DEVICE_TYPE CL_DEVICE_TYPE_GPU
+#endif
 #include "kernel_loader.h"
+#include "device_pool.h"
+#include "huffman_tree.h"
+#include "kernel_cache.h"
+#include "block_huffman.h"
+#include "rans.h"
+#include "task_graph.h"
+#include "perf_regions.h"
 #include <time.h>
 
-typedef struct HuffmanNode {
-    unsigned char data;
-    int frequency;
-    struct HuffmanNode *left, *right;
-} HuffmanNode;
-
-typedef struct PriorityQueueNode {
-    HuffmanNode *node;
-    struct PriorityQueueNode *next;
-} PriorityQueueNode;
-
-typedef struct PriorityQueue {
-    PriorityQueueNode *head;
-} PriorityQueue;
-
-PriorityQueue* createPriorityQueue() {
-    PriorityQueue *queue = (PriorityQueue*)malloc(sizeof(PriorityQueue));
-    queue->head = NULL;
-    return queue;
-}
-
-void enqueue(PriorityQueue *queue, HuffmanNode *node) {
-    PriorityQueueNode *newNode = (PriorityQueueNode*)malloc(sizeof(PriorityQueueNode));
-    newNode->node = node;
-    newNode->next = NULL;
-
-    if (queue->head == NULL || queue->head->node->frequency > node->frequency) {
-        newNode->next = queue->head;
-        queue->head = newNode;
-    } else {
-        PriorityQueueNode *current = queue->head;
-        while (current->next != NULL && current->next->node->frequency <= node->frequency) {
-            current = current->next;
-        }
-        newNode->next = current->next;
-        current->next = newNode;
-    }
-}
+#define HISTOGRAM_GROUP_SIZE 256
 
 void generateRandomString(int length, char *output) {
     const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
     int alphabetSize = sizeof(alphabet) - 1;
 
+    perf_region_begin("generateRandomString");
     srand((unsigned int)time(NULL));
 
     for (int i = 0; i < length; i++) {
@@ -56,74 +30,863 @@ void generateRandomString(int length, char *output) {
     }
 
     output[length] = '\0';
+    perf_region_end();
 }
 
-HuffmanNode* dequeue(PriorityQueue *queue) {
-    if (queue->head == NULL) {
-        return NULL;
+// Vegyes tartalmu teszt bemenet: valtakozo hosszu szakaszok nagybetus, szamjegyes,
+// kisbetus szoveges es veletlen binaris adatbol.
+void generateMixedContent(int length, unsigned char *output) {
+    const char text[] = "eeeeeeeeeeeettttttttaaaaaaaoooooooiiiiiinnnnnnsssssshhhhhrrrrrddddllllcuumwfgypbvk     ";
+    int position = 0;
+    int kind = 0;
+
+    perf_region_begin("generateMixedContent");
+    srand((unsigned int)time(NULL));
+    while (position < length) {
+        int segment = 16384 * (1 + rand() % 16);
+        if (segment > length - position) {
+            segment = length - position;
+        }
+        for (int i = 0; i < segment; i++) {
+            switch (kind) {
+            case 0:
+                output[position + i] = (unsigned char)('A' + rand() % 26);
+                break;
+            case 1:
+                output[position + i] = (unsigned char)('0' + rand() % 10);
+                break;
+            case 2:
+                output[position + i] = (unsigned char)text[rand() % (sizeof(text) - 1)];
+                break;
+            default:
+                output[position + i] = (unsigned char)(rand() % 256);
+                break;
+            }
+        }
+        position += segment;
+        kind = (kind + 1 + rand() % 3) % 4;
+    }
+    perf_region_end();
+}
+
+void checkError(cl_int err, const char *operation) {
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Hiba: %s (%d)\n", operation, err);
+        exit(1);
     }
-    PriorityQueueNode *temp = queue->head;
-    HuffmanNode *node = temp->node;
-    queue->head = queue->head->next;
-    free(temp);
-    return node;
 }
 
-HuffmanNode* buildHuffmanTree(int frequencies[]) {
-    PriorityQueue *queue = createPriorityQueue();
+double nowMs() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
 
-    for (int i = 0; i < 256; i++) {
-        if (frequencies[i] > 0) {
-            HuffmanNode *node = (HuffmanNode*)malloc(sizeof(HuffmanNode));
-            node->data = (unsigned char)i;
-            node->frequency = frequencies[i];
-            node->left = node->right = NULL;
-            enqueue(queue, node);
+// Egy teljes kodolasi kor: bufferek a poolbol, frekvenciak, fa, kodolas, visszaolvasas.
+// Az alloc_ms-be a bufferek foglalasara es felszabaditasara forditott host ido kerul.
+void encodeOnDevice(cl_command_queue queue, cl_kernel calculate_frequencies_kernel, cl_kernel encode_input_kernel,
+                    DevicePool *pool, const char *input, int input_size,
+                    int frequencies[], int huffmanCodes[], unsigned char codeLengths[], int *encoded_data,
+                    cl_event *event1, cl_event *event2, double *alloc_ms) {
+    cl_int err;
+    double start = nowMs();
+
+    cl_mem input_buffer = pool_acquire(pool, sizeof(char) * input_size, &err);
+    checkError(err, "pool_acquire (input_buffer)");
+    cl_mem frequencies_buffer = pool_acquire(pool, sizeof(int) * 256, &err);
+    checkError(err, "pool_acquire (frequencies_buffer)");
+    cl_mem huffman_codes_buffer = pool_acquire(pool, sizeof(int) * 256, &err);
+    checkError(err, "pool_acquire (huffman_codes_buffer)");
+    cl_mem code_lengths_buffer = pool_acquire(pool, sizeof(unsigned char) * 256, &err);
+    checkError(err, "pool_acquire (code_lengths_buffer)");
+    cl_mem encoded_data_buffer = pool_acquire(pool, sizeof(int) * input_size, &err);
+    checkError(err, "pool_acquire (encoded_data_buffer)");
+
+    double allocated = nowMs();
+
+    memset(frequencies, 0, sizeof(int) * 256);
+    err = clEnqueueWriteBuffer(queue, input_buffer, CL_FALSE, 0, sizeof(char) * input_size, input, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(queue, frequencies_buffer, CL_FALSE, 0, sizeof(int) * 256, frequencies, 0, NULL, NULL);
+    checkError(err, "clEnqueueWriteBuffer (input)");
+
+    err = clSetKernelArg(calculate_frequencies_kernel, 0, sizeof(cl_mem), &input_buffer);
+    err |= clSetKernelArg(calculate_frequencies_kernel, 1, sizeof(cl_mem), &frequencies_buffer);
+    err |= clSetKernelArg(calculate_frequencies_kernel, 2, sizeof(int), &input_size);
+    checkError(err, "clSetKernelArg (calculate_frequencies)");
+
+    // A specializalt frekvencia kernel lokalis hisztogramja miatt rogzitett munkacsoport meret.
+    size_t local_work_size = HISTOGRAM_GROUP_SIZE;
+    size_t global_work_size = input_size;
+    size_t histogram_work_size = (input_size + HISTOGRAM_GROUP_SIZE - 1) / HISTOGRAM_GROUP_SIZE * HISTOGRAM_GROUP_SIZE;
+
+    err = clEnqueueNDRangeKernel(queue, calculate_frequencies_kernel, 1, NULL, &histogram_work_size, &local_work_size, 0, NULL, event1);
+    checkError(err, "clEnqueueNDRangeKernel (calculate_frequencies)");
+
+    err = clEnqueueReadBuffer(queue, frequencies_buffer, CL_TRUE, 0, sizeof(int) * 256, frequencies, 0, NULL, NULL);
+    checkError(err, "clEnqueueReadBuffer (frequencies)");
+
+    buildHuffmanCodes(frequencies, huffmanCodes, codeLengths);
+
+    err = clEnqueueWriteBuffer(queue, huffman_codes_buffer, CL_FALSE, 0, sizeof(int) * 256, huffmanCodes, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(queue, code_lengths_buffer, CL_FALSE, 0, sizeof(unsigned char) * 256, codeLengths, 0, NULL, NULL);
+    checkError(err, "clEnqueueWriteBuffer (codes)");
+
+    err = clSetKernelArg(encode_input_kernel, 0, sizeof(cl_mem), &input_buffer);
+    err |= clSetKernelArg(encode_input_kernel, 1, sizeof(cl_mem), &huffman_codes_buffer);
+    err |= clSetKernelArg(encode_input_kernel, 2, sizeof(cl_mem), &code_lengths_buffer);
+    err |= clSetKernelArg(encode_input_kernel, 3, sizeof(cl_mem), &encoded_data_buffer);
+    err |= clSetKernelArg(encode_input_kernel, 4, sizeof(int), &input_size);
+    checkError(err, "clSetKernelArg (encode_input)");
+
+    err = clEnqueueNDRangeKernel(queue, encode_input_kernel, 1, NULL, &global_work_size, NULL, 0, NULL, event2);
+    checkError(err, "clEnqueueNDRangeKernel (encode_input)");
+
+    err = clEnqueueReadBuffer(queue, encoded_data_buffer, CL_TRUE, 0, sizeof(int) * input_size, encoded_data, 0, NULL, NULL);
+    checkError(err, "clEnqueueReadBuffer (encoded_data)");
+
+    double released = nowMs();
+    pool_release(pool, input_buffer);
+    pool_release(pool, frequencies_buffer);
+    pool_release(pool, huffman_codes_buffer);
+    pool_release(pool, code_lengths_buffer);
+    pool_release(pool, encoded_data_buffer);
+
+    if (alloc_ms != NULL) {
+        *alloc_ms = (allocated - start) + (nowMs() - released);
+    }
+}
+
+// Blokk-adaptiv kodolas: blokkonkenti hisztogramok egy inditassal, a hoston tablavalasztas,
+// majd kodolas blokkonkent a sajat tablaval. A plan-t a hivo szabaditja fel.
+void encodeBlocksOnDevice(cl_command_queue queue, cl_kernel block_frequencies_kernel, cl_kernel encode_blocks_kernel,
+                          DevicePool *pool, const unsigned char *input, int input_size, int block_size,
+                          BlockHuffmanPlan *plan, int *encoded_data, cl_event *event1, cl_event *event2) {
+    cl_int err;
+    int block_count = (input_size + block_size - 1) / block_size;
+    size_t global_work_size = input_size;
+
+    int *block_frequencies = (int *)calloc((size_t)block_count * 256, sizeof(int));
+    cl_mem input_buffer = pool_acquire(pool, sizeof(char) * input_size, &err);
+    checkError(err, "pool_acquire (input_buffer)");
+    cl_mem frequencies_buffer = pool_acquire(pool, sizeof(int) * 256 * block_count, &err);
+    checkError(err, "pool_acquire (block_frequencies_buffer)");
+    cl_mem encoded_data_buffer = pool_acquire(pool, sizeof(int) * input_size, &err);
+    checkError(err, "pool_acquire (encoded_data_buffer)");
+
+    err = clEnqueueWriteBuffer(queue, input_buffer, CL_FALSE, 0, sizeof(char) * input_size, input, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(queue, frequencies_buffer, CL_FALSE, 0, sizeof(int) * 256 * block_count,
+                                block_frequencies, 0, NULL, NULL);
+    checkError(err, "clEnqueueWriteBuffer (input)");
+
+    err = clSetKernelArg(block_frequencies_kernel, 0, sizeof(cl_mem), &input_buffer);
+    err |= clSetKernelArg(block_frequencies_kernel, 1, sizeof(cl_mem), &frequencies_buffer);
+    err |= clSetKernelArg(block_frequencies_kernel, 2, sizeof(int), &input_size);
+    err |= clSetKernelArg(block_frequencies_kernel, 3, sizeof(int), &block_size);
+    checkError(err, "clSetKernelArg (calculate_block_frequencies)");
+
+    err = clEnqueueNDRangeKernel(queue, block_frequencies_kernel, 1, NULL, &global_work_size, NULL, 0, NULL, event1);
+    checkError(err, "clEnqueueNDRangeKernel (calculate_block_frequencies)");
+
+    err = clEnqueueReadBuffer(queue, frequencies_buffer, CL_TRUE, 0, sizeof(int) * 256 * block_count,
+                              block_frequencies, 0, NULL, NULL);
+    checkError(err, "clEnqueueReadBuffer (block_frequencies)");
+
+    if (planHuffmanBlocks(block_frequencies, input_size, block_size, plan) != 0) {
+        fprintf(stderr, "Hiba: nincs eleg memoria a blokk tablakhoz\n");
+        exit(1);
+    }
+
+    int *codes = (int *)malloc(sizeof(int) * 256 * plan->table_count);
+    for (int t = 0; t < plan->table_count; t++) {
+        memcpy(codes + t * 256, plan->tables[t].huffmanCodes, sizeof(int) * 256);
+    }
+    cl_mem codes_buffer = pool_acquire(pool, sizeof(int) * 256 * plan->table_count, &err);
+    checkError(err, "pool_acquire (huffman_codes_buffer)");
+    cl_mem block_table_buffer = pool_acquire(pool, sizeof(int) * block_count, &err);
+    checkError(err, "pool_acquire (block_table_buffer)");
+
+    err = clEnqueueWriteBuffer(queue, codes_buffer, CL_FALSE, 0, sizeof(int) * 256 * plan->table_count, codes, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(queue, block_table_buffer, CL_FALSE, 0, sizeof(int) * block_count, plan->block_table, 0, NULL, NULL);
+    checkError(err, "clEnqueueWriteBuffer (codes)");
+
+    err = clSetKernelArg(encode_blocks_kernel, 0, sizeof(cl_mem), &input_buffer);
+    err |= clSetKernelArg(encode_blocks_kernel, 1, sizeof(cl_mem), &codes_buffer);
+    err |= clSetKernelArg(encode_blocks_kernel, 2, sizeof(cl_mem), &block_table_buffer);
+    err |= clSetKernelArg(encode_blocks_kernel, 3, sizeof(cl_mem), &encoded_data_buffer);
+    err |= clSetKernelArg(encode_blocks_kernel, 4, sizeof(int), &input_size);
+    err |= clSetKernelArg(encode_blocks_kernel, 5, sizeof(int), &block_size);
+    checkError(err, "clSetKernelArg (encode_blocks)");
+
+    err = clEnqueueNDRangeKernel(queue, encode_blocks_kernel, 1, NULL, &global_work_size, NULL, 0, NULL, event2);
+    checkError(err, "clEnqueueNDRangeKernel (encode_blocks)");
+
+    err = clEnqueueReadBuffer(queue, encoded_data_buffer, CL_TRUE, 0, sizeof(int) * input_size, encoded_data, 0, NULL, NULL);
+    checkError(err, "clEnqueueReadBuffer (encoded_data)");
+
+    pool_release(pool, input_buffer);
+    pool_release(pool, frequencies_buffer);
+    pool_release(pool, encoded_data_buffer);
+    pool_release(pool, codes_buffer);
+    pool_release(pool, block_table_buffer);
+    free(codes);
+    free(block_frequencies);
+}
+
+// Egy tablas es blokk-adaptiv kodolas osszehasonlitasa: tomoritesi arany, atbocsatas
+// (eszkoz + bitcsomagolas) es visszafejtes ellenorzese.
+void blockBenchmark(cl_context context, cl_device_id device_id, cl_command_queue queue, cl_program program,
+                    cl_kernel calculate_frequencies_kernel, cl_kernel encode_input_kernel,
+                    const unsigned char *input, int input_size, int block_size, int iterations) {
+    cl_int err;
+    int frequencies[256];
+    int huffmanCodes[256];
+    unsigned char codeLengths[256];
+    int *encoded_data = (int *)malloc(sizeof(int) * input_size);
+    unsigned char *decoded = (unsigned char *)malloc(input_size);
+
+    cl_kernel block_frequencies_kernel = clCreateKernel(program, "calculate_block_frequencies", &err);
+    checkError(err, "clCreateKernel (calculate_block_frequencies)");
+    cl_kernel encode_blocks_kernel = clCreateKernel(program, "encode_blocks", &err);
+    checkError(err, "clCreateKernel (encode_blocks)");
+
+    DevicePool pool;
+    pool_init(&pool, context, device_id, POOL_DEFAULT_BLOCK_SIZE);
+
+    // Egy tabla az egesz bemenetre.
+    size_t bits = 0;
+    unsigned char *single_output = (unsigned char *)malloc(input_size * 4 + 1);
+    double start = nowMs();
+    for (int i = 0; i < iterations; i++) {
+        cl_event event1, event2;
+        encodeOnDevice(queue, calculate_frequencies_kernel, encode_input_kernel, &pool, (const char *)input, input_size,
+                       frequencies, huffmanCodes, codeLengths, encoded_data, &event1, &event2, NULL);
+        clReleaseEvent(event1);
+        clReleaseEvent(event2);
+        bits = packHuffmanBits(encoded_data, input, input_size, codeLengths, single_output);
+    }
+    double single_ms = (nowMs() - start) / iterations;
+    HuffmanTable table;
+    memcpy(table.codeLengths, codeLengths, sizeof(codeLengths));
+    size_t single_size = huffmanTableHeaderSize(&table) + 4 + (bits + 7) / 8;
+    int ok = decodeHuffmanBits(single_output, bits, huffmanCodes, codeLengths, decoded, input_size) == 0
+             && memcmp(decoded, input, input_size) == 0;
+    printf("egy tabla:    %zu bajt, arany %.3f, %.1f MB/s, dekodolas %s\n", single_size,
+           (double)single_size / input_size, input_size / 1e3 / single_ms, ok ? "OK" : "HIBAS");
+    free(single_output);
+
+    // Blokkonkenti tablak.
+    BlockHuffmanPlan plan = {0};
+    size_t block_output_size = 0;
+    unsigned char *block_output = NULL;
+    start = nowMs();
+    for (int i = 0; i < iterations; i++) {
+        cl_event event1, event2;
+        freeHuffmanBlockPlan(&plan);
+        encodeBlocksOnDevice(queue, block_frequencies_kernel, encode_blocks_kernel, &pool, input, input_size,
+                             block_size, &plan, encoded_data, &event1, &event2);
+        clReleaseEvent(event1);
+        clReleaseEvent(event2);
+        free(block_output);
+        block_output = (unsigned char *)malloc(blockHuffmanBound(&plan, input, input_size));
+        block_output_size = writeHuffmanBlocks(&plan, encoded_data, input, input_size, block_output);
+    }
+    double block_ms = (nowMs() - start) / iterations;
+    ok = readHuffmanBlocks(block_output, block_output_size, decoded, input_size) == input_size
+             && memcmp(decoded, input, input_size) == 0;
+    printf("blokkonkent:  %zu bajt, arany %.3f, %.1f MB/s, dekodolas %s\n", block_output_size,
+           (double)block_output_size / input_size, input_size / 1e3 / block_ms, ok ? "OK" : "HIBAS");
+    printf("  %d blokk (%d bajt), %d uj tabla, %d ujrahasznositott\n", plan.block_count, block_size,
+           plan.table_count, plan.block_count - plan.table_count);
+    printf("  meretvaltozas az egy tablahoz kepest: %+.2f%%\n",
+           100.0 * ((double)block_output_size - (double)single_size) / single_size);
+
+    free(block_output);
+    freeHuffmanBlockPlan(&plan);
+    pool_destroy(&pool);
+    clReleaseKernel(block_frequencies_kernel);
+    clReleaseKernel(encode_blocks_kernel);
+    free(decoded);
+    free(encoded_data);
+}
+
+// rANS kodolas az eszkozon: ugyanaz a calculate_frequencies hisztogram, kvantalas a hoston,
+// majd savonkent egy munkaelem kodol. A kimenet savonkent a lane_words vegen all.
+void ransEncodeOnDevice(cl_command_queue queue, cl_kernel calculate_frequencies_kernel, cl_kernel rans_encode_kernel,
+                        DevicePool *pool, const unsigned char *input, int input_size, int lanes,
+                        RansTable *table, uint16_t *lane_words, uint32_t *lane_counts) {
+    cl_int err;
+    int frequencies[256] = {0};
+    int lane_capacity = ransLaneCapacity(input_size, lanes);
+    size_t words_size = sizeof(uint16_t) * (size_t)lanes * lane_capacity;
+
+    cl_mem input_buffer = pool_acquire(pool, sizeof(char) * input_size, &err);
+    checkError(err, "pool_acquire (input_buffer)");
+    cl_mem frequencies_buffer = pool_acquire(pool, sizeof(int) * 256, &err);
+    checkError(err, "pool_acquire (frequencies_buffer)");
+    cl_mem freq_buffer = pool_acquire(pool, sizeof(uint16_t) * 256, &err);
+    checkError(err, "pool_acquire (freq_buffer)");
+    cl_mem start_buffer = pool_acquire(pool, sizeof(uint16_t) * 256, &err);
+    checkError(err, "pool_acquire (start_buffer)");
+    cl_mem words_buffer = pool_acquire(pool, words_size, &err);
+    checkError(err, "pool_acquire (words_buffer)");
+    cl_mem counts_buffer = pool_acquire(pool, sizeof(uint32_t) * lanes, &err);
+    checkError(err, "pool_acquire (counts_buffer)");
+
+    err = clEnqueueWriteBuffer(queue, input_buffer, CL_FALSE, 0, sizeof(char) * input_size, input, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(queue, frequencies_buffer, CL_FALSE, 0, sizeof(int) * 256, frequencies, 0, NULL, NULL);
+    checkError(err, "clEnqueueWriteBuffer (input)");
+
+    err = clSetKernelArg(calculate_frequencies_kernel, 0, sizeof(cl_mem), &input_buffer);
+    err |= clSetKernelArg(calculate_frequencies_kernel, 1, sizeof(cl_mem), &frequencies_buffer);
+    err |= clSetKernelArg(calculate_frequencies_kernel, 2, sizeof(int), &input_size);
+    checkError(err, "clSetKernelArg (calculate_frequencies)");
+
+    size_t local_work_size = HISTOGRAM_GROUP_SIZE;
+    size_t histogram_work_size = (input_size + HISTOGRAM_GROUP_SIZE - 1) / HISTOGRAM_GROUP_SIZE * HISTOGRAM_GROUP_SIZE;
+    err = clEnqueueNDRangeKernel(queue, calculate_frequencies_kernel, 1, NULL, &histogram_work_size, &local_work_size, 0, NULL, NULL);
+    checkError(err, "clEnqueueNDRangeKernel (calculate_frequencies)");
+
+    err = clEnqueueReadBuffer(queue, frequencies_buffer, CL_TRUE, 0, sizeof(int) * 256, frequencies, 0, NULL, NULL);
+    checkError(err, "clEnqueueReadBuffer (frequencies)");
+
+    ransBuildTable(frequencies, table);
+
+    err = clEnqueueWriteBuffer(queue, freq_buffer, CL_FALSE, 0, sizeof(uint16_t) * 256, table->freq, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(queue, start_buffer, CL_FALSE, 0, sizeof(uint16_t) * 256, table->start, 0, NULL, NULL);
+    checkError(err, "clEnqueueWriteBuffer (rans table)");
+
+    err = clSetKernelArg(rans_encode_kernel, 0, sizeof(cl_mem), &input_buffer);
+    err |= clSetKernelArg(rans_encode_kernel, 1, sizeof(cl_mem), &freq_buffer);
+    err |= clSetKernelArg(rans_encode_kernel, 2, sizeof(cl_mem), &start_buffer);
+    err |= clSetKernelArg(rans_encode_kernel, 3, sizeof(cl_mem), &words_buffer);
+    err |= clSetKernelArg(rans_encode_kernel, 4, sizeof(cl_mem), &counts_buffer);
+    err |= clSetKernelArg(rans_encode_kernel, 5, sizeof(int), &input_size);
+    err |= clSetKernelArg(rans_encode_kernel, 6, sizeof(int), &lanes);
+    err |= clSetKernelArg(rans_encode_kernel, 7, sizeof(int), &lane_capacity);
+    checkError(err, "clSetKernelArg (rans_encode)");
+
+    size_t group_size = RANS_GROUP_SIZE;
+    size_t lane_work_size = (lanes + RANS_GROUP_SIZE - 1) / RANS_GROUP_SIZE * RANS_GROUP_SIZE;
+    err = clEnqueueNDRangeKernel(queue, rans_encode_kernel, 1, NULL, &lane_work_size, &group_size, 0, NULL, NULL);
+    checkError(err, "clEnqueueNDRangeKernel (rans_encode)");
+
+    err = clEnqueueReadBuffer(queue, words_buffer, CL_FALSE, 0, words_size, lane_words, 0, NULL, NULL);
+    err |= clEnqueueReadBuffer(queue, counts_buffer, CL_TRUE, 0, sizeof(uint32_t) * lanes, lane_counts, 0, NULL, NULL);
+    checkError(err, "clEnqueueReadBuffer (rans)");
+
+    pool_release(pool, input_buffer);
+    pool_release(pool, frequencies_buffer);
+    pool_release(pool, freq_buffer);
+    pool_release(pool, start_buffer);
+    pool_release(pool, words_buffer);
+    pool_release(pool, counts_buffer);
+}
+
+// rANS dekodolas az eszkozon: a folyam szavai valtozatlanul (little endian) toltodnek fel.
+int ransDecodeOnDevice(cl_command_queue queue, cl_kernel rans_decode_kernel, DevicePool *pool,
+                       const unsigned char *stream, size_t stream_size, unsigned char *output, int output_capacity) {
+    cl_int err;
+    RansTable table;
+    uint32_t *lane_offsets;
+    const unsigned char *words;
+    int input_size = -1;
+    int lanes;
+
+    if (ransParseStream(stream, stream_size, &table, &input_size, &lanes, &lane_offsets, &words) != 0
+        || input_size > output_capacity || input_size == 0) {
+        free(lane_offsets);
+        return input_size == 0 ? 0 : -1;
+    }
+
+    size_t words_size = sizeof(uint16_t) * lane_offsets[lanes];
+    cl_mem words_buffer = pool_acquire(pool, words_size, &err);
+    checkError(err, "pool_acquire (words_buffer)");
+    cl_mem offsets_buffer = pool_acquire(pool, sizeof(uint32_t) * (lanes + 1), &err);
+    checkError(err, "pool_acquire (offsets_buffer)");
+    cl_mem slots_buffer = pool_acquire(pool, RANS_PROB_SCALE, &err);
+    checkError(err, "pool_acquire (slots_buffer)");
+    cl_mem freq_buffer = pool_acquire(pool, sizeof(uint16_t) * 256, &err);
+    checkError(err, "pool_acquire (freq_buffer)");
+    cl_mem start_buffer = pool_acquire(pool, sizeof(uint16_t) * 256, &err);
+    checkError(err, "pool_acquire (start_buffer)");
+    cl_mem output_buffer = pool_acquire(pool, input_size, &err);
+    checkError(err, "pool_acquire (output_buffer)");
+
+    err = clEnqueueWriteBuffer(queue, words_buffer, CL_FALSE, 0, words_size, words, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(queue, offsets_buffer, CL_FALSE, 0, sizeof(uint32_t) * (lanes + 1), lane_offsets, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(queue, slots_buffer, CL_FALSE, 0, RANS_PROB_SCALE, table.slot_symbol, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(queue, freq_buffer, CL_FALSE, 0, sizeof(uint16_t) * 256, table.freq, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(queue, start_buffer, CL_FALSE, 0, sizeof(uint16_t) * 256, table.start, 0, NULL, NULL);
+    checkError(err, "clEnqueueWriteBuffer (rans stream)");
+
+    err = clSetKernelArg(rans_decode_kernel, 0, sizeof(cl_mem), &words_buffer);
+    err |= clSetKernelArg(rans_decode_kernel, 1, sizeof(cl_mem), &offsets_buffer);
+    err |= clSetKernelArg(rans_decode_kernel, 2, sizeof(cl_mem), &slots_buffer);
+    err |= clSetKernelArg(rans_decode_kernel, 3, sizeof(cl_mem), &freq_buffer);
+    err |= clSetKernelArg(rans_decode_kernel, 4, sizeof(cl_mem), &start_buffer);
+    err |= clSetKernelArg(rans_decode_kernel, 5, sizeof(cl_mem), &output_buffer);
+    err |= clSetKernelArg(rans_decode_kernel, 6, sizeof(int), &input_size);
+    err |= clSetKernelArg(rans_decode_kernel, 7, sizeof(int), &lanes);
+    checkError(err, "clSetKernelArg (rans_decode)");
+
+    size_t group_size = RANS_GROUP_SIZE;
+    size_t lane_work_size = (lanes + RANS_GROUP_SIZE - 1) / RANS_GROUP_SIZE * RANS_GROUP_SIZE;
+    err = clEnqueueNDRangeKernel(queue, rans_decode_kernel, 1, NULL, &lane_work_size, &group_size, 0, NULL, NULL);
+    checkError(err, "clEnqueueNDRangeKernel (rans_decode)");
+
+    err = clEnqueueReadBuffer(queue, output_buffer, CL_TRUE, 0, input_size, output, 0, NULL, NULL);
+    checkError(err, "clEnqueueReadBuffer (output)");
+
+    pool_release(pool, words_buffer);
+    pool_release(pool, offsets_buffer);
+    pool_release(pool, slots_buffer);
+    pool_release(pool, freq_buffer);
+    pool_release(pool, start_buffer);
+    pool_release(pool, output_buffer);
+    free(lane_offsets);
+    return input_size;
+}
+
+// Huffman es rANS osszehasonlitasa: tomoritesi arany, kodolasi es dekodolasi MB/s
+// (eszkozon az adatmozgatassal es a folyam irasaval egyutt, illetve a hoston).
+void ransBenchmark(cl_context context, cl_device_id device_id, cl_command_queue queue, cl_program program,
+                   cl_kernel calculate_frequencies_kernel, cl_kernel encode_input_kernel,
+                   const unsigned char *input, int input_size, int lanes, int iterations) {
+    cl_int err;
+    int frequencies[256];
+    int huffmanCodes[256];
+    unsigned char codeLengths[256];
+    int *encoded_data = (int *)malloc(sizeof(int) * input_size);
+    unsigned char *decoded = (unsigned char *)malloc(input_size);
+    double start;
+
+    cl_kernel rans_encode_kernel = clCreateKernel(program, "rans_encode", &err);
+    checkError(err, "clCreateKernel (rans_encode)");
+    cl_kernel rans_decode_kernel = clCreateKernel(program, "rans_decode", &err);
+    checkError(err, "clCreateKernel (rans_decode)");
+
+    DevicePool pool;
+    pool_init(&pool, context, device_id, POOL_DEFAULT_BLOCK_SIZE);
+
+    // Huffman: kodolas az eszkozon, bitcsomagolas es dekodolas a hoston.
+    size_t bits = 0;
+    unsigned char *huffman_output = (unsigned char *)malloc((size_t)input_size * 4 + 1);
+    start = nowMs();
+    for (int i = 0; i < iterations; i++) {
+        cl_event event1, event2;
+        encodeOnDevice(queue, calculate_frequencies_kernel, encode_input_kernel, &pool, (const char *)input, input_size,
+                       frequencies, huffmanCodes, codeLengths, encoded_data, &event1, &event2, NULL);
+        clReleaseEvent(event1);
+        clReleaseEvent(event2);
+        bits = packHuffmanBits(encoded_data, input, input_size, codeLengths, huffman_output);
+    }
+    double huffman_encode_ms = (nowMs() - start) / iterations;
+    start = nowMs();
+    int ok = 1;
+    for (int i = 0; i < iterations; i++) {
+        ok &= decodeHuffmanBits(huffman_output, bits, huffmanCodes, codeLengths, decoded, input_size) == 0;
+    }
+    double huffman_decode_ms = (nowMs() - start) / iterations;
+    HuffmanTable huffman_table;
+    memcpy(huffman_table.codeLengths, codeLengths, sizeof(codeLengths));
+    size_t huffman_size = ENTROPY_STREAM_HEADER_SIZE + huffmanTableHeaderSize(&huffman_table) + (bits + 7) / 8;
+    ok = ok && memcmp(decoded, input, input_size) == 0;
+    printf("huffman:     arany %.4f, kodolas %.1f MB/s (eszkoz), dekodolas %.1f MB/s (host), %s\n",
+           (double)huffman_size / input_size, input_size / 1e3 / huffman_encode_ms,
+           input_size / 1e3 / huffman_decode_ms, ok ? "OK" : "HIBAS");
+    free(huffman_output);
+
+    // rANS az eszkozon.
+    RansTable table;
+    size_t words_count = (size_t)lanes * ransLaneCapacity(input_size, lanes);
+    uint16_t *lane_words = (uint16_t *)malloc(sizeof(uint16_t) * words_count);
+    uint32_t *lane_counts = (uint32_t *)malloc(sizeof(uint32_t) * lanes);
+    unsigned char *stream = (unsigned char *)malloc(ransStreamBound(input_size, lanes));
+    size_t stream_size = 0;
+
+    start = nowMs();
+    for (int i = 0; i < iterations; i++) {
+        ransEncodeOnDevice(queue, calculate_frequencies_kernel, rans_encode_kernel, &pool, input, input_size, lanes,
+                           &table, lane_words, lane_counts);
+        stream_size = ransWriteStream(&table, input_size, lanes, lane_words, lane_counts, stream);
+    }
+    double device_encode_ms = (nowMs() - start) / iterations;
+    start = nowMs();
+    ok = 1;
+    for (int i = 0; i < iterations; i++) {
+        ok &= ransDecodeOnDevice(queue, rans_decode_kernel, &pool, stream, stream_size, decoded, input_size) == input_size;
+    }
+    double device_decode_ms = (nowMs() - start) / iterations;
+    ok = ok && memcmp(decoded, input, input_size) == 0;
+    printf("rANS eszkoz: arany %.4f, kodolas %.1f MB/s, dekodolas %.1f MB/s, %d sav, %s\n",
+           (double)stream_size / input_size, input_size / 1e3 / device_encode_ms,
+           input_size / 1e3 / device_decode_ms, lanes, ok ? "OK" : "HIBAS");
+
+    // rANS a hoston, ugyanazzal a savkiosztassal.
+    for (int s = 0; s < 256; s++) {
+        frequencies[s] = 0;
+    }
+    for (int i = 0; i < input_size; i++) {
+        frequencies[input[i]]++;
+    }
+    start = nowMs();
+    for (int i = 0; i < iterations; i++) {
+        ransBuildTable(frequencies, &table);
+        ransEncodeLanes(&table, input, input_size, lanes, lane_words, lane_counts);
+        stream_size = ransWriteStream(&table, input_size, lanes, lane_words, lane_counts, stream);
+    }
+    double host_encode_ms = (nowMs() - start) / iterations;
+    start = nowMs();
+    ok = 1;
+    for (int i = 0; i < iterations; i++) {
+        ok &= decodeEntropyStream(stream, stream_size, decoded, input_size) == input_size;
+    }
+    double host_decode_ms = (nowMs() - start) / iterations;
+    ok = ok && memcmp(decoded, input, input_size) == 0;
+    printf("rANS host:   arany %.4f, kodolas %.1f MB/s, dekodolas %.1f MB/s, %s\n",
+           (double)stream_size / input_size, input_size / 1e3 / host_encode_ms,
+           input_size / 1e3 / host_decode_ms, ok ? "OK" : "HIBAS");
+
+    free(stream);
+    free(lane_words);
+    free(lane_counts);
+    pool_destroy(&pool);
+    clReleaseKernel(rans_encode_kernel);
+    clReleaseKernel(rans_decode_kernel);
+    free(decoded);
+    free(encoded_data);
+}
+
+// Ismetelt futtatas pool nelkul es pool-lal, iteracionkenti foglalasi idovel.
+void poolBenchmark(cl_context context, cl_device_id device_id, cl_command_queue queue,
+                   cl_kernel calculate_frequencies_kernel, cl_kernel encode_input_kernel,
+                   const char *input, int input_size, int iterations) {
+    int frequencies[256];
+    int huffmanCodes[256];
+    unsigned char codeLengths[256];
+    int *encoded_data = (int *)malloc(sizeof(int) * input_size);
+
+    for (int pooled = 0; pooled <= 1; pooled++) {
+        DevicePool pool;
+        pool_init(&pool, context, device_id, pooled ? POOL_DEFAULT_BLOCK_SIZE : 0);
+
+        double alloc_total = 0.0;
+        double start = nowMs();
+        for (int i = 0; i < iterations; i++) {
+            cl_event event1, event2;
+            double alloc_ms;
+            encodeOnDevice(queue, calculate_frequencies_kernel, encode_input_kernel, &pool, input, input_size,
+                           frequencies, huffmanCodes, codeLengths, encoded_data, &event1, &event2, &alloc_ms);
+            clReleaseEvent(event1);
+            clReleaseEvent(event2);
+            alloc_total += alloc_ms;
+        }
+        double total = nowMs() - start;
+
+        printf("%s: foglalas %.4f ms/iteracio, teljes kor %.3f ms/iteracio\n",
+               pooled ? "pool-lal" : "pool nelkul", alloc_total / iterations, total / iterations);
+        pool_print_stats(&pool, pooled ? "  device pool" : "  clCreateBuffer");
+        pool_destroy(&pool);
+    }
+
+    free(encoded_data);
+}
+
+// A bemenetben elofordulo legnagyobb szimbolum + 1, 32-re kerekitve (ALPHABET_SIZE).
+int alphabetSize(const char *input, int input_size) {
+    int max_symbol = 0;
+    for (int i = 0; i < input_size; i++) {
+        if ((unsigned char)input[i] > max_symbol) {
+            max_symbol = (unsigned char)input[i];
         }
     }
+    return (max_symbol + 1 + 31) / 32 * 32;
+}
+
+// Altalanos es az abecere specializalt frekvencia kernel osszehasonlitasa.
+void specializeBenchmark(cl_context context, cl_device_id device_id, cl_command_queue queue,
+                         cl_kernel calculate_frequencies_kernel, cl_kernel encode_input_kernel,
+                         const char *input, int input_size, int iterations) {
+    int frequencies[256];
+    int huffmanCodes[256];
+    unsigned char codeLengths[256];
+    int *encoded_data = (int *)malloc(sizeof(int) * input_size);
+    char options[64];
+    double compile_ms;
+    cl_int err;
 
-    while (queue->head != NULL && queue->head->next != NULL) {
-        HuffmanNode *left = dequeue(queue);
-        HuffmanNode *right = dequeue(queue);
+    KernelCache cache;
+    err = kernel_cache_init(&cache, context, device_id, "huffman.cl", NULL, 4, ".kernel_cache");
+    checkError(err, "kernel_cache_init");
+    snprintf(options, sizeof(options), "-DALPHABET_SIZE=%d", alphabetSize(input, input_size));
+    cl_program program = kernel_cache_get(&cache, options, &compile_ms, &err);
+    checkError(err, "kernel_cache_get");
+    cl_kernel specialized_kernel = clCreateKernel(program, "calculate_frequencies", &err);
+    checkError(err, "clCreateKernel (calculate_frequencies, specializalt)");
 
-        HuffmanNode *newNode = (HuffmanNode*)malloc(sizeof(HuffmanNode));
-        newNode->data = 0;
-        newNode->frequency = left->frequency + right->frequency;
-        newNode->left = left;
-        newNode->right = right;
+    DevicePool pool;
+    pool_init(&pool, context, device_id, POOL_DEFAULT_BLOCK_SIZE);
 
-        enqueue(queue, newNode);
+    double kernel_ms[2] = {0.0, 0.0};
+    for (int specialized = 0; specialized <= 1; specialized++) {
+        for (int i = 0; i < iterations; i++) {
+            cl_event event1, event2;
+            cl_ulong time_start, time_end;
+            encodeOnDevice(queue, specialized ? specialized_kernel : calculate_frequencies_kernel, encode_input_kernel,
+                           &pool, input, input_size, frequencies, huffmanCodes, codeLengths, encoded_data,
+                           &event1, &event2, NULL);
+            clGetEventProfilingInfo(event1, CL_PROFILING_COMMAND_START, sizeof(time_start), &time_start, NULL);
+            clGetEventProfilingInfo(event1, CL_PROFILING_COMMAND_END, sizeof(time_end), &time_end, NULL);
+            kernel_ms[specialized] += (double)(time_end - time_start) / 1000000.0 / iterations;
+            clReleaseEvent(event1);
+            clReleaseEvent(event2);
+        }
     }
 
-    HuffmanNode *root = dequeue(queue);
-    free(queue);
-    return root;
+    printf("altalanos frekvencia kernel: %.3f ms\n", kernel_ms[0]);
+    printf("specializalt (%s): %.3f ms, %.2fx\n", options, kernel_ms[1], kernel_ms[0] / kernel_ms[1]);
+    printf("forditas/betoltes: %.1f ms", compile_ms);
+    if (kernel_ms[0] > kernel_ms[1]) {
+        printf(", megterul %.1f futas utan", compile_ms / (kernel_ms[0] - kernel_ms[1]));
+    }
+    printf("\n");
+    kernel_cache_print_stats(&cache, "kernel cache");
+
+    pool_destroy(&pool);
+    clReleaseKernel(specialized_kernel);
+    kernel_cache_release(&cache);
+    free(encoded_data);
 }
 
-void checkError(cl_int err, const char *operation) {
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Hiba: %s (%d)\n", operation, err);
+#define PIPELINE_DEPTH 4
+
+// Egy blokk kodolasanak allapota a task graph egy slotjaban.
+typedef struct {
+    cl_mem input_buffer;
+    cl_mem frequencies_buffer;
+    cl_mem huffman_codes_buffer;
+    cl_mem code_lengths_buffer;
+    cl_mem encoded_data_buffer;
+    int frequencies[256];
+    int huffmanCodes[256];
+    unsigned char codeLengths[256];
+    int *encoded_data;
+    const unsigned char *input;
+    int input_size;
+    int block;
+    struct Pipeline *pipeline;
+} PipelineSlot;
+
+typedef struct Pipeline {
+    PipelineSlot slots[PIPELINE_DEPTH];
+    const unsigned char *input;
+    int block_size;
+    unsigned char *packed;
+    size_t packed_stride;
+    size_t *bit_counts;
+    double *start_ms;
+    double *done_ms;
+    int write_input, write_zero, histogram, read_frequencies, build, write_codes, write_lengths, encode, read_encoded, pack;
+} Pipeline;
+
+static const int zeroFrequencies[256] = {0};
+
+void pipelineBuildCodes(void *arg) {
+    PipelineSlot *slot = (PipelineSlot *)arg;
+    buildHuffmanCodes(slot->frequencies, slot->huffmanCodes, slot->codeLengths);
+}
+
+void pipelinePack(void *arg) {
+    PipelineSlot *slot = (PipelineSlot *)arg;
+    Pipeline *pipeline = slot->pipeline;
+    pipeline->bit_counts[slot->block] = packHuffmanBits(slot->encoded_data, slot->input, slot->input_size, slot->codeLengths,
+                                                        pipeline->packed + pipeline->packed_stride * slot->block);
+    pipeline->done_ms[slot->block] = nowMs();
+}
+
+// A graf csomopontjai az iteracio slotjanak buffereire es a soron kovetkezo blokkra allnak at.
+void pipelineBind(TaskGraph *graph, int iteration, int slot_index, void *user_data) {
+    Pipeline *pipeline = (Pipeline *)user_data;
+    PipelineSlot *slot = &pipeline->slots[slot_index];
+
+    slot->block = iteration;
+    slot->input = pipeline->input + (size_t)iteration * pipeline->block_size;
+    taskGraphBind(graph, pipeline->write_input, slot->input_buffer, (void *)slot->input);
+    taskGraphBind(graph, pipeline->write_zero, slot->frequencies_buffer, (void *)zeroFrequencies);
+    taskGraphSetArg(graph, pipeline->histogram, 0, sizeof(cl_mem), &slot->input_buffer);
+    taskGraphSetArg(graph, pipeline->histogram, 1, sizeof(cl_mem), &slot->frequencies_buffer);
+    taskGraphBind(graph, pipeline->read_frequencies, slot->frequencies_buffer, slot->frequencies);
+    taskGraphBind(graph, pipeline->build, NULL, slot);
+    taskGraphBind(graph, pipeline->write_codes, slot->huffman_codes_buffer, slot->huffmanCodes);
+    taskGraphBind(graph, pipeline->write_lengths, slot->code_lengths_buffer, slot->codeLengths);
+    taskGraphSetArg(graph, pipeline->encode, 0, sizeof(cl_mem), &slot->input_buffer);
+    taskGraphSetArg(graph, pipeline->encode, 1, sizeof(cl_mem), &slot->huffman_codes_buffer);
+    taskGraphSetArg(graph, pipeline->encode, 2, sizeof(cl_mem), &slot->code_lengths_buffer);
+    taskGraphSetArg(graph, pipeline->encode, 3, sizeof(cl_mem), &slot->encoded_data_buffer);
+    taskGraphBind(graph, pipeline->read_encoded, slot->encoded_data_buffer, slot->encoded_data);
+    taskGraphBind(graph, pipeline->pack, NULL, slot);
+    pipeline->start_ms[iteration] = nowMs();
+}
+
+// Blokkonkenti Huffman kodolas: a jelenlegi soros folyamat (encodeOnDevice + bitcsomagolas
+// blokkonkent) es ugyanez task graph-kent, PIPELINE_DEPTH blokkal egyszerre uton.
+void pipelineBenchmark(cl_context context, cl_device_id device_id, cl_command_queue queue,
+                       cl_kernel calculate_frequencies_kernel, cl_kernel encode_input_kernel,
+                       int block_count, int block_size) {
+    size_t input_size = (size_t)block_count * block_size;
+    size_t stride = sizeof(int) * (size_t)block_size + 8;
+    unsigned char *input = (unsigned char *)malloc(input_size);
+    unsigned char *packed[2] = {(unsigned char *)malloc(stride * block_count), (unsigned char *)malloc(stride * block_count)};
+    size_t *bit_counts[2] = {(size_t *)calloc(block_count, sizeof(size_t)), (size_t *)calloc(block_count, sizeof(size_t))};
+    double *start_ms = (double *)calloc(block_count, sizeof(double));
+    double *done_ms = (double *)calloc(block_count, sizeof(double));
+    int *encoded_data = (int *)malloc(sizeof(int) * block_size);
+    cl_int err;
+
+    if (input == NULL || packed[0] == NULL || packed[1] == NULL || bit_counts[0] == NULL || bit_counts[1] == NULL
+        || start_ms == NULL || done_ms == NULL || encoded_data == NULL) {
+        fprintf(stderr, "Nincs eleg memoria!\n");
         exit(1);
     }
-}
+    generateMixedContent((int)input_size, input);
+
+    DevicePool pool;
+    pool_init(&pool, context, device_id, POOL_DEFAULT_BLOCK_SIZE);
+
+    // Soros folyamat: minden blokknal a host var a frekvenciakra, majd a kodokra.
+    int frequencies[256];
+    int huffmanCodes[256];
+    unsigned char codeLengths[256];
+    double sequential_latency = 0.0;
+    double start = nowMs();
+    for (int b = 0; b < block_count; b++) {
+        cl_event event1, event2;
+        double block_start = nowMs();
+        const unsigned char *block = input + (size_t)b * block_size;
+        encodeOnDevice(queue, calculate_frequencies_kernel, encode_input_kernel, &pool, (const char *)block, block_size,
+                       frequencies, huffmanCodes, codeLengths, encoded_data, &event1, &event2, NULL);
+        bit_counts[0][b] = packHuffmanBits(encoded_data, block, block_size, codeLengths, packed[0] + stride * b);
+        clReleaseEvent(event1);
+        clReleaseEvent(event2);
+        sequential_latency += nowMs() - block_start;
+    }
+    double sequential_ms = nowMs() - start;
 
-void generateHuffmanCodes(HuffmanNode *root, int huffmanCodes[], unsigned char codeLengths[], int code, int depth) {
-    if (root->left == NULL && root->right == NULL) {
-        huffmanCodes[root->data] = code;
-        codeLengths[root->data] = depth;
-        return;
+    // Task graph: ugyanezek a lepesek csomopontokkent, a host munka event callbackben.
+    TaskExecutor executor;
+    err = taskExecutorInit(&executor, context, device_id);
+    checkError(err, "taskExecutorInit");
+
+    Pipeline pipeline;
+    memset(&pipeline, 0, sizeof(Pipeline));
+    pipeline.input = input;
+    pipeline.block_size = block_size;
+    pipeline.packed = packed[1];
+    pipeline.packed_stride = stride;
+    pipeline.bit_counts = bit_counts[1];
+    pipeline.start_ms = start_ms;
+    pipeline.done_ms = done_ms;
+    for (int s = 0; s < PIPELINE_DEPTH; s++) {
+        PipelineSlot *slot = &pipeline.slots[s];
+        slot->pipeline = &pipeline;
+        slot->input_size = block_size;
+        slot->encoded_data = (int *)malloc(sizeof(int) * block_size);
+        slot->input_buffer = pool_acquire(&pool, block_size, &err);
+        checkError(err, "pool_acquire (input_buffer)");
+        slot->frequencies_buffer = pool_acquire(&pool, sizeof(int) * 256, &err);
+        checkError(err, "pool_acquire (frequencies_buffer)");
+        slot->huffman_codes_buffer = pool_acquire(&pool, sizeof(int) * 256, &err);
+        checkError(err, "pool_acquire (huffman_codes_buffer)");
+        slot->code_lengths_buffer = pool_acquire(&pool, 256, &err);
+        checkError(err, "pool_acquire (code_lengths_buffer)");
+        slot->encoded_data_buffer = pool_acquire(&pool, sizeof(int) * block_size, &err);
+        checkError(err, "pool_acquire (encoded_data_buffer)");
+        if (slot->encoded_data == NULL) {
+            fprintf(stderr, "Nincs eleg memoria!\n");
+            exit(1);
+        }
     }
 
-    if (root->left != NULL) {
-        generateHuffmanCodes(root->left, huffmanCodes, codeLengths, (code << 1), depth + 1);
+    size_t histogram_size = (block_size + HISTOGRAM_GROUP_SIZE - 1) / HISTOGRAM_GROUP_SIZE * HISTOGRAM_GROUP_SIZE;
+    size_t histogram_local = HISTOGRAM_GROUP_SIZE;
+    size_t encode_size = block_size;
+    TaskGraph graph;
+    taskGraphInit(&graph);
+    pipeline.write_input = taskGraphAddWrite(&graph, "input", NULL, 0, block_size, NULL);
+    pipeline.write_zero = taskGraphAddWrite(&graph, "frequencies = 0", NULL, 0, sizeof(int) * 256, NULL);
+    pipeline.histogram = taskGraphAddKernel(&graph, "calculate_frequencies", calculate_frequencies_kernel, 1,
+                                            &histogram_size, &histogram_local);
+    pipeline.read_frequencies = taskGraphAddRead(&graph, "frequencies", NULL, 0, sizeof(int) * 256, NULL);
+    pipeline.build = taskGraphAddHost(&graph, "buildHuffmanCodes", pipelineBuildCodes, NULL);
+    pipeline.write_codes = taskGraphAddWrite(&graph, "huffmanCodes", NULL, 0, sizeof(int) * 256, NULL);
+    pipeline.write_lengths = taskGraphAddWrite(&graph, "codeLengths", NULL, 0, 256, NULL);
+    pipeline.encode = taskGraphAddKernel(&graph, "encode_input", encode_input_kernel, 1, &encode_size, NULL);
+    pipeline.read_encoded = taskGraphAddRead(&graph, "encoded_data", NULL, 0, sizeof(int) * block_size, NULL);
+    pipeline.pack = taskGraphAddHost(&graph, "packHuffmanBits", pipelinePack, NULL);
+    if (pipeline.pack < 0) {
+        fprintf(stderr, "Nincs eleg memoria!\n");
+        exit(1);
     }
 
-    if (root->right != NULL) {
-        generateHuffmanCodes(root->right, huffmanCodes, codeLengths, (code << 1) | 1, depth + 1);
+    taskGraphDepends(&graph, pipeline.histogram, pipeline.write_input);
+    taskGraphDepends(&graph, pipeline.histogram, pipeline.write_zero);
+    taskGraphDepends(&graph, pipeline.read_frequencies, pipeline.histogram);
+    taskGraphDepends(&graph, pipeline.build, pipeline.read_frequencies);
+    taskGraphDepends(&graph, pipeline.write_codes, pipeline.build);
+    taskGraphDepends(&graph, pipeline.write_lengths, pipeline.build);
+    taskGraphDepends(&graph, pipeline.encode, pipeline.write_input);
+    taskGraphDepends(&graph, pipeline.encode, pipeline.write_codes);
+    taskGraphDepends(&graph, pipeline.encode, pipeline.write_lengths);
+    taskGraphDepends(&graph, pipeline.read_encoded, pipeline.encode);
+    taskGraphDepends(&graph, pipeline.pack, pipeline.read_encoded);
+    int block_size_arg = block_size;
+    taskGraphSetArg(&graph, pipeline.histogram, 2, sizeof(int), &block_size_arg);
+    taskGraphSetArg(&graph, pipeline.encode, 4, sizeof(int), &block_size_arg);
+
+    start = nowMs();
+    err = taskGraphRun(&executor, &graph, block_count, PIPELINE_DEPTH, pipelineBind, &pipeline);
+    double graph_ms = nowMs() - start;
+    checkError(err, "taskGraphRun");
+
+    double graph_latency = 0.0;
+    for (int b = 0; b < block_count; b++) {
+        graph_latency += done_ms[b] - start_ms[b];
+    }
+    int identical = memcmp(bit_counts[0], bit_counts[1], sizeof(size_t) * block_count) == 0;
+    for (int b = 0; b < block_count && identical; b++) {
+        identical = memcmp(packed[0] + stride * b, packed[1] + stride * b, (bit_counts[0][b] + 7) / 8) == 0;
     }
+
+    printf("%d blokk x %d bajt, %s sor, cl_khr_command_buffer: %s\n", block_count, block_size,
+           executor.out_of_order ? "out-of-order" : "in-order", executor.has_command_buffer ? "van" : "nincs");
+    printf("soros:      %.2f ms osszesen, %.3f ms/blokk kesleltetes\n", sequential_ms, sequential_latency / block_count);
+    printf("task graph: %.2f ms osszesen, %.3f ms/blokk kesleltetes (%d blokk egyszerre), %.2fx\n",
+           graph_ms, graph_latency / block_count, PIPELINE_DEPTH, sequential_ms / graph_ms);
+    printf("kimenet: %s\n", identical ? "azonos" : "ELTER");
+
+    for (int s = 0; s < PIPELINE_DEPTH; s++) {
+        PipelineSlot *slot = &pipeline.slots[s];
+        pool_release(&pool, slot->input_buffer);
+        pool_release(&pool, slot->frequencies_buffer);
+        pool_release(&pool, slot->huffman_codes_buffer);
+        pool_release(&pool, slot->code_lengths_buffer);
+        pool_release(&pool, slot->encoded_data_buffer);
+        free(slot->encoded_data);
+    }
+    taskGraphRelease(&graph);
+    taskExecutorRelease(&executor);
+    pool_destroy(&pool);
+    free(input);
+    free(packed[0]);
+    free(packed[1]);
+    free(bit_counts[0]);
+    free(bit_counts[1]);
+    free(start_ms);
+    free(done_ms);
+    free(encoded_data);
 }
 
-int main() {
+int main(int argc, char *argv[]) {
     cl_platform_id platform_id;
     cl_device_id device_id;
     cl_context context;
@@ -132,6 +895,49 @@ int main() {
     cl_kernel calculate_frequencies_kernel, encode_input_kernel;
     cl_int err;
 
+    // PERF_REGIONS=1 a host oldali regiok szamlaloit irja ki a program vegen.
+    perf_regions_init();
+    atexit(perf_regions_finish);
+
+    int benchmark_iterations = 0;
+    int specialize = 0;
+    int block_size = 0;
+    int rans_lanes = 0;
+    int pipeline_blocks = 0;
+    int pipeline_block_size = 0;
+    const char *block_file = NULL;
+    if (argc > 1 && strcmp(argv[1], "blocks") == 0) {
+        block_size = argc > 2 ? atoi(argv[2]) : BLOCK_HUFFMAN_DEFAULT_BLOCK_SIZE;
+        if (block_size <= 0 || block_size > BLOCK_HUFFMAN_MAX_BLOCK_SIZE) {
+            block_size = BLOCK_HUFFMAN_DEFAULT_BLOCK_SIZE;
+        }
+        block_file = argc > 3 ? argv[3] : NULL;
+    }
+    if (argc > 1 && strcmp(argv[1], "rans") == 0) {
+        rans_lanes = argc > 2 ? atoi(argv[2]) : RANS_DEFAULT_LANES;
+        if (rans_lanes <= 0 || rans_lanes % RANS_GROUP_SIZE != 0) {
+            rans_lanes = RANS_DEFAULT_LANES;
+        }
+        block_file = argc > 3 ? argv[3] : NULL;
+    }
+    if (argc > 1 && strcmp(argv[1], "pipeline") == 0) {
+        pipeline_blocks = argc > 2 ? atoi(argv[2]) : 64;
+        pipeline_block_size = argc > 3 ? atoi(argv[3]) : BLOCK_HUFFMAN_DEFAULT_BLOCK_SIZE;
+        if (pipeline_blocks <= 0) {
+            pipeline_blocks = 64;
+        }
+        if (pipeline_block_size <= 0 || pipeline_block_size > BLOCK_HUFFMAN_MAX_BLOCK_SIZE) {
+            pipeline_block_size = BLOCK_HUFFMAN_DEFAULT_BLOCK_SIZE;
+        }
+    }
+    if (argc > 1 && (strcmp(argv[1], "pool-bench") == 0 || strcmp(argv[1], "specialize") == 0)) {
+        specialize = strcmp(argv[1], "specialize") == 0;
+        benchmark_iterations = argc > 2 ? atoi(argv[2]) : 100;
+        if (benchmark_iterations <= 0) {
+            benchmark_iterations = 100;
+        }
+    }
+
     int error_code;
     char *kernel_source = load_kernel_source("huffman.cl", &error_code);
     if (error_code != 0) {
@@ -141,7 +947,7 @@ int main() {
 
     err = clGetPlatformIDs(1, &platform_id, NULL);
     checkError(err, "clGetPlatformIDs");
-    err = clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_GPU, 1, &device_id, NULL);
+    err = clGetDeviceIDs(platform_id, DEVICE_TYPE, 1, &device_id, NULL);
     checkError(err, "clGetDeviceIDs");
     context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
     checkError(err, "clCreateContext");
@@ -166,9 +972,60 @@ int main() {
     encode_input_kernel = clCreateKernel(program, "encode_input", &err);
     checkError(err, "clCreateKernel (encode_input)");
     
+    if (pipeline_blocks > 0) {
+        pipelineBenchmark(context, device_id, queue, calculate_frequencies_kernel, encode_input_kernel,
+                          pipeline_blocks, pipeline_block_size);
+        clReleaseKernel(calculate_frequencies_kernel);
+        clReleaseKernel(encode_input_kernel);
+        clReleaseProgram(program);
+        clReleaseCommandQueue(queue);
+        clReleaseContext(context);
+        free(kernel_source);
+        return 0;
+    }
+
+    if (block_size > 0 || rans_lanes > 0) {
+        int block_input_size = 8 * 1024 * 1024;
+        unsigned char *block_input = NULL;
+        if (block_file != NULL) {
+            FILE *file = fopen(block_file, "rb");
+            if (file == NULL) {
+                fprintf(stderr, "Nem sikerult megnyitni: %s\n", block_file);
+                return 1;
+            }
+            fseek(file, 0, SEEK_END);
+            block_input_size = (int)ftell(file);
+            rewind(file);
+            block_input = (unsigned char *)malloc(block_input_size > 0 ? block_input_size : 1);
+            block_input_size = (int)fread(block_input, 1, block_input_size, file);
+            fclose(file);
+        } else {
+            block_input = (unsigned char *)malloc(block_input_size);
+            generateMixedContent(block_input_size, block_input);
+        }
+        if (block_input_size > 0) {
+            printf("bemenet: %s, %d bajt\n", block_file != NULL ? block_file : "vegyes generalt", block_input_size);
+            if (rans_lanes > 0) {
+                ransBenchmark(context, device_id, queue, program, calculate_frequencies_kernel, encode_input_kernel,
+                              block_input, block_input_size, rans_lanes, 5);
+            } else {
+                blockBenchmark(context, device_id, queue, program, calculate_frequencies_kernel, encode_input_kernel,
+                               block_input, block_input_size, block_size, 5);
+            }
+        }
+        free(block_input);
+        clReleaseKernel(calculate_frequencies_kernel);
+        clReleaseKernel(encode_input_kernel);
+        clReleaseProgram(program);
+        clReleaseCommandQueue(queue);
+        clReleaseContext(context);
+        free(kernel_source);
+        return 0;
+    }
+
     int frequencies[256] = {0};
     int characters = 2000000;
-    char random_string[characters];
+    char random_string[characters + 1];
     generateRandomString(characters, random_string);
 
     // Megadható a saját karakterlánc és random generált is
@@ -178,57 +1035,40 @@ int main() {
 
 
     int input_size = strlen(input);
-    printf("Generalt karakterlanc: %s\n", random_string);
 
-    cl_mem input_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(char) * input_size, (void *)input, &err);
-    checkError(err, "clCreateBuffer (input_buffer)");
-    cl_mem frequencies_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(int) * 256, frequencies, &err);
-    checkError(err, "clCreateBuffer (frequencies_buffer)");
+    if (benchmark_iterations > 0) {
+        if (specialize) {
+            specializeBenchmark(context, device_id, queue, calculate_frequencies_kernel, encode_input_kernel,
+                                input, input_size, benchmark_iterations);
+        } else {
+            poolBenchmark(context, device_id, queue, calculate_frequencies_kernel, encode_input_kernel,
+                          input, input_size, benchmark_iterations);
+        }
+        clReleaseKernel(calculate_frequencies_kernel);
+        clReleaseKernel(encode_input_kernel);
+        clReleaseProgram(program);
+        clReleaseCommandQueue(queue);
+        clReleaseContext(context);
+        free(kernel_source);
+        return 0;
+    }
 
-    err = clSetKernelArg(calculate_frequencies_kernel, 0, sizeof(cl_mem), &input_buffer);
-    err |= clSetKernelArg(calculate_frequencies_kernel, 1, sizeof(cl_mem), &frequencies_buffer);
-    err |= clSetKernelArg(calculate_frequencies_kernel, 2, sizeof(int), &input_size);
-    checkError(err, "clSetKernelArg (calculate_frequencies)");
+    printf("Generalt karakterlanc: %s\n", random_string);
+
+    DevicePool pool;
+    pool_init(&pool, context, device_id, POOL_DEFAULT_BLOCK_SIZE);
 
-    size_t global_work_size = input_size;
-    size_t local_work_size = 256;
     cl_event event1;
     cl_event event2;
     cl_ulong time_start, time_end;
     double total_time;
 
-    err = clEnqueueNDRangeKernel(queue, calculate_frequencies_kernel, 1, NULL, &global_work_size, NULL, 0, NULL, &event1);
-    checkError(err, "clEnqueueNDRangeKernel (calculate_frequencies)");
-
-    err = clEnqueueReadBuffer(queue, frequencies_buffer, CL_TRUE, 0, sizeof(int) * 256, frequencies, 0, NULL, NULL);
-    checkError(err, "clEnqueueReadBuffer (frequencies)");
-
-    HuffmanNode *root = buildHuffmanTree(frequencies);
-
     int huffmanCodes[256] = {0};
     unsigned char codeLengths[256] = {0};
-    generateHuffmanCodes(root, huffmanCodes, codeLengths, 0, 0);
-
-    cl_mem huffman_codes_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int) * 256, huffmanCodes, &err);
-    checkError(err, "clCreateBuffer (huffman_codes_buffer)");
-    cl_mem code_lengths_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(unsigned char) * 256, codeLengths, &err);
-    checkError(err, "clCreateBuffer (code_lengths_buffer)");
-    cl_mem encoded_data_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(int) * input_size, NULL, &err);
-    checkError(err, "clCreateBuffer (encoded_data_buffer)");
-
-    err = clSetKernelArg(encode_input_kernel, 0, sizeof(cl_mem), &input_buffer);
-    err |= clSetKernelArg(encode_input_kernel, 1, sizeof(cl_mem), &huffman_codes_buffer);
-    err |= clSetKernelArg(encode_input_kernel, 2, sizeof(cl_mem), &code_lengths_buffer);
-    err |= clSetKernelArg(encode_input_kernel, 3, sizeof(cl_mem), &encoded_data_buffer);
-    err |= clSetKernelArg(encode_input_kernel, 4, sizeof(int), &input_size);
-    checkError(err, "clSetKernelArg (encode_input)");
-
-    err = clEnqueueNDRangeKernel(queue, encode_input_kernel, 1, NULL, &global_work_size, NULL, 0, NULL, &event2);
-    checkError(err, "clEnqueueNDRangeKernel (encode_input)");
-
     int *encoded_data = (int *)malloc(sizeof(int) * input_size);
-    err = clEnqueueReadBuffer(queue, encoded_data_buffer, CL_TRUE, 0, sizeof(int) * input_size, encoded_data, 0, NULL, NULL);
-    checkError(err, "clEnqueueReadBuffer (encoded_data)");
+
+    encodeOnDevice(queue, calculate_frequencies_kernel, encode_input_kernel, &pool, input, input_size,
+                   frequencies, huffmanCodes, codeLengths, encoded_data, &event1, &event2, NULL);
 
     printf("Betuk es frekvenciaik:\n");
     for (int i = 0; i < 256; i++) {
@@ -271,11 +1111,9 @@ int main() {
     printf("Kernel futasi ideje kodolashoz: %.3f ms\n", total_time);
 
     free(encoded_data);
-    clReleaseMemObject(input_buffer);
-    clReleaseMemObject(frequencies_buffer);
-    clReleaseMemObject(huffman_codes_buffer);
-    clReleaseMemObject(code_lengths_buffer);
-    clReleaseMemObject(encoded_data_buffer);
+    clReleaseEvent(event1);
+    clReleaseEvent(event2);
+    pool_destroy(&pool);
     clReleaseKernel(calculate_frequencies_kernel);
     clReleaseKernel(encode_input_kernel);
     clReleaseProgram(program);
@@ -284,4 +1122,4 @@ int main() {
     free(kernel_source);
 
     return 0;
-}
\ No newline at end of file
+}
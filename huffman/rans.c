@@ -0,0 +1,265 @@
+#include "rans.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int ransBuildTable(const int frequencies[], RansTable *table) {
+    long long total = 0;
+    int sum = 0;
+    int largest = -1;
+
+    memset(table, 0, sizeof(RansTable));
+    for (int s = 0; s < 256; s++) {
+        total += frequencies[s];
+        if (frequencies[s] > 0 && (largest < 0 || frequencies[s] > frequencies[largest])) {
+            largest = s;
+        }
+    }
+    if (total == 0) {
+        return -1;
+    }
+
+    for (int s = 0; s < 256; s++) {
+        if (frequencies[s] > 0) {
+            int q = (int)((long long)frequencies[s] * RANS_PROB_SCALE / total);
+            table->freq[s] = (uint16_t)(q > 0 ? q : 1);
+            sum += table->freq[s];
+        }
+    }
+
+    // A kerekites utani elteres: a hiany a leggyakoribb szimbolumhoz kerul,
+    // a tobblet a legnagyobb (1-nel nagyobb) frekvenciakbol vonodik le.
+    if (sum < RANS_PROB_SCALE) {
+        table->freq[largest] += (uint16_t)(RANS_PROB_SCALE - sum);
+    }
+    while (sum > RANS_PROB_SCALE) {
+        int max = -1;
+        for (int s = 0; s < 256; s++) {
+            if (table->freq[s] > 1 && (max < 0 || table->freq[s] > table->freq[max])) {
+                max = s;
+            }
+        }
+        table->freq[max]--;
+        sum--;
+    }
+
+    int start = 0;
+    for (int s = 0; s < 256; s++) {
+        table->start[s] = (uint16_t)start;
+        memset(table->slot_symbol + start, s, table->freq[s]);
+        start += table->freq[s];
+    }
+    return 0;
+}
+
+int ransLaneCapacity(int input_size, int lanes) {
+    return (input_size + lanes - 1) / lanes + 2;
+}
+
+void ransEncodeLanes(const RansTable *table, const unsigned char *input, int input_size, int lanes,
+                     uint16_t *lane_words, uint32_t *lane_counts) {
+    int capacity = ransLaneCapacity(input_size, lanes);
+    int steps = (input_size + lanes - 1) / lanes;
+    uint32_t *states = (uint32_t *)malloc(sizeof(uint32_t) * lanes);
+    int *positions = (int *)malloc(sizeof(int) * lanes);
+
+    for (int l = 0; l < lanes; l++) {
+        states[l] = RANS_STATE_LOW;
+        positions[l] = capacity;
+    }
+
+    // Visszafele kodolunk, a belso ciklus a fuggetlen savokon megy vegig.
+    for (int k = steps - 1; k >= 0; k--) {
+        int base = k * lanes;
+        int active = input_size - base < lanes ? input_size - base : lanes;
+        for (int l = 0; l < active; l++) {
+            unsigned char s = input[base + l];
+            uint32_t freq = table->freq[s];
+            uint32_t x = states[l];
+            if ((uint64_t)x >= (uint64_t)((RANS_STATE_LOW >> RANS_PROB_BITS) << 16) * freq) {
+                lane_words[(size_t)l * capacity + --positions[l]] = (uint16_t)x;
+                x >>= 16;
+            }
+            states[l] = ((x / freq) << RANS_PROB_BITS) + (x % freq) + table->start[s];
+        }
+    }
+
+    for (int l = 0; l < lanes; l++) {
+        uint16_t *words = lane_words + (size_t)l * capacity;
+        words[--positions[l]] = (uint16_t)(states[l] >> 16);
+        words[--positions[l]] = (uint16_t)states[l];
+        lane_counts[l] = (uint32_t)(capacity - positions[l]);
+    }
+
+    free(states);
+    free(positions);
+}
+
+static int usedSymbols(const RansTable *table) {
+    int count = 0;
+    for (int s = 0; s < 256; s++) {
+        count += table->freq[s] > 0;
+    }
+    return count;
+}
+
+size_t ransStreamBound(int input_size, int lanes) {
+    return ENTROPY_STREAM_HEADER_SIZE + 2 + 3 * 256 + 4 * (size_t)lanes
+           + 2 * (size_t)lanes * ransLaneCapacity(input_size, lanes);
+}
+
+size_t ransWriteStream(const RansTable *table, int input_size, int lanes,
+                       const uint16_t *lane_words, const uint32_t *lane_counts, unsigned char *output) {
+    int capacity = ransLaneCapacity(input_size, lanes);
+    unsigned char *p = output;
+
+    writeEntropyHeader(p, ENTROPY_CODEC_RANS, (uint32_t)input_size, (uint32_t)lanes);
+    p += ENTROPY_STREAM_HEADER_SIZE;
+
+    putStreamU16(p, (uint32_t)usedSymbols(table));
+    p += 2;
+    for (int s = 0; s < 256; s++) {
+        if (table->freq[s] > 0) {
+            *p++ = (unsigned char)s;
+            putStreamU16(p, table->freq[s]);
+            p += 2;
+        }
+    }
+
+    for (int l = 0; l < lanes; l++) {
+        putStreamU32(p, lane_counts[l]);
+        p += 4;
+    }
+    for (int l = 0; l < lanes; l++) {
+        const uint16_t *words = lane_words + (size_t)l * capacity + (capacity - lane_counts[l]);
+        for (uint32_t i = 0; i < lane_counts[l]; i++) {
+            putStreamU16(p, words[i]);
+            p += 2;
+        }
+    }
+    return (size_t)(p - output);
+}
+
+int ransParseStream(const unsigned char *stream, size_t stream_size, RansTable *table,
+                    int *input_size, int *lanes, uint32_t **lane_offsets, const unsigned char **words) {
+    EntropyStreamHeader header;
+    const unsigned char *p = stream + ENTROPY_STREAM_HEADER_SIZE;
+    const unsigned char *end = stream + stream_size;
+    int frequencies[256] = {0};
+
+    *lane_offsets = NULL;
+    if (readEntropyHeader(stream, stream_size, &header) != 0 || header.codec != ENTROPY_CODEC_RANS
+        || header.param == 0 || header.input_size > 0x7fffffffu || end - p < 2) {
+        return -1;
+    }
+    *input_size = (int)header.input_size;
+    *lanes = (int)header.param;
+
+    int symbols = (int)getStreamU16(p);
+    p += 2;
+    if (symbols > 256 || end - p < 3 * symbols) {
+        return -1;
+    }
+    int sum = 0;
+    for (int i = 0; i < symbols; i++) {
+        frequencies[p[0]] = (int)getStreamU16(p + 1);
+        sum += frequencies[p[0]];
+        p += 3;
+    }
+    if (*input_size > 0 && sum != RANS_PROB_SCALE) {
+        return -1;
+    }
+
+    // A tarolt frekvenciak mar kvantaltak, ezert a tabla valtozatlanul ujraepul.
+    memset(table, 0, sizeof(RansTable));
+    int start = 0;
+    for (int s = 0; s < 256; s++) {
+        table->freq[s] = (uint16_t)frequencies[s];
+        table->start[s] = (uint16_t)start;
+        memset(table->slot_symbol + start, s, frequencies[s]);
+        start += frequencies[s];
+    }
+
+    if ((size_t)(end - p) / 4 < (size_t)*lanes) {
+        return -1;
+    }
+    *lane_offsets = (uint32_t *)malloc(sizeof(uint32_t) * (*lanes + 1));
+    if (*lane_offsets == NULL) {
+        return -1;
+    }
+    // Minden sav legalabb a ket szavas vegallapotot tartalmazza, es a savok
+    // a szoteruleten belul maradnak: a rans_decode kernel ezekbol olvas.
+    uint64_t offset = 0;
+    int corrupt = 0;
+    for (int l = 0; l < *lanes; l++) {
+        uint32_t count = getStreamU32(p);
+        (*lane_offsets)[l] = (uint32_t)offset;
+        offset += count;
+        corrupt |= count < 2;
+        p += 4;
+    }
+    (*lane_offsets)[*lanes] = (uint32_t)offset;
+    if (corrupt || offset > 0xffffffffu || (uint64_t)(end - p) < 2 * offset) {
+        free(*lane_offsets);
+        *lane_offsets = NULL;
+        return -1;
+    }
+    *words = p;
+    return 0;
+}
+
+int ransDecodeStream(const unsigned char *stream, size_t stream_size, unsigned char *output, int output_capacity) {
+    RansTable *table = (RansTable *)malloc(sizeof(RansTable));
+    uint32_t *lane_offsets;
+    const unsigned char *words;
+    int input_size, lanes;
+
+    if (table == NULL || ransParseStream(stream, stream_size, table, &input_size, &lanes, &lane_offsets, &words) != 0
+        || input_size > output_capacity) {
+        free(table);
+        return -1;
+    }
+
+    uint32_t *states = (uint32_t *)malloc(sizeof(uint32_t) * lanes);
+    uint32_t *positions = (uint32_t *)malloc(sizeof(uint32_t) * lanes);
+    int result = input_size;
+
+    for (int l = 0; l < lanes; l++) {
+        positions[l] = lane_offsets[l];
+        if (lane_offsets[l + 1] - positions[l] < 2) {
+            result = -1;
+            break;
+        }
+        states[l] = getStreamU16(words + 2 * (size_t)positions[l])
+                    | (getStreamU16(words + 2 * (size_t)positions[l] + 2) << 16);
+        positions[l] += 2;
+    }
+
+    int steps = (input_size + lanes - 1) / lanes;
+    const uint32_t mask = RANS_PROB_SCALE - 1;
+    for (int k = 0; k < steps && result >= 0; k++) {
+        int base = k * lanes;
+        int active = input_size - base < lanes ? input_size - base : lanes;
+        for (int l = 0; l < active; l++) {
+            uint32_t x = states[l];
+            uint32_t slot = x & mask;
+            unsigned char s = table->slot_symbol[slot];
+            output[base + l] = s;
+            x = table->freq[s] * (x >> RANS_PROB_BITS) + slot - table->start[s];
+            if (x < RANS_STATE_LOW) {
+                if (positions[l] >= lane_offsets[l + 1]) {
+                    result = -1;
+                    break;
+                }
+                x = (x << 16) | getStreamU16(words + 2 * (size_t)positions[l]++);
+            }
+            states[l] = x;
+        }
+    }
+
+    free(states);
+    free(positions);
+    free(lane_offsets);
+    free(table);
+    return result;
+}
@@ -0,0 +1,87 @@
+#ifndef RANS_H
+#define RANS_H
+
+#include "entropy_stream.h"
+
+#define RANS_PROB_BITS 12
+#define RANS_PROB_SCALE (1 << RANS_PROB_BITS)
+#define RANS_STATE_LOW (1u << 16)
+
+/**
+ * Interleaved states: lane l codes the symbols l, l + lanes, l + 2 * lanes, ...
+ * so neighbouring work-items (and host loop iterations) touch neighbouring
+ * bytes. The lane count has to be a multiple of the work-group size.
+ */
+#define RANS_GROUP_SIZE 32
+#define RANS_DEFAULT_LANES 1024
+
+/**
+ * Frequencies quantized to RANS_PROB_SCALE, their cumulative starts and
+ * the slot -> symbol lookup of the decoder.
+ */
+typedef struct {
+    uint16_t freq[256];
+    uint16_t start[256];
+    unsigned char slot_symbol[RANS_PROB_SCALE];
+} RansTable;
+
+/**
+ * Quantize a byte histogram (e.g. the output of calculate_frequencies).
+ * Every present symbol keeps a frequency of at least 1.
+ *
+ * Returns 0 on success, -1 when every frequency is zero
+ */
+int ransBuildTable(const int frequencies[], RansTable *table);
+
+/**
+ * Number of 16 bit words reserved per lane by the encoder: one
+ * renormalization word per symbol at most, plus the final state.
+ */
+int ransLaneCapacity(int input_size, int lanes);
+
+/**
+ * Host encoder with the same lane layout as the rans_encode kernel.
+ *
+ * lane_words: lanes x ransLaneCapacity(...) words, every lane is filled from its end
+ * lane_counts: Number of words used by each lane
+ */
+void ransEncodeLanes(const RansTable *table, const unsigned char *input, int input_size, int lanes,
+                     uint16_t *lane_words, uint32_t *lane_counts);
+
+size_t ransStreamBound(int input_size, int lanes);
+
+/**
+ * Write the stream from the lane buffers of ransEncodeLanes or rans_encode.
+ *
+ * Stream layout (little endian):
+ *   EntropyStreamHeader (codec ENTROPY_CODEC_RANS, param = lanes)
+ *   uint16 symbol_count, symbol_count x (uint8 symbol, uint16 frequency)
+ *   lanes x uint32 word count
+ *   the words of every lane in decoding order, starting with the final state
+ *
+ * Returns the number of bytes written
+ */
+size_t ransWriteStream(const RansTable *table, int input_size, int lanes,
+                       const uint16_t *lane_words, const uint32_t *lane_counts, unsigned char *output);
+
+/**
+ * Parse a rANS stream without decoding it (for the rans_decode kernel).
+ *
+ * lane_offsets: lanes + 1 entries, word offset of every lane in words.
+ *   Increasing, every lane holds at least its two state words and the last
+ *   offset is within the stream.
+ * words: Start of the word area inside the stream
+ *
+ * Returns 0 on success, -1 on a corrupt stream
+ */
+int ransParseStream(const unsigned char *stream, size_t stream_size, RansTable *table,
+                    int *input_size, int *lanes, uint32_t **lane_offsets, const unsigned char **words);
+
+/**
+ * Host decoder, the lanes are advanced together.
+ *
+ * Returns the number of decoded bytes or -1 on a corrupt stream
+ */
+int ransDecodeStream(const unsigned char *stream, size_t stream_size, unsigned char *output, int output_capacity);
+
+#endif
@@ -0,0 +1,350 @@
+#include "task_graph.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A kiterjesztes-lista hossza nincs korlatozva, ezert elobb a meretet kerdezzuk le.
+static int hasExtension(cl_device_id device_id, const char *name) {
+    size_t size;
+    if (clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, 0, NULL, &size) != CL_SUCCESS) {
+        return 0;
+    }
+    char *extensions = (char *)malloc(size + 1);
+    if (extensions == NULL) {
+        return 0;
+    }
+    if (clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, size, extensions, NULL) != CL_SUCCESS) {
+        free(extensions);
+        return 0;
+    }
+    extensions[size] = 0;
+    int found = strstr(extensions, name) != NULL;
+    free(extensions);
+    return found;
+}
+
+cl_int taskExecutorInit(TaskExecutor *executor, cl_context context, cl_device_id device_id) {
+    cl_queue_properties properties[] = {
+        CL_QUEUE_PROPERTIES, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE | CL_QUEUE_PROFILING_ENABLE, 0
+    };
+    cl_int err;
+
+    executor->context = context;
+    executor->out_of_order = 1;
+    executor->queue = clCreateCommandQueueWithProperties(context, device_id, properties, &err);
+    if (err != CL_SUCCESS) {
+        // Az out-of-order sor opcionalis, nelkule a csomopontok sorban futnak.
+        properties[1] = CL_QUEUE_PROFILING_ENABLE;
+        executor->out_of_order = 0;
+        executor->queue = clCreateCommandQueueWithProperties(context, device_id, properties, &err);
+    }
+
+    executor->has_command_buffer = hasExtension(device_id, "cl_khr_command_buffer");
+    return err;
+}
+
+void taskExecutorRelease(TaskExecutor *executor) {
+    if (executor->queue != NULL) {
+        clReleaseCommandQueue(executor->queue);
+        executor->queue = NULL;
+    }
+}
+
+void taskGraphInit(TaskGraph *graph) {
+    memset(graph, 0, sizeof(TaskGraph));
+}
+
+void taskGraphRelease(TaskGraph *graph) {
+    free(graph->nodes);
+    memset(graph, 0, sizeof(TaskGraph));
+}
+
+static TaskNode *addNode(TaskGraph *graph, TaskType type, const char *name, int *id) {
+    if (graph->count == graph->capacity) {
+        int capacity = graph->capacity > 0 ? graph->capacity * 2 : 16;
+        TaskNode *nodes = (TaskNode *)realloc(graph->nodes, sizeof(TaskNode) * capacity);
+        if (nodes == NULL) {
+            *id = -1;
+            return NULL;
+        }
+        graph->nodes = nodes;
+        graph->capacity = capacity;
+    }
+    *id = graph->count++;
+    TaskNode *node = &graph->nodes[*id];
+    memset(node, 0, sizeof(TaskNode));
+    node->type = type;
+    node->name = name;
+    return node;
+}
+
+int taskGraphAddKernel(TaskGraph *graph, const char *name, cl_kernel kernel, cl_uint work_dim,
+                       const size_t *global_size, const size_t *local_size) {
+    int id;
+    TaskNode *node = addNode(graph, TASK_KERNEL, name, &id);
+    if (node == NULL || work_dim < 1 || work_dim > 3) {
+        return -1;
+    }
+    node->kernel = kernel;
+    node->work_dim = work_dim;
+    for (cl_uint d = 0; d < work_dim; d++) {
+        node->global_size[d] = global_size[d];
+        node->local_size[d] = local_size != NULL ? local_size[d] : 0;
+    }
+    node->has_local_size = local_size != NULL;
+    return id;
+}
+
+int taskGraphAddWrite(TaskGraph *graph, const char *name, cl_mem buffer, size_t offset, size_t bytes, const void *host) {
+    int id;
+    TaskNode *node = addNode(graph, TASK_WRITE, name, &id);
+    if (node != NULL) {
+        node->buffer = buffer;
+        node->offset = offset;
+        node->bytes = bytes;
+        node->host = (void *)host;
+    }
+    return id;
+}
+
+int taskGraphAddRead(TaskGraph *graph, const char *name, cl_mem buffer, size_t offset, size_t bytes, void *host) {
+    int id;
+    TaskNode *node = addNode(graph, TASK_READ, name, &id);
+    if (node != NULL) {
+        node->buffer = buffer;
+        node->offset = offset;
+        node->bytes = bytes;
+        node->host = host;
+    }
+    return id;
+}
+
+int taskGraphAddHost(TaskGraph *graph, const char *name, TaskHostFunction function, void *arg) {
+    int id;
+    TaskNode *node = addNode(graph, TASK_HOST, name, &id);
+    if (node != NULL) {
+        node->function = function;
+        node->arg = arg;
+    }
+    return id;
+}
+
+int taskGraphDepends(TaskGraph *graph, int node, int dependency) {
+    if (node < 0 || node >= graph->count || dependency < 0 || dependency >= node) {
+        return -1;
+    }
+    TaskNode *target = &graph->nodes[node];
+    if (target->dep_count == TASK_MAX_DEPS) {
+        return -1;
+    }
+    target->deps[target->dep_count++] = dependency;
+    graph->nodes[dependency].has_dependents = 1;
+    return 0;
+}
+
+void taskGraphSetArg(TaskGraph *graph, int node, cl_uint index, size_t size, const void *value) {
+    TaskNode *target = &graph->nodes[node];
+    if (index >= TASK_MAX_ARGS || size > TASK_ARG_MAX_SIZE) {
+        return;
+    }
+    target->args[index].size = size;
+    memcpy(target->args[index].value, value, size);
+    if ((int)index >= target->arg_count) {
+        target->arg_count = index + 1;
+    }
+}
+
+void taskGraphBind(TaskGraph *graph, int node, cl_mem buffer, void *host) {
+    TaskNode *target = &graph->nodes[node];
+    if (target->type == TASK_HOST) {
+        target->arg = host;
+    } else {
+        target->buffer = buffer;
+        target->host = host;
+    }
+}
+
+// Egy host csomopont egy lejatszasban: a fuggosegei utan egy callback futtatja,
+// es a user event jelzi a rakovetkezo csomopontoknak, hogy kesz.
+typedef struct {
+    TaskHostFunction function;
+    void *arg;
+    cl_event user_event;
+} HostCall;
+
+static void CL_CALLBACK runHostCall(cl_event event, cl_int status, void *data) {
+    HostCall *call = (HostCall *)data;
+    if (status == CL_COMPLETE) {
+        call->function(call->arg);
+        clSetUserEventStatus(call->user_event, CL_COMPLETE);
+    } else {
+        // Egy hibas fuggoseg a rakovetkezo csomopontokra is tovabbterjed.
+        clSetUserEventStatus(call->user_event, status < 0 ? status : CL_INVALID_EVENT);
+    }
+    clReleaseEvent(call->user_event);
+    clReleaseEvent(event);
+    free(call);
+}
+
+static cl_int enqueueHost(TaskExecutor *executor, const TaskNode *node, cl_uint wait_count, const cl_event *wait_list,
+                          cl_event *event) {
+    cl_int err;
+
+    // Fuggoseg nelkul nincs mire varni, a fuggveny azonnal lefut.
+    if (wait_count == 0) {
+        node->function(node->arg);
+        *event = clCreateUserEvent(executor->context, &err);
+        if (err == CL_SUCCESS) {
+            clSetUserEventStatus(*event, CL_COMPLETE);
+        }
+        return err;
+    }
+
+    HostCall *call = (HostCall *)malloc(sizeof(HostCall));
+    if (call == NULL) {
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    call->function = node->function;
+    call->arg = node->arg;
+    call->user_event = clCreateUserEvent(executor->context, &err);
+    if (err != CL_SUCCESS) {
+        free(call);
+        return err;
+    }
+
+    cl_event marker;
+    err = clEnqueueMarkerWithWaitList(executor->queue, wait_count, wait_list, &marker);
+    if (err != CL_SUCCESS) {
+        clReleaseEvent(call->user_event);
+        free(call);
+        return err;
+    }
+    *event = call->user_event;
+    clRetainEvent(*event);
+    err = clSetEventCallback(marker, CL_COMPLETE, runHostCall, call);
+    if (err != CL_SUCCESS) {
+        clSetUserEventStatus(call->user_event, err);
+        clReleaseEvent(call->user_event);
+        clReleaseEvent(*event);
+        clReleaseEvent(marker);
+        free(call);
+    }
+    return err;
+}
+
+cl_int taskGraphEnqueue(TaskExecutor *executor, TaskGraph *graph, cl_event *done) {
+    cl_event *events = (cl_event *)calloc(graph->count, sizeof(cl_event));
+    cl_event *sinks = (cl_event *)malloc(sizeof(cl_event) * (graph->count > 0 ? graph->count : 1));
+    cl_int err = CL_SUCCESS;
+    cl_uint sink_count = 0;
+    int enqueued = 0;
+
+    if (events == NULL || sinks == NULL) {
+        free(events);
+        free(sinks);
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+
+    for (int i = 0; i < graph->count && err == CL_SUCCESS; i++) {
+        TaskNode *node = &graph->nodes[i];
+        cl_event wait_list[TASK_MAX_DEPS];
+        for (int d = 0; d < node->dep_count; d++) {
+            wait_list[d] = events[node->deps[d]];
+        }
+        cl_uint wait_count = (cl_uint)node->dep_count;
+        const cl_event *waits = wait_count > 0 ? wait_list : NULL;
+
+        switch (node->type) {
+        case TASK_KERNEL:
+            // Az argumentumokat az inditas rogziti, igy a kernel objektum megoszthato.
+            for (int a = 0; a < node->arg_count && err == CL_SUCCESS; a++) {
+                err = clSetKernelArg(node->kernel, a, node->args[a].size, node->args[a].value);
+            }
+            if (err == CL_SUCCESS) {
+                err = clEnqueueNDRangeKernel(executor->queue, node->kernel, node->work_dim, NULL, node->global_size,
+                                             node->has_local_size ? node->local_size : NULL,
+                                             wait_count, waits, &events[i]);
+            }
+            break;
+        case TASK_WRITE:
+            err = clEnqueueWriteBuffer(executor->queue, node->buffer, CL_FALSE, node->offset, node->bytes, node->host,
+                                       wait_count, waits, &events[i]);
+            break;
+        case TASK_READ:
+            err = clEnqueueReadBuffer(executor->queue, node->buffer, CL_FALSE, node->offset, node->bytes, node->host,
+                                      wait_count, waits, &events[i]);
+            break;
+        case TASK_HOST:
+            err = enqueueHost(executor, node, wait_count, waits, &events[i]);
+            break;
+        }
+        if (err != CL_SUCCESS) {
+            fprintf(stderr, "Hiba: %s csomopont (%d)\n", node->name != NULL ? node->name : "?", err);
+            break;
+        }
+        enqueued = i + 1;
+        if (!node->has_dependents) {
+            sinks[sink_count++] = events[i];
+        }
+    }
+
+    if (err == CL_SUCCESS && done != NULL) {
+        err = clEnqueueMarkerWithWaitList(executor->queue, sink_count, sinks, done);
+    }
+    clFlush(executor->queue);
+    if (err != CL_SUCCESS) {
+        // A mar elinditott csomopontok befejezodnek, mielott a hivo ujrahasznalna a buffereket.
+        if (enqueued > 0) {
+            clWaitForEvents((cl_uint)enqueued, events);
+        }
+    }
+    for (int i = 0; i < enqueued; i++) {
+        clReleaseEvent(events[i]);
+    }
+    free(events);
+    free(sinks);
+    return err;
+}
+
+cl_int taskGraphRun(TaskExecutor *executor, TaskGraph *graph, int iterations, int depth,
+                    TaskBindFunction bind, void *user_data) {
+    cl_event *done = (cl_event *)calloc(depth, sizeof(cl_event));
+    cl_int err = CL_SUCCESS;
+
+    if (done == NULL) {
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    for (int iteration = 0; iteration < iterations && err == CL_SUCCESS; iteration++) {
+        int slot = iteration % depth;
+        if (done[slot] != NULL) {
+            cl_int status;
+            err = clWaitForEvents(1, &done[slot]);
+            clGetEventInfo(done[slot], CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+            clReleaseEvent(done[slot]);
+            done[slot] = NULL;
+            if (err == CL_SUCCESS && status < 0) {
+                err = status;
+            }
+            if (err != CL_SUCCESS) {
+                break;
+            }
+        }
+        if (bind != NULL) {
+            bind(graph, iteration, slot, user_data);
+        }
+        err = taskGraphEnqueue(executor, graph, &done[slot]);
+    }
+
+    for (int slot = 0; slot < depth; slot++) {
+        if (done[slot] != NULL) {
+            cl_int wait_err = clWaitForEvents(1, &done[slot]);
+            if (err == CL_SUCCESS) {
+                err = wait_err;
+            }
+            clReleaseEvent(done[slot]);
+        }
+    }
+    free(done);
+    return err;
+}
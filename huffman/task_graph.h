@@ -0,0 +1,134 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+#define TASK_MAX_DEPS 8
+#define TASK_MAX_ARGS 8
+#define TASK_ARG_MAX_SIZE 16
+
+typedef enum {
+    TASK_KERNEL,
+    TASK_WRITE,
+    TASK_READ,
+    TASK_HOST
+} TaskType;
+
+/**
+ * Host work between device steps. It runs on a thread of the OpenCL
+ * runtime (from an event callback), so it may only touch data of its own
+ * graph replay and must not call blocking OpenCL functions.
+ */
+typedef void (*TaskHostFunction)(void *arg);
+
+typedef struct {
+    size_t size;
+    unsigned char value[TASK_ARG_MAX_SIZE];
+} TaskKernelArg;
+
+typedef struct {
+    TaskType type;
+    const char *name;
+
+    cl_kernel kernel;
+    cl_uint work_dim;
+    size_t global_size[3];
+    size_t local_size[3];
+    int has_local_size;
+    TaskKernelArg args[TASK_MAX_ARGS];
+    int arg_count;
+
+    cl_mem buffer;
+    size_t offset;
+    size_t bytes;
+    void *host;
+
+    TaskHostFunction function;
+    void *arg;
+
+    int deps[TASK_MAX_DEPS];
+    int dep_count;
+    int has_dependents;
+} TaskNode;
+
+/**
+ * Kernels, transfers and host functions with dependencies, recorded once
+ * and enqueued again for every replay. Nodes are added in a topological
+ * order: a node may only depend on nodes added before it.
+ */
+typedef struct {
+    TaskNode *nodes;
+    int count;
+    int capacity;
+} TaskGraph;
+
+/**
+ * Out-of-order queue of the replays. Without out-of-order support the
+ * queue is in-order: the graphs still run correctly, the independent
+ * nodes are just not overlapped by the device.
+ */
+typedef struct {
+    cl_context context;
+    cl_command_queue queue;
+    int out_of_order;
+    int has_command_buffer;
+} TaskExecutor;
+
+cl_int taskExecutorInit(TaskExecutor *executor, cl_context context, cl_device_id device_id);
+void taskExecutorRelease(TaskExecutor *executor);
+
+void taskGraphInit(TaskGraph *graph);
+void taskGraphRelease(TaskGraph *graph);
+
+/**
+ * Returns the id of the new node, or -1 when out of memory
+ *
+ * local_size: NULL lets the runtime choose
+ */
+int taskGraphAddKernel(TaskGraph *graph, const char *name, cl_kernel kernel, cl_uint work_dim,
+                       const size_t *global_size, const size_t *local_size);
+int taskGraphAddWrite(TaskGraph *graph, const char *name, cl_mem buffer, size_t offset, size_t bytes, const void *host);
+int taskGraphAddRead(TaskGraph *graph, const char *name, cl_mem buffer, size_t offset, size_t bytes, void *host);
+int taskGraphAddHost(TaskGraph *graph, const char *name, TaskHostFunction function, void *arg);
+
+/**
+ * node runs only after dependency has completed (dependency < node).
+ *
+ * Returns 0 on success, -1 on an invalid or too many dependencies
+ */
+int taskGraphDepends(TaskGraph *graph, int node, int dependency);
+
+/**
+ * Kernel argument captured when the node is enqueued, so a replay can
+ * use other buffers than the previous one.
+ */
+void taskGraphSetArg(TaskGraph *graph, int node, cl_uint index, size_t size, const void *value);
+
+/**
+ * Rebind the buffer and host memory of a transfer, or the argument of a
+ * host function (buffer is ignored there).
+ */
+void taskGraphBind(TaskGraph *graph, int node, cl_mem buffer, void *host);
+
+/**
+ * Enqueue one replay without waiting for it.
+ *
+ * done: Completes when every node of the replay has completed
+ */
+cl_int taskGraphEnqueue(TaskExecutor *executor, TaskGraph *graph, cl_event *done);
+
+/**
+ * Called before replay iteration, slot is the set of buffers it may use.
+ */
+typedef void (*TaskBindFunction)(TaskGraph *graph, int iteration, int slot, void *user_data);
+
+/**
+ * Replay the graph iterations times with up to depth replays in flight.
+ * The replays are independent, so they overlap; a slot is only given to
+ * a new iteration after the replay that used it last has completed.
+ */
+cl_int taskGraphRun(TaskExecutor *executor, TaskGraph *graph, int iterations, int depth,
+                    TaskBindFunction bind, void *user_data);
+
+#endif
@@ -0,0 +1,326 @@
+#include "gemm.h"
+#include "kernel_loader.h"
+#include "verify.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+double getEventTime(cl_event event)
+{
+    cl_ulong start, end;
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+    return (double)(end - start) * 1e-6;  // Nanoseconds to milliseconds
+}
+
+static int has_extension(cl_device_id device_id, const char* name)
+{
+    size_t size;
+    if (clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, 0, NULL, &size) != CL_SUCCESS) {
+        return 0;
+    }
+    char* extensions = (char*)malloc(size + 1);
+    clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, size, extensions, NULL);
+    extensions[size] = 0;
+    int found = strstr(extensions, name) != NULL;
+    free(extensions);
+    return found;
+}
+
+cl_int gemm_init(GemmContext* ctx, const char* const path)
+{
+    cl_int err;
+    int error_code;
+
+    memset(ctx, 0, sizeof(GemmContext));
+
+    err = clGetPlatformIDs(1, &ctx->platform_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error calling clGetPlatformIDs. Error code: %d\n", err);
+        return err;
+    }
+
+    err = clGetDeviceIDs(ctx->platform_id, DEVICE_TYPE, 1, &ctx->device_id, NULL);
+    if (err == CL_DEVICE_NOT_FOUND) {
+        err = clGetDeviceIDs(ctx->platform_id, CL_DEVICE_TYPE_ALL, 1, &ctx->device_id, NULL);
+    }
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error calling clGetDeviceIDs. Error code: %d\n", err);
+        return err;
+    }
+
+    ctx->has_fp16 = has_extension(ctx->device_id, "cl_khr_fp16");
+    ctx->has_fp64 = has_extension(ctx->device_id, "cl_khr_fp64");
+
+    ctx->context = clCreateContext(NULL, 1, &ctx->device_id, NULL, NULL, &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error calling clCreateContext. Error code: %d\n", err);
+        return err;
+    }
+    pool_init(&ctx->pool, ctx->context, ctx->device_id, POOL_DEFAULT_BLOCK_SIZE);
+
+    char* kernel_code = load_kernel_source(path, &error_code);
+    if (error_code != 0) {
+        printf("Source code loading error!\n");
+        return CL_INVALID_VALUE;
+    }
+    ctx->program = clCreateProgramWithSource(ctx->context, 1, (const char**)&kernel_code, NULL, &err);
+    free(kernel_code);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error calling clCreateProgramWithSource. Error code: %d\n", err);
+        return err;
+    }
+
+    char options[64];
+    snprintf(options, sizeof(options), "-DTILE_SIZE=%d", GEMM_TILE_SIZE);
+    err = clBuildProgram(ctx->program, 1, &ctx->device_id, options, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Build error! Code: %d\n", err);
+        size_t real_size;
+        clGetProgramBuildInfo(ctx->program, ctx->device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &real_size);
+        char* build_log = (char*)malloc(sizeof(char) * (real_size + 1));
+        clGetProgramBuildInfo(ctx->program, ctx->device_id, CL_PROGRAM_BUILD_LOG, real_size + 1, build_log, &real_size);
+        build_log[real_size] = 0;
+        printf("Build log : %s\n", build_log);
+        free(build_log);
+        return err;
+    }
+
+    if (kernel_cache_init(&ctx->cache, ctx->context, ctx->device_id, path, options, 8, ".kernel_cache") != CL_SUCCESS) {
+        printf("[ERROR] Error initializing the kernel cache\n");
+        return CL_INVALID_VALUE;
+    }
+
+    ctx->command_queue = clCreateCommandQueue(ctx->context, ctx->device_id, CL_QUEUE_PROFILING_ENABLE, &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error calling clCreateCommandQueue. Error code: %d\n", err);
+        return err;
+    }
+
+    ctx->kernel_fp32 = clCreateKernel(ctx->program, "matrix", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating kernel matrix. Error code: %d\n", err);
+        return err;
+    }
+    ctx->kernel_fp16 = clCreateKernel(ctx->program, "matrix_half", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating kernel matrix_half. Error code: %d\n", err);
+        return err;
+    }
+    ctx->kernel_view = clCreateKernel(ctx->program, "matrix_view", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating kernel matrix_view. Error code: %d\n", err);
+        return err;
+    }
+    ctx->kernel_add = clCreateKernel(ctx->program, "matrix_add_view", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating kernel matrix_add_view. Error code: %d\n", err);
+        return err;
+    }
+    if (ctx->has_fp64) {
+        ctx->kernel_fp64 = clCreateKernel(ctx->program, "matrix_double", &err);
+        if (err != CL_SUCCESS) {
+            ctx->kernel_fp64 = NULL;
+            ctx->has_fp64 = 0;
+        }
+    }
+
+    return CL_SUCCESS;
+}
+
+void gemm_release(GemmContext* ctx)
+{
+    if (ctx->kernel_fp32) clReleaseKernel(ctx->kernel_fp32);
+    if (ctx->kernel_fp16) clReleaseKernel(ctx->kernel_fp16);
+    if (ctx->kernel_fp64) clReleaseKernel(ctx->kernel_fp64);
+    if (ctx->kernel_view) clReleaseKernel(ctx->kernel_view);
+    if (ctx->kernel_add) clReleaseKernel(ctx->kernel_add);
+    if (ctx->context) pool_destroy(&ctx->pool);
+    if (ctx->cache.source) kernel_cache_release(&ctx->cache);
+    if (ctx->program) clReleaseProgram(ctx->program);
+    if (ctx->command_queue) clReleaseCommandQueue(ctx->command_queue);
+    if (ctx->context) clReleaseContext(ctx->context);
+    memset(ctx, 0, sizeof(GemmContext));
+}
+
+int gemm_supports(const GemmContext* ctx, GemmPrecision precision)
+{
+    switch (precision) {
+    case GEMM_FP32:
+        return ctx->kernel_fp32 != NULL;
+    case GEMM_FP16:
+        return ctx->kernel_fp16 != NULL;
+    case GEMM_FP64:
+        return ctx->has_fp64 && ctx->kernel_fp64 != NULL;
+    }
+    return 0;
+}
+
+const char* gemm_precision_name(GemmPrecision precision)
+{
+    switch (precision) {
+    case GEMM_FP32:
+        return "fp32";
+    case GEMM_FP16:
+        return "fp16";
+    case GEMM_FP64:
+        return "fp64";
+    }
+    return "?";
+}
+
+int gemm_padded_size(int N)
+{
+    return (N + GEMM_TILE_SIZE - 1) / GEMM_TILE_SIZE * GEMM_TILE_SIZE;
+}
+
+static size_t element_size(GemmPrecision precision)
+{
+    switch (precision) {
+    case GEMM_FP16:
+        return sizeof(cl_half);
+    case GEMM_FP64:
+        return sizeof(cl_double);
+    default:
+        return sizeof(cl_float);
+    }
+}
+
+/**
+ * Convert a float matrix to the storage type of the precision.
+ * Returns the input pointer for fp32, otherwise a new allocation.
+ */
+static void* to_storage(const float* src, size_t count, GemmPrecision precision)
+{
+    if (precision == GEMM_FP32) {
+        return (void*)src;
+    }
+    void* dst = malloc(count * element_size(precision));
+    if (dst == NULL) {
+        return NULL;
+    }
+    if (precision == GEMM_FP16) {
+        cl_half* h = (cl_half*)dst;
+        for (size_t i = 0; i < count; i++) {
+            h[i] = float_to_half(src[i]);
+        }
+    } else {
+        cl_double* d = (cl_double*)dst;
+        for (size_t i = 0; i < count; i++) {
+            d[i] = src[i];
+        }
+    }
+    return dst;
+}
+
+static void from_storage(const void* src, float* dst, size_t count, GemmPrecision precision)
+{
+    if (precision == GEMM_FP16) {
+        const cl_half* h = (const cl_half*)src;
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = half_to_float(h[i]);
+        }
+    } else if (precision == GEMM_FP64) {
+        const cl_double* d = (const cl_double*)src;
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = (float)d[i];
+        }
+    }
+}
+
+cl_int gemm_run(GemmContext* ctx, GemmPrecision precision,
+                const float* A, const float* B, float* C, int N, double* kernel_ms)
+{
+    cl_int err;
+    cl_kernel kernel;
+    size_t count = (size_t)N * N;
+    size_t bytes = count * element_size(precision);
+
+    if (!gemm_supports(ctx, precision) || N % GEMM_TILE_SIZE != 0) {
+        return CL_INVALID_VALUE;
+    }
+    kernel = precision == GEMM_FP16 ? ctx->kernel_fp16
+           : precision == GEMM_FP64 ? ctx->kernel_fp64
+           : ctx->kernel_fp32;
+
+    if (precision == GEMM_FP32 && ctx->specialize) {
+        char options[64];
+        snprintf(options, sizeof(options), "-DMATRIX_N=%d", N);
+        if (kernel_cache_should_specialize(&ctx->cache, options)) {
+            // Owned by the cache, a repeated size costs no program or kernel creation.
+            cl_kernel specialized = kernel_cache_get_kernel(&ctx->cache, options, "matrix", NULL, &err);
+            if (specialized != NULL) {
+                kernel = specialized;
+            }
+        }
+    }
+
+    void* h_A = to_storage(A, count, precision);
+    void* h_B = to_storage(B, count, precision);
+    void* h_C = precision == GEMM_FP32 ? (void*)C : malloc(bytes);
+    if (h_A == NULL || h_B == NULL || h_C == NULL) {
+        err = CL_OUT_OF_HOST_MEMORY;
+        goto cleanup_host;
+    }
+
+    cl_mem d_A = pool_acquire(&ctx->pool, bytes, &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating buffer A. Error code: %d\n", err);
+        goto cleanup_host;
+    }
+    cl_mem d_B = pool_acquire(&ctx->pool, bytes, &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating buffer B. Error code: %d\n", err);
+        pool_release(&ctx->pool, d_A);
+        goto cleanup_host;
+    }
+    cl_mem d_C = pool_acquire(&ctx->pool, bytes, &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating buffer C. Error code: %d\n", err);
+        pool_release(&ctx->pool, d_A);
+        pool_release(&ctx->pool, d_B);
+        goto cleanup_host;
+    }
+
+    err = clEnqueueWriteBuffer(ctx->command_queue, d_A, CL_FALSE, 0, bytes, h_A, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(ctx->command_queue, d_B, CL_FALSE, 0, bytes, h_B, 0, NULL, NULL);
+
+    clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_A);
+    clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_B);
+    clSetKernelArg(kernel, 2, sizeof(cl_mem), &d_C);
+    clSetKernelArg(kernel, 3, sizeof(int), &N);
+
+    size_t global_size[2] = {(size_t)N, (size_t)N};
+    size_t local_size[2] = {GEMM_TILE_SIZE, GEMM_TILE_SIZE};
+    cl_event event;
+
+    if (err == CL_SUCCESS) {
+        err = clEnqueueNDRangeKernel(ctx->command_queue, kernel, 2, NULL, global_size, local_size, 0, NULL, &event);
+    }
+    if (err == CL_SUCCESS) {
+        // Host buffer <- Device buffer
+        err = clEnqueueReadBuffer(ctx->command_queue, d_C, CL_TRUE, 0, bytes, h_C, 1, &event, NULL);
+        if (kernel_ms != NULL) {
+            *kernel_ms = getEventTime(event);
+        }
+        clReleaseEvent(event);
+    }
+
+    clFinish(ctx->command_queue);
+    pool_release(&ctx->pool, d_A);
+    pool_release(&ctx->pool, d_B);
+    pool_release(&ctx->pool, d_C);
+
+    if (err == CL_SUCCESS) {
+        from_storage(h_C, C, count, precision);
+    }
+
+cleanup_host:
+    if (precision != GEMM_FP32) {
+        free(h_A);
+        free(h_B);
+        free(h_C);
+    }
+    return err;
+}
@@ -0,0 +1,95 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+#include "device_pool.h"
+#include "kernel_cache.h"
+
+#define GEMM_TILE_SIZE 16
+
+#ifndef DEVICE_TYPE
+#define DEVICE_TYPE CL_DEVICE_TYPE_GPU
+#endif
+
+typedef enum {
+    GEMM_FP32,
+    GEMM_FP16,
+    GEMM_FP64
+} GemmPrecision;
+
+/**
+ * A sub-matrix inside a device buffer: element (i, j) is at
+ * offset + i * ld + j floats.
+ */
+typedef struct {
+    cl_mem mem;
+    int offset;
+    int ld;
+} MatrixView;
+
+/**
+ * OpenCL objects shared by every GEMM variant.
+ */
+typedef struct {
+    cl_platform_id platform_id;
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_program program;
+    cl_kernel kernel_fp32;
+    cl_kernel kernel_fp16;
+    cl_kernel kernel_fp64;
+    cl_kernel kernel_view;
+    cl_kernel kernel_add;
+    int has_fp16;
+    int has_fp64;
+    DevicePool pool;
+    KernelCache cache;
+    int specialize;
+} GemmContext;
+
+/**
+ * Create the context, queue and the GEMM kernels for the first device of
+ * DEVICE_TYPE (or any other device when there is none of that type).
+ *
+ * path: Path of the matrix.cl source file
+ *
+ * Returns CL_SUCCESS or the OpenCL error code of the failing call
+ */
+cl_int gemm_init(GemmContext* ctx, const char* const path);
+
+/**
+ * Release every OpenCL object owned by the context.
+ */
+void gemm_release(GemmContext* ctx);
+
+/**
+ * Returns non-zero when the device can run the given precision.
+ */
+int gemm_supports(const GemmContext* ctx, GemmPrecision precision);
+
+const char* gemm_precision_name(GemmPrecision precision);
+
+/**
+ * Round N up to a multiple of the tile size.
+ */
+int gemm_padded_size(int N);
+
+/**
+ * C = A * B on the device with the given storage precision.
+ * Device buffers are taken from ctx->pool and given back afterwards.
+ * With ctx->specialize set, fp32 runs of a repeatedly used N use a
+ * program built with -DMATRIX_N=N from ctx->cache, the first run of a
+ * size and the other precisions use the generic kernels.
+ *
+ * A, B, C: Row-major host matrices of N x N floats, N must be a multiple of GEMM_TILE_SIZE
+ * kernel_ms: Kernel execution time in milliseconds (may be NULL)
+ */
+cl_int gemm_run(GemmContext* ctx, GemmPrecision precision,
+                const float* A, const float* B, float* C, int N, double* kernel_ms);
+
+double getEventTime(cl_event event);
+
+#endif
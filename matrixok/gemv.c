@@ -0,0 +1,97 @@
+#include "gemv.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static size_t round_up(int n, int multiple)
+{
+    return (size_t)(n + multiple - 1) / multiple * multiple;
+}
+
+cl_int gemv_init(Gemv* gemv, GemmContext* gemm)
+{
+    cl_int err;
+
+    memset(gemv, 0, sizeof(Gemv));
+    gemv->gemm = gemm;
+
+    gemv->kernel_gemv = clCreateKernel(gemm->program, "gemv", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating the gemv kernel. Error code: %d\n", err);
+        return err;
+    }
+    gemv->kernel_gemv_t = clCreateKernel(gemm->program, "gemv_t", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating the gemv_t kernel. Error code: %d\n", err);
+    }
+    return err;
+}
+
+void gemv_release(Gemv* gemv)
+{
+    if (gemv->kernel_gemv != NULL) {
+        clReleaseKernel(gemv->kernel_gemv);
+    }
+    if (gemv->kernel_gemv_t != NULL) {
+        clReleaseKernel(gemv->kernel_gemv_t);
+    }
+    memset(gemv, 0, sizeof(Gemv));
+}
+
+static cl_int set_args(cl_kernel kernel, float alpha, MatrixView A, int rows, int cols, MatrixView X, int count,
+                       float beta, MatrixView Y)
+{
+    cl_int err;
+
+    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &A.mem);
+    err |= clSetKernelArg(kernel, 1, sizeof(int), &A.offset);
+    err |= clSetKernelArg(kernel, 2, sizeof(int), &A.ld);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &X.mem);
+    err |= clSetKernelArg(kernel, 4, sizeof(int), &X.offset);
+    err |= clSetKernelArg(kernel, 5, sizeof(int), &X.ld);
+    err |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &Y.mem);
+    err |= clSetKernelArg(kernel, 7, sizeof(int), &Y.offset);
+    err |= clSetKernelArg(kernel, 8, sizeof(int), &Y.ld);
+    err |= clSetKernelArg(kernel, 9, sizeof(int), &rows);
+    err |= clSetKernelArg(kernel, 10, sizeof(int), &cols);
+    err |= clSetKernelArg(kernel, 11, sizeof(int), &count);
+    err |= clSetKernelArg(kernel, 12, sizeof(float), &alpha);
+    err |= clSetKernelArg(kernel, 13, sizeof(float), &beta);
+    return err;
+}
+
+cl_int gemv_run(Gemv* gemv, float alpha, MatrixView A, int rows, int cols, MatrixView X, int count,
+                float beta, MatrixView Y, cl_event* event)
+{
+    if (count < 1 || count > GEMV_MAX_VECTORS) {
+        return CL_INVALID_VALUE;
+    }
+    cl_int err = set_args(gemv->kernel_gemv, alpha, A, rows, cols, X, count, beta, Y);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    // One work-group per GEMV_ROWS rows, dimension 0 runs along the row.
+    size_t global_size[2] = {GEMV_LANES, round_up(rows, GEMV_ROWS)};
+    size_t local_size[2] = {GEMV_LANES, GEMV_ROWS};
+    return clEnqueueNDRangeKernel(gemv->gemm->command_queue, gemv->kernel_gemv, 2, NULL, global_size, local_size,
+                                  0, NULL, event);
+}
+
+cl_int gemv_transposed(Gemv* gemv, float alpha, MatrixView A, int rows, int cols, MatrixView X, int count,
+                       float beta, MatrixView Y, cl_event* event)
+{
+    if (count < 1 || count > GEMV_MAX_VECTORS) {
+        return CL_INVALID_VALUE;
+    }
+    cl_int err = set_args(gemv->kernel_gemv_t, alpha, A, rows, cols, X, count, beta, Y);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    // One work-group per GEMV_LANES columns, its GEMV_ROWS slices split the rows.
+    size_t global_size[2] = {round_up(cols, GEMV_LANES), GEMV_ROWS};
+    size_t local_size[2] = {GEMV_LANES, GEMV_ROWS};
+    return clEnqueueNDRangeKernel(gemv->gemm->command_queue, gemv->kernel_gemv_t, 2, NULL, global_size, local_size,
+                                  0, NULL, event);
+}
@@ -0,0 +1,50 @@
+#ifndef GEMV_H
+#define GEMV_H
+
+#include "gemm.h"
+
+/**
+ * Work-group shape of the gemv kernels, the same values as in matrix.cl.
+ */
+#define GEMV_LANES 64
+#define GEMV_ROWS 4
+#define GEMV_MAX_VECTORS 8
+
+/**
+ * Matrix-vector products on device matrices. GEMV reads every element of
+ * A once, so it is bound by memory bandwidth: multiplying a few vectors
+ * together (count > 1) reuses every loaded element of A for all of them.
+ */
+typedef struct {
+    GemmContext* gemm;
+    cl_kernel kernel_gemv;
+    cl_kernel kernel_gemv_t;
+} Gemv;
+
+cl_int gemv_init(Gemv* gemv, GemmContext* gemm);
+
+void gemv_release(Gemv* gemv);
+
+/**
+ * Y = alpha * A * X + beta * Y for a rows x cols view of A.
+ * Y is not read when beta is 0.
+ *
+ * X: cols x count view (row-major, one vector per column, ld >= count)
+ * Y: rows x count view
+ * count: Number of vectors, 1 to GEMV_MAX_VECTORS
+ * event: Event of the kernel, released by the caller (may be NULL)
+ */
+cl_int gemv_run(Gemv* gemv, float alpha, MatrixView A, int rows, int cols, MatrixView X, int count,
+                float beta, MatrixView Y, cl_event* event);
+
+/**
+ * Y = alpha * A^T * X + beta * Y for a rows x cols view of A, without
+ * transposing A.
+ *
+ * X: rows x count view
+ * Y: cols x count view
+ */
+cl_int gemv_transposed(Gemv* gemv, float alpha, MatrixView A, int rows, int cols, MatrixView X, int count,
+                       float beta, MatrixView Y, cl_event* event);
+
+#endif
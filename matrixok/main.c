@@ -1,16 +1,30 @@
 #include "kernel_loader.h"
-#define CL_TARGET_OPENCL_VERSION 220
+#include "gemm.h"
+#include "verify.h"
+#include "strassen.h"
+#include "packing.h"
+#include "matrix_ops.h"
+#include "transfer.h"
+#include "gemv.h"
+#include "numa_gemm.h"
+#include "perf_regions.h"
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <CL/cl.h>
+#include <string.h>
 #include <time.h>
 
 const int MATRIX_SIZE = 10000;
+const int VERIFY_ROWS = 64;
 
-void randomMatrix(float* mat, int size) {
-    for (int i = 0; i < size * size; i++) {
-        mat[i] = (float)(rand() % 10);
+void randomMatrix(float* mat, int size, int ld) {
+    perf_region_begin("randomMatrix");
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            mat[i * ld + j] = (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+        }
     }
+    perf_region_end();
 }
 
 void printMatrix(float* mat, int size) {
@@ -22,231 +36,953 @@ void printMatrix(float* mat, int size) {
     }
 }
 
-double getEventTime(cl_event event) {
-    cl_ulong start, end;
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
-    return (double)(end - start) * 1e-6;  // Nanoseconds to milliseconds
+static void printUsage(const char* program)
+{
+    printf("Usage: %s [size] [fp32|fp16|fp64|all] [verify]\n", program);
+    printf("       %s [size] strassen [cutoff] [verify]\n", program);
+    printf("       %s [size] specialize [repeats]\n", program);
+    printf("       %s [size] pack [B count] [verify]\n", program);
+    printf("       %s [size] ops [verify]\n", program);
+    printf("       %s [size] transfer [max MB]\n", program);
+    printf("       %s [size] gemv [vectors] [verify]\n", program);
+    printf("       %s [size] numa [verify]\n", program);
 }
 
-int main(void)
+static int parsePrecision(const char* name, GemmPrecision* precision)
 {
-    int N = MATRIX_SIZE;
-    size_t matrixSize = N * N * sizeof(float);
+    if (strcmp(name, "fp32") == 0) {
+        *precision = GEMM_FP32;
+    } else if (strcmp(name, "fp16") == 0) {
+        *precision = GEMM_FP16;
+    } else if (strcmp(name, "fp64") == 0) {
+        *precision = GEMM_FP64;
+    } else {
+        return 0;
+    }
+    return 1;
+}
 
-    float *A = (float*)malloc(matrixSize);
-    float *B = (float*)malloc(matrixSize);
-    float *C = (float*)malloc(matrixSize);
-    
-    randomMatrix(A, N);
-    randomMatrix(B, N);
+// Largest relative error the verify mode accepts. fp16 rounds the inputs
+// and the result to 11 significant bits.
+static double precisionTolerance(GemmPrecision precision)
+{
+    switch (precision) {
+    case GEMM_FP16:
+        return 1e-2;
+    case GEMM_FP64:
+        return 1e-9;
+    default:
+        return 1e-4;
+    }
+}
 
-    // printf("Matrix A:\n");
-    // printMatrix(A, N);
-    // printf("Matrix B:\n");
-    // printMatrix(B, N);
+// Returns 1 when the GEMM failed or its result is outside the tolerance.
+static int runPrecision(GemmContext* ctx, GemmPrecision precision,
+                        const float* A, const float* B, float* C, int N, int verify)
+{
+    double kernel_ms = 0.0;
+    int failed = 0;
 
-    int i;
-    cl_int err;
-    int error_code;
-
-    cl_uint n_platforms;
-    cl_platform_id platform_id;
-    err = clGetPlatformIDs(1, &platform_id, &n_platforms);
-    if (err != CL_SUCCESS)
-    {
-        printf("[ERROR] Error calling clGetPlatformIDs. Error code: %d\n", err);
-        free(A);
-        free(B);
-        free(C);
+    if (!gemm_supports(ctx, precision)) {
+        printf("%s: not supported by the device, skipped\n", gemm_precision_name(precision));
         return 0;
     }
 
-    cl_device_id device_id;
-    cl_uint n_devices;
-    err = clGetDeviceIDs(
-        platform_id,
-        CL_DEVICE_TYPE_GPU,
-        1,
-        &device_id,
-        &n_devices);
-    if (err != CL_SUCCESS)
-    {
-        printf("[ERROR] Error calling clGetDeviceIDs. Error code: %d\n", err);
-        free(A);
-        free(B);
-        free(C);
-        return 0;
+    cl_int err = gemm_run(ctx, precision, A, B, C, N, &kernel_ms);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] %s GEMM failed. Error code: %d\n", gemm_precision_name(precision), err);
+        return 1;
     }
 
-    cl_context context = clCreateContext(NULL, n_devices, &device_id, NULL, NULL, NULL);
+    double gflops = 2.0 * N * N * (double)N / (kernel_ms * 1e6);
+    printf("%s: kernel %.3f ms, %.2f GFLOP/s", gemm_precision_name(precision), kernel_ms, gflops);
+    if (verify) {
+        GemmError error = verify_gemm(A, B, C, N, VERIFY_ROWS);
+        failed = !(error.max_rel_error <= precisionTolerance(precision));
+        printf(", max abs error %.3e, rel error %.3e (%d rows) %s",
+               error.max_abs_error, error.max_rel_error, error.checked_rows, failed ? "FAILED" : "OK");
+    }
+    printf("\n");
+    return failed;
+}
 
-    const char *kernel_code = load_kernel_source("matrix.cl", &error_code);
-    if (error_code != 0)
-    {
-        printf("Source code loading error!\n");
-        free(A);
-        free(B);
-        free(C);
-        return 0;
+// Largest difference to the classical result, relative to its largest element.
+static double relativeDifference(const float* C, const float* ref, int N)
+{
+    double max_diff = 0.0;
+    double max_ref = 0.0;
+    for (size_t i = 0; i < (size_t)N * N; i++) {
+        double diff = fabs((double)C[i] - ref[i]);
+        if (diff > max_diff) {
+            max_diff = diff;
+        }
+        if (fabs(ref[i]) > max_ref) {
+            max_ref = fabs(ref[i]);
+        }
     }
-    cl_program program = clCreateProgramWithSource(context, 1, &kernel_code, NULL, NULL);
-    const char options[] = "";
-    err = clBuildProgram(
-        program,
-        1,
-        &device_id,
-        options,
-        NULL,
-        NULL);
-    if (err != CL_SUCCESS)
-    {
-        printf("Build error! Code: %d\n", err);
-        size_t real_size;
-        err = clGetProgramBuildInfo(
-            program,
-            device_id,
-            CL_PROGRAM_BUILD_LOG,
-            0,
-            NULL,
-            &real_size);
-        char *build_log = (char *)malloc(sizeof(char) * (real_size + 1));
-        err = clGetProgramBuildInfo(
-            program,
-            device_id,
-            CL_PROGRAM_BUILD_LOG,
-            real_size + 1,
-            build_log,
-            &real_size);
-        printf("Real size : %d\n", real_size);
-        printf("Build log : %s\n", build_log);
-        free(build_log);
-        free(A);
-        free(B);
-        free(C);
-        return 0;
+    return max_ref > 0.0 ? max_diff / max_ref : 0.0;
+}
+
+static void runStrassen(GemmContext* ctx, const float* A, const float* B, float* C,
+                        int N, const int* cutoffs, int cutoff_count, int verify)
+{
+    double classical_ms = 0.0;
+    float* C_classical = (float*)malloc(sizeof(float) * (size_t)N * N);
+    if (C_classical == NULL) {
+        printf("[ERROR] Memory allocation failed\n");
+        return;
+    }
+
+    cl_int err = gemm_run(ctx, GEMM_FP32, A, B, C_classical, N, &classical_ms);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Classical GEMM failed. Error code: %d\n", err);
+        free(C_classical);
+        return;
+    }
+    double flops = 2.0 * N * N * (double)N;
+    printf("classical: %.3f ms, %.2f GFLOP/s\n", classical_ms, flops / (classical_ms * 1e6));
+
+    for (int i = 0; i < cutoff_count; i++) {
+        double strassen_ms = 0.0;
+        err = strassen_run(ctx, &ctx->pool, A, B, C, N, cutoffs[i], &strassen_ms);
+        if (err != CL_SUCCESS) {
+            printf("[ERROR] Strassen GEMM failed (cutoff %d). Error code: %d\n", cutoffs[i], err);
+            continue;
+        }
+        printf("strassen cutoff %5d: %.3f ms, %.2f effective GFLOP/s, speedup %.2fx, rel diff to classical %.3e",
+               cutoffs[i], strassen_ms, flops / (strassen_ms * 1e6), classical_ms / strassen_ms,
+               relativeDifference(C, C_classical, N));
+        if (verify) {
+            GemmError error = verify_gemm(A, B, C, N, VERIFY_ROWS);
+            printf(", rel error %.3e", error.max_rel_error);
+        }
+        printf("\n");
+    }
+
+    pool_print_stats(&ctx->pool, "device pool");
+    free(C_classical);
+}
+
+static double nowMs(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// Repeated C = A * B_i: every product uploads both operands with gemm_run,
+// against packed operands kept in the pack cache.
+static void runPacking(GemmContext* ctx, const float* A, float* C, int size, int N, int count, int verify)
+{
+    const int rounds = 3;
+    float** B = (float**)calloc(count, sizeof(float*));
+    float* C_packed = (float*)malloc(sizeof(float) * (size_t)N * N);
+    double kernel_ms, plain_kernel_ms = 0.0, packed_kernel_ms = 0.0;
+
+    for (int i = 0; i < count && C_packed != NULL; i++) {
+        B[i] = (float*)calloc((size_t)N * N, sizeof(float));
+        if (B[i] == NULL) {
+            break;
+        }
+        randomMatrix(B[i], size, N);
+    }
+    if (C_packed == NULL || B[count - 1] == NULL) {
+        printf("[ERROR] Memory allocation failed\n");
+        goto cleanup;
+    }
+
+    double start = nowMs();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) {
+            if (gemm_run(ctx, GEMM_FP32, A, B[i], C, N, &kernel_ms) != CL_SUCCESS) {
+                printf("[ERROR] GEMM failed\n");
+                goto cleanup;
+            }
+            plain_kernel_ms += kernel_ms;
+        }
+    }
+    double plain_ms = (nowMs() - start) / (rounds * count);
+
+    PackCache cache;
+    if (pack_cache_init(&cache, ctx, count + 1) != CL_SUCCESS) {
+        pack_cache_release(&cache);
+        goto cleanup;
+    }
+    start = nowMs();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) {
+            PackedResult result;
+            cl_int err = packed_gemm(&cache, A, 0, B[i], 0, N, &result, &kernel_ms);
+            if (err == CL_SUCCESS) {
+                err = packed_result_unpack(&cache, &result, C_packed);
+            }
+            packed_result_release(&cache, &result);
+            if (err != CL_SUCCESS) {
+                printf("[ERROR] Packed GEMM failed. Error code: %d\n", err);
+                pack_cache_release(&cache);
+                goto cleanup;
+            }
+            packed_kernel_ms += kernel_ms;
+        }
+    }
+    double packed_ms = (nowMs() - start) / (rounds * count);
+
+    printf("%d x %d products of %d matrices\n", rounds, count, count + 1);
+    printf("row-major, no cache: %.3f ms/product (kernel %.3f ms)\n", plain_ms, plain_kernel_ms / (rounds * count));
+    printf("packed, cached:      %.3f ms/product (kernel %.3f ms), speedup %.2fx, rel diff %.3e",
+           packed_ms, packed_kernel_ms / (rounds * count), plain_ms / packed_ms,
+           relativeDifference(C_packed, C, N));
+    if (verify) {
+        GemmError error = verify_gemm(A, B[count - 1], C_packed, N, VERIFY_ROWS);
+        printf(", rel error %.3e", error.max_rel_error);
+    }
+    printf("\n");
+    pack_cache_print_stats(&cache, "pack cache");
+    pack_cache_release(&cache);
+
+cleanup:
+    for (int i = 0; i < count; i++) {
+        free(B[i]);
+    }
+    free(B);
+    free(C_packed);
+}
+
+// Average kernel time of an operation over a few launches, the first one is a warm-up.
+#define OPS_REPEATS 5
+
+static double maxDifference(const float* X, const float* Y, int size, int ld, int transposed)
+{
+    double max_diff = 0.0;
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            double diff = fabs((double)X[(size_t)i * ld + j] - (transposed ? Y[(size_t)j * ld + i] : Y[(size_t)i * ld + j]));
+            if (diff > max_diff) {
+                max_diff = diff;
+            }
+        }
     }
-    cl_command_queue command_queue = clCreateCommandQueue(
-        context, device_id, CL_QUEUE_PROFILING_ENABLE, NULL);
+    return max_diff;
+}
+
+static void printBandwidth(const char* name, double ms, double bytes, double copy_gbs)
+{
+    double gbs = bytes / (ms * 1e6);
+    printf("%-20s %8.3f ms, %7.2f GB/s, %5.1f%% of copy\n", name, ms, gbs, 100.0 * gbs / copy_gbs);
+}
 
-    cl_kernel kernel = clCreateKernel(program, "matrix", NULL);
+// Transposes and elementwise operations on size x size views with leading dimension N,
+// measured against a plain device-to-device copy.
+static void runOps(GemmContext* ctx, const float* A, const float* B, float* C, int size, int N, int verify)
+{
+    size_t bytes = sizeof(float) * (size_t)N * N;
+    double matrix_bytes = sizeof(float) * (double)size * size;
+    cl_int err;
+    cl_event event;
+    MatrixOps ops;
 
-    cl_mem d_A = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                    sizeof(float) * MATRIX_SIZE, A, &err);
+    if (matrix_ops_init(&ops, ctx) != CL_SUCCESS) {
+        matrix_ops_release(&ops);
+        return;
+    }
+
+    cl_mem d_A = pool_acquire(&ctx->pool, bytes, &err);
+    cl_mem d_B = err == CL_SUCCESS ? pool_acquire(&ctx->pool, bytes, &err) : NULL;
+    cl_mem d_D = err == CL_SUCCESS ? pool_acquire(&ctx->pool, bytes, &err) : NULL;
     if (err != CL_SUCCESS) {
-        printf("[ERROR] Error creating buffer A. Error code: %d\n", err);
-        free(A);
-        free(B);
-        free(C);
+        printf("[ERROR] Error creating buffers. Error code: %d\n", err);
+        goto cleanup;
+    }
+    err = clEnqueueWriteBuffer(ctx->command_queue, d_A, CL_FALSE, 0, bytes, A, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(ctx->command_queue, d_B, CL_TRUE, 0, bytes, B, 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error writing buffers. Error code: %d\n", err);
+        goto cleanup;
+    }
+
+    MatrixView vA = {d_A, 0, N};
+    MatrixView vB = {d_B, 0, N};
+    MatrixView vD = {d_D, 0, N};
+    double ms[6] = {0.0};
+    for (int r = 0; r <= OPS_REPEATS; r++) {
+        for (int op = 0; op < 6 && err == CL_SUCCESS; op++) {
+            switch (op) {
+            case 0:
+                err = clEnqueueCopyBuffer(ctx->command_queue, d_A, d_D, 0, 0, bytes, 0, NULL, &event);
+                break;
+            case 1:
+                err = matrix_transpose(&ops, vA, vD, size, size, &event);
+                break;
+            case 2:
+                err = matrix_transpose_inplace(&ops, vD, size, &event);
+                break;
+            case 3:
+                err = matrix_add(&ops, vA, vB, vD, size, size, &event);
+                break;
+            case 4:
+                err = matrix_scale(&ops, 2.0f, vA, vD, size, size, &event);
+                break;
+            default:
+                err = matrix_axpby(&ops, 0.5f, vA, -2.0f, vB, vD, size, size, &event);
+                break;
+            }
+            if (err == CL_SUCCESS) {
+                clWaitForEvents(1, &event);
+                if (r > 0) {
+                    ms[op] += getEventTime(event) / OPS_REPEATS;
+                }
+                clReleaseEvent(event);
+            }
+        }
+    }
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Matrix operation failed. Error code: %d\n", err);
+        goto cleanup;
+    }
+
+    double copy_gbs = 2.0 * bytes / (ms[0] * 1e6);
+    printf("%-20s %8.3f ms, %7.2f GB/s\n", "copy", ms[0], copy_gbs);
+    printBandwidth("transpose", ms[1], 2.0 * matrix_bytes, copy_gbs);
+    printBandwidth("transpose in-place", ms[2], 2.0 * matrix_bytes, copy_gbs);
+    printBandwidth("add", ms[3], 3.0 * matrix_bytes, copy_gbs);
+    printBandwidth("scale", ms[4], 2.0 * matrix_bytes, copy_gbs);
+    printBandwidth("axpby", ms[5], 3.0 * matrix_bytes, copy_gbs);
+
+    if (verify) {
+        // D = A^T, then D^T = A in place, then D = 0.5 * A - 2 * B.
+        err = matrix_transpose(&ops, vA, vD, size, size, NULL);
+        err |= clEnqueueReadBuffer(ctx->command_queue, d_D, CL_TRUE, 0, bytes, C, 0, NULL, NULL);
+        double transpose_diff = maxDifference(C, A, size, N, 1);
+        err |= matrix_transpose_inplace(&ops, vD, size, NULL);
+        err |= clEnqueueReadBuffer(ctx->command_queue, d_D, CL_TRUE, 0, bytes, C, 0, NULL, NULL);
+        double inplace_diff = maxDifference(C, A, size, N, 0);
+        err |= matrix_axpby(&ops, 0.5f, vA, -2.0f, vB, vD, size, size, NULL);
+        err |= clEnqueueReadBuffer(ctx->command_queue, d_D, CL_TRUE, 0, bytes, C, 0, NULL, NULL);
+        double axpby_diff = 0.0;
+        for (int i = 0; i < size; i++) {
+            for (int j = 0; j < size; j++) {
+                size_t k = (size_t)i * N + j;
+                double diff = fabs((double)C[k] - (0.5 * A[k] - 2.0 * B[k]));
+                if (diff > axpby_diff) {
+                    axpby_diff = diff;
+                }
+            }
+        }
+        printf("verify: transpose %.1e, in-place %.1e, axpby %.1e%s\n", transpose_diff, inplace_diff, axpby_diff,
+               err != CL_SUCCESS ? " (OpenCL error)" : "");
+    }
+
+cleanup:
+    clFinish(ctx->command_queue);
+    if (d_A != NULL) {
+        pool_release(&ctx->pool, d_A);
+    }
+    if (d_B != NULL) {
+        pool_release(&ctx->pool, d_B);
+    }
+    if (d_D != NULL) {
+        pool_release(&ctx->pool, d_D);
+    }
+    matrix_ops_release(&ops);
+}
+
+#define GEMV_REPEATS 20
+#define GEMV_GEMM_LIMIT 4096
+
+// Largest error of Y (or Y for A^T when transposed) against an fp64 host product,
+// relative to the largest reference value.
+static double gemvError(const float* A, int N, int size, const float* X, const float* Y, int count, int transposed)
+{
+    double max_diff = 0.0;
+    double max_ref = 0.0;
+    for (int i = 0; i < size; i++) {
+        for (int v = 0; v < count; v++) {
+            double ref = 0.0;
+            for (int k = 0; k < size; k++) {
+                double a = transposed ? A[(size_t)k * N + i] : A[(size_t)i * N + k];
+                ref += a * X[(size_t)k * GEMV_MAX_VECTORS + v];
+            }
+            double diff = fabs(Y[(size_t)i * GEMV_MAX_VECTORS + v] - ref);
+            max_diff = diff > max_diff ? diff : max_diff;
+            max_ref = fabs(ref) > max_ref ? fabs(ref) : max_ref;
+        }
+    }
+    return max_ref > 0.0 ? max_diff / max_ref : max_diff;
+}
+
+// y = A * x and y = A^T * x with 1 to max_vectors vectors on the size x size matrix.
+// GEMV is memory-bound, so the bandwidth is compared with a device-to-device copy;
+// the GEMM path with x padded into a matrix is timed for reference.
+static void runGemv(GemmContext* ctx, const float* A, float* C, int size, int N, int max_vectors, int verify)
+{
+    size_t bytes = sizeof(float) * (size_t)N * N;
+    size_t vector_bytes = sizeof(float) * (size_t)N * GEMV_MAX_VECTORS;
+    double matrix_bytes = sizeof(float) * (double)size * size;
+    cl_int err;
+    cl_event event;
+    Gemv gemv;
+
+    if (gemv_init(&gemv, ctx) != CL_SUCCESS) {
+        gemv_release(&gemv);
+        return;
+    }
+
+    float* X = (float*)calloc((size_t)N * GEMV_MAX_VECTORS, sizeof(float));
+    float* Y = (float*)calloc((size_t)N * GEMV_MAX_VECTORS, sizeof(float));
+    cl_mem d_A = pool_acquire(&ctx->pool, bytes, &err);
+    cl_mem d_D = err == CL_SUCCESS ? pool_acquire(&ctx->pool, bytes, &err) : NULL;
+    cl_mem d_X = err == CL_SUCCESS ? pool_acquire(&ctx->pool, vector_bytes, &err) : NULL;
+    cl_mem d_Y = err == CL_SUCCESS ? pool_acquire(&ctx->pool, vector_bytes, &err) : NULL;
+    if (X == NULL || Y == NULL || err != CL_SUCCESS) {
+        printf("[ERROR] Error creating buffers. Error code: %d\n", err);
+        goto cleanup;
+    }
+    for (int i = 0; i < size * GEMV_MAX_VECTORS; i++) {
+        X[i] = (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+    }
+    err = clEnqueueWriteBuffer(ctx->command_queue, d_A, CL_FALSE, 0, bytes, A, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(ctx->command_queue, d_X, CL_TRUE, 0, vector_bytes, X, 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error writing buffers. Error code: %d\n", err);
+        goto cleanup;
+    }
+
+    double copy_ms = 0.0;
+    for (int r = 0; r <= GEMV_REPEATS && err == CL_SUCCESS; r++) {
+        err = clEnqueueCopyBuffer(ctx->command_queue, d_A, d_D, 0, 0, bytes, 0, NULL, &event);
+        if (err == CL_SUCCESS) {
+            clWaitForEvents(1, &event);
+            if (r > 0) {
+                copy_ms += getEventTime(event) / GEMV_REPEATS;
+            }
+            clReleaseEvent(event);
+        }
+    }
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error copying the matrix. Error code: %d\n", err);
+        goto cleanup;
+    }
+    double copy_gbs = 2.0 * bytes / (copy_ms * 1e6);
+    printf("%-20s %8.3f ms, %7.2f GB/s\n", "copy", copy_ms, copy_gbs);
+
+    MatrixView vA = {d_A, 0, N};
+    MatrixView vX = {d_X, 0, GEMV_MAX_VECTORS};
+    MatrixView vY = {d_Y, 0, GEMV_MAX_VECTORS};
+    double single_ms = 0.0;
+    for (int count = 1; count <= max_vectors; count *= 2) {
+        for (int transposed = 0; transposed < 2; transposed++) {
+            double ms = 0.0;
+            for (int r = 0; r <= GEMV_REPEATS && err == CL_SUCCESS; r++) {
+                if (transposed) {
+                    err = gemv_transposed(&gemv, 1.0f, vA, size, size, vX, count, 0.0f, vY, &event);
+                } else {
+                    err = gemv_run(&gemv, 1.0f, vA, size, size, vX, count, 0.0f, vY, &event);
+                }
+                if (err == CL_SUCCESS) {
+                    clWaitForEvents(1, &event);
+                    if (r > 0) {
+                        ms += getEventTime(event) / GEMV_REPEATS;
+                    }
+                    clReleaseEvent(event);
+                }
+            }
+            if (err != CL_SUCCESS) {
+                printf("[ERROR] GEMV failed. Error code: %d\n", err);
+                goto cleanup;
+            }
+            if (count == 1 && !transposed) {
+                single_ms = ms;
+            }
+
+            // A is read once, whatever the number of vectors.
+            char name[32];
+            double moved = matrix_bytes + 2.0 * sizeof(float) * size * count;
+            double gbs = moved / (ms * 1e6);
+            snprintf(name, sizeof(name), "%s x%d", transposed ? "gemv_t" : "gemv", count);
+            printf("%-20s %8.3f ms, %7.2f GB/s, %5.1f%% of copy, %7.2f GFLOP/s, %8.3f ms/vector",
+                   name, ms, gbs, 100.0 * gbs / copy_gbs, 2.0 * size * size * count / (ms * 1e6), ms / count);
+            if (verify) {
+                err = clEnqueueReadBuffer(ctx->command_queue, d_Y, CL_TRUE, 0, vector_bytes, Y, 0, NULL, NULL);
+                printf(", max rel error %.1e%s", gemvError(A, N, size, X, Y, count, transposed),
+                       err != CL_SUCCESS ? " (OpenCL error)" : "");
+            }
+            printf("\n");
+        }
+    }
+
+    // The GEMM path: x in the first column of an otherwise zero N x N matrix.
+    if (N <= GEMV_GEMM_LIMIT) {
+        float* B = (float*)calloc((size_t)N * N, sizeof(float));
+        double gemm_ms = 0.0;
+        if (B != NULL) {
+            for (int i = 0; i < size; i++) {
+                B[(size_t)i * N] = X[(size_t)i * GEMV_MAX_VECTORS];
+            }
+            err = gemm_run(ctx, GEMM_FP32, A, B, C, N, &gemm_ms);
+            if (err == CL_SUCCESS) {
+                printf("%-20s %8.3f ms, %.1fx the time of gemv x1\n", "gemm (x padded)", gemm_ms, gemm_ms / single_ms);
+            }
+            free(B);
+        }
+    } else {
+        printf("gemm (x padded) skipped above size %d\n", GEMV_GEMM_LIMIT);
+    }
+
+cleanup:
+    clFinish(ctx->command_queue);
+    if (d_A != NULL) {
+        pool_release(&ctx->pool, d_A);
+    }
+    if (d_D != NULL) {
+        pool_release(&ctx->pool, d_D);
+    }
+    if (d_X != NULL) {
+        pool_release(&ctx->pool, d_X);
+    }
+    if (d_Y != NULL) {
+        pool_release(&ctx->pool, d_Y);
+    }
+    free(X);
+    free(Y);
+    gemv_release(&gemv);
+}
+
+// GEMM with the default placement (one context on the whole device, the
+// matrices written by the main thread) against one row band per NUMA node
+// with node local A, C bands and a replica of B. Meant for CPU devices.
+// Returns 1 when a run failed or the NUMA result is outside the tolerance.
+static int runNuma(GemmContext* ctx, const float* A, const float* B, float* C, int N, int verify)
+{
+    double flops = 2.0 * N * N * (double)N;
+    double default_ms = 0.0;
+    int failed = 0;
+    NumaGemm numa;
+
+    cl_int err = gemm_run(ctx, GEMM_FP32, A, B, C, N, &default_ms);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Default GEMM failed. Error code: %d\n", err);
+        return 1;
+    }
+    printf("default: kernel %.3f ms, %.2f GFLOP/s\n", default_ms, flops / (default_ms * 1e6));
+
+    err = numa_gemm_init(&numa, ctx->device_id, "matrix.cl", A, B, N);
+    if (err == CL_DEVICE_PARTITION_FAILED) {
+        numa_gemm_release(&numa);
         return 0;
     }
 
-    cl_mem d_B = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                    sizeof(float) * MATRIX_SIZE, B, &err);
+    // Scaling: the first 1, 2, ... nodes each compute their own band.
+    double kernel_ms[NUMA_MAX_NODES];
+    for (int used = 1; used <= numa.node_count && err == CL_SUCCESS; used++) {
+        double ms = 0.0;
+        double rows = 0.0;
+        err = numa_gemm_run(&numa, used, &ms, kernel_ms);
+        if (err != CL_SUCCESS) {
+            break;
+        }
+        for (int i = 0; i < used; i++) {
+            rows += numa.nodes[i].rows;
+        }
+        printf("%d node(s): %.3f ms, %.2f GFLOP/s\n", used, ms, 2.0 * rows * N * N / (ms * 1e6));
+        for (int i = 0; i < used; i++) {
+            printf("    node %d: rows %d-%d, kernel %.3f ms, %.2f GFLOP/s\n", numa.topology.node_ids[i],
+                   numa.nodes[i].row_start, numa.nodes[i].row_start + numa.nodes[i].rows - 1, kernel_ms[i],
+                   2.0 * numa.nodes[i].rows * N * (double)N / (kernel_ms[i] * 1e6));
+        }
+        if (used == numa.node_count) {
+            printf("NUMA aware: %.2fx the default GFLOP/s\n", default_ms / ms);
+        }
+    }
+    if (err == CL_SUCCESS && verify) {
+        err = numa_gemm_gather(&numa, C);
+        if (err == CL_SUCCESS) {
+            GemmError error = verify_gemm(A, B, C, N, VERIFY_ROWS);
+            failed = !(error.max_rel_error <= precisionTolerance(GEMM_FP32));
+            printf("NUMA result: max abs error %.3e, rel error %.3e (%d rows) %s\n",
+                   error.max_abs_error, error.max_rel_error, error.checked_rows, failed ? "FAILED" : "OK");
+        }
+    }
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] NUMA GEMM failed. Error code: %d\n", err);
+        failed = 1;
+    }
+    numa_gemm_release(&numa);
+    return failed;
+}
+
+#define TRANSFER_MIN_BYTES ((size_t)4096)
+#define TRANSFER_DEFAULT_MAX_MB 1024
+#define SMALL_WRITE_COUNT 256
+
+typedef struct {
+    double write_ms;
+    double read_ms;
+    double host_ms;
+} TransferTiming;
+
+// Enough repeats to move about 256 MB per direction.
+static int transferRepeats(size_t bytes)
+{
+    size_t repeats = ((size_t)256 << 20) / bytes;
+    return repeats < 3 ? 3 : (repeats > 200 ? 200 : (int)repeats);
+}
+
+/**
+ * Average write and read time of bytes between host and buffer. host_ms is
+ * the time the host spends inside the enqueue calls: the whole transfer
+ * when blocking, only the submission when asynchronous.
+ */
+static cl_int timeTransfers(GemmContext* ctx, cl_mem buffer, void* host, size_t bytes, int blocking, TransferTiming* timing)
+{
+    int repeats = transferRepeats(bytes);
+    cl_bool block = blocking ? CL_TRUE : CL_FALSE;
+    cl_int err = CL_SUCCESS;
+
+    timing->host_ms = 0.0;
+    for (int direction = 0; direction < 2 && err == CL_SUCCESS; direction++) {
+        double start = nowMs();
+        for (int r = 0; r < repeats && err == CL_SUCCESS; r++) {
+            if (direction == 0) {
+                err = clEnqueueWriteBuffer(ctx->command_queue, buffer, block, 0, bytes, host, 0, NULL, NULL);
+            } else {
+                err = clEnqueueReadBuffer(ctx->command_queue, buffer, block, 0, bytes, host, 0, NULL, NULL);
+            }
+        }
+        double submitted = nowMs();
+        clFinish(ctx->command_queue);
+        double ms = (nowMs() - start) / repeats;
+        timing->host_ms += (submitted - start) / repeats;
+        if (direction == 0) {
+            timing->write_ms = ms;
+        } else {
+            timing->read_ms = ms;
+        }
+    }
+    return err;
+}
+
+typedef struct {
+    unsigned char* destination;
+    size_t offset;
+    int completed;
+} ChunkTarget;
+
+static void chunkArrived(void* host, size_t bytes, cl_int status, void* user_data)
+{
+    ChunkTarget* target = (ChunkTarget*)user_data;
+    if (status == CL_COMPLETE) {
+        memcpy(target->destination + target->offset, host, bytes);
+        target->completed = 1;
+    }
+}
+
+// Pageable vs. pinned and blocking vs. asynchronous transfers from 4 KB up to max_mb,
+// coalesced small writes and a chunked read handed to callbacks.
+static void runTransfer(GemmContext* ctx, int max_mb)
+{
+    cl_ulong max_alloc = 0;
+    size_t max_bytes = (size_t)max_mb << 20;
+    TransferManager manager;
+    cl_int err;
+
+    clGetDeviceInfo(ctx->device_id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc), &max_alloc, NULL);
+    while (max_alloc > 0 && max_bytes > max_alloc) {
+        max_bytes /= 2;
+    }
+
+    transfer_init(&manager, ctx);
+    unsigned char* pageable = (unsigned char*)malloc(max_bytes);
+    unsigned char* pinned = (unsigned char*)transfer_alloc_pinned(&manager, max_bytes, &err);
+    cl_mem buffer = err == CL_SUCCESS ? pool_acquire(&ctx->pool, max_bytes, &err) : NULL;
+    if (pageable == NULL || pinned == NULL || buffer == NULL) {
+        printf("[ERROR] Error allocating %zu byte transfer buffers. Error code: %d\n", max_bytes, err);
+        goto cleanup;
+    }
+    // Touch every page, so the pageable runs do not measure page faults.
+    for (size_t i = 0; i < max_bytes; i++) {
+        pageable[i] = (unsigned char)(i * 7);
+        pinned[i] = (unsigned char)(i * 7);
+    }
+
+    printf("%10s | %-31s | %-31s | %-31s | %-31s\n", "bytes", "pageable blocking", "pageable async",
+           "pinned blocking", "pinned async");
+    printf("%10s | %-31s | %-31s | %-31s | %-31s\n", "", "write/read GB/s, host ms", "write/read GB/s, host ms",
+           "write/read GB/s, host ms", "write/read GB/s, host ms");
+    for (size_t bytes = TRANSFER_MIN_BYTES; bytes <= max_bytes && err == CL_SUCCESS; bytes *= 4) {
+        printf("%10zu", bytes);
+        for (int variant = 0; variant < 4 && err == CL_SUCCESS; variant++) {
+            TransferTiming timing = {0.0, 0.0, 0.0};
+            err = timeTransfers(ctx, buffer, variant < 2 ? (void*)pageable : (void*)pinned, bytes, variant % 2 == 0, &timing);
+            printf(" | %6.2f/%6.2f GB/s %9.3f ms", bytes / (timing.write_ms * 1e6), bytes / (timing.read_ms * 1e6),
+                   timing.host_ms);
+        }
+        printf("\n");
+    }
     if (err != CL_SUCCESS) {
-        printf("[ERROR] Error creating buffer B. Error code: %d\n", err);
+        printf("[ERROR] Transfer failed. Error code: %d\n", err);
+        goto cleanup;
+    }
+
+    // Scattered small writes: one enqueue each vs. coalesced by the manager.
+    for (size_t bytes = 256; bytes < TRANSFER_COALESCE_LIMIT && 2 * bytes * SMALL_WRITE_COUNT <= max_bytes; bytes *= 8) {
+        double start = nowMs();
+        for (int i = 0; i < SMALL_WRITE_COUNT; i++) {
+            clEnqueueWriteBuffer(ctx->command_queue, buffer, CL_FALSE, 2 * bytes * i, bytes, pageable + bytes * i, 0, NULL, NULL);
+        }
+        clFinish(ctx->command_queue);
+        double separate_ms = nowMs() - start;
+
+        start = nowMs();
+        for (int i = 0; i < SMALL_WRITE_COUNT && err == CL_SUCCESS; i++) {
+            err = transfer_write(&manager, buffer, 2 * bytes * i, pinned + bytes * (SMALL_WRITE_COUNT + i), bytes, 0, NULL, NULL);
+        }
+        if (err == CL_SUCCESS) {
+            err = transfer_finish(&manager);
+        }
+        double coalesced_ms = nowMs() - start;
+        if (err != CL_SUCCESS) {
+            break;
+        }
+
+        int correct = 1;
+        for (int i = 0; i < SMALL_WRITE_COUNT && correct; i++) {
+            err = clEnqueueReadBuffer(ctx->command_queue, buffer, CL_TRUE, 2 * bytes * i, bytes, pageable, 0, NULL, NULL);
+            correct = err == CL_SUCCESS && memcmp(pageable, pinned + bytes * (SMALL_WRITE_COUNT + i), bytes) == 0;
+        }
+        printf("%d x %zu byte writes: %.3f ms separate, %.3f ms coalesced (%.1fx) %s\n", SMALL_WRITE_COUNT, bytes,
+               separate_ms, coalesced_ms, separate_ms / coalesced_ms, correct ? "OK" : "WRONG");
+    }
+
+    // The whole buffer read back in TRANSFER_BATCH_SIZE chunks, each handed to a callback.
+    size_t chunk = TRANSFER_BATCH_SIZE < max_bytes ? TRANSFER_BATCH_SIZE : max_bytes;
+    int chunk_count = (int)((max_bytes + chunk - 1) / chunk);
+    ChunkTarget* targets = (ChunkTarget*)calloc(chunk_count, sizeof(ChunkTarget));
+    if (targets != NULL && err == CL_SUCCESS) {
+        err = clEnqueueWriteBuffer(ctx->command_queue, buffer, CL_TRUE, 0, max_bytes, pinned, 0, NULL, NULL);
+        memset(pageable, 0, max_bytes);
+        double start = nowMs();
+        for (int c = 0; c < chunk_count && err == CL_SUCCESS; c++) {
+            size_t offset = (size_t)c * chunk;
+            targets[c].destination = pageable;
+            targets[c].offset = offset;
+            err = transfer_read(&manager, buffer, offset, offset + chunk > max_bytes ? max_bytes - offset : chunk,
+                                0, NULL, chunkArrived, &targets[c]);
+            // At most 8 chunks in flight, so the pinned staging memory stays small.
+            while (err == CL_SUCCESS && manager.read_count >= 8) {
+                clWaitForEvents(1, &manager.reads[0].event);
+                transfer_poll(&manager);
+            }
+        }
+        transfer_finish(&manager);
+        double ms = nowMs() - start;
+        int completed = 0;
+        for (int c = 0; c < chunk_count; c++) {
+            completed += targets[c].completed;
+        }
+        printf("chunked read with callbacks: %d/%d chunks, %.2f GB/s %s\n", completed, chunk_count,
+               max_bytes / (ms * 1e6), memcmp(pageable, pinned, max_bytes) == 0 ? "OK" : "WRONG");
+    }
+    free(targets);
+    transfer_print_stats(&manager, "transfer manager");
+
+cleanup:
+    if (buffer != NULL) {
+        pool_release(&ctx->pool, buffer);
+    }
+    transfer_release(&manager);
+    free(pageable);
+}
+
+// Generic kernel vs. the kernel compiled for this N, over repeated runs.
+static void runSpecialize(GemmContext* ctx, const float* A, const float* B, float* C, int N, int repeats)
+{
+    double generic_ms = 0.0;
+    double specialized_ms = 0.0;
+    double kernel_ms;
+    int specialized_runs = 0;
+
+    ctx->specialize = 0;
+    for (int i = 0; i < repeats; i++) {
+        if (gemm_run(ctx, GEMM_FP32, A, B, C, N, &kernel_ms) != CL_SUCCESS) {
+            printf("[ERROR] Generic GEMM failed\n");
+            return;
+        }
+        generic_ms += kernel_ms;
+    }
+
+    ctx->specialize = 1;
+    for (int i = 0; i < repeats; i++) {
+        unsigned long before = ctx->cache.hits + ctx->cache.disk_hits + ctx->cache.builds;
+        if (gemm_run(ctx, GEMM_FP32, A, B, C, N, &kernel_ms) != CL_SUCCESS) {
+            printf("[ERROR] Specialized GEMM failed\n");
+            return;
+        }
+        // The first run of a size falls back to the generic kernel.
+        if (ctx->cache.hits + ctx->cache.disk_hits + ctx->cache.builds != before) {
+            specialized_ms += kernel_ms;
+            specialized_runs++;
+        }
+    }
+    ctx->specialize = 0;
+
+    generic_ms /= repeats;
+    printf("generic kernel: %.3f ms\n", generic_ms);
+    if (specialized_runs == 0) {
+        printf("specialized kernel: not used (needs at least 2 runs of the same size)\n");
+        return;
+    }
+    specialized_ms /= specialized_runs;
+    double compile_ms = ctx->cache.compile_ms_total;
+    printf("specialized kernel (-DMATRIX_N=%d): %.3f ms, %.2fx\n", N, specialized_ms, generic_ms / specialized_ms);
+    printf("compile/load: %.1f ms, amortized over %d runs: %.3f ms/run", compile_ms, repeats, compile_ms / repeats);
+    if (generic_ms > specialized_ms) {
+        printf(", break-even after %.1f runs", compile_ms / (generic_ms - specialized_ms));
+    }
+    printf("\n");
+    kernel_cache_print_stats(&ctx->cache, "kernel cache");
+}
+
+int main(int argc, char* argv[])
+{
+    // PERF_REGIONS=1 prints the counters of the host regions at exit.
+    perf_regions_init();
+    atexit(perf_regions_finish);
+
+    int size = MATRIX_SIZE;
+    int all = 0;
+    int strassen = 0;
+    int specialize = 0;
+    int repeats = 5;
+    int packing = 0;
+    int pack_count = 4;
+    int matrix_ops = 0;
+    int transfer = 0;
+    int transfer_mb = TRANSFER_DEFAULT_MAX_MB;
+    int gemv = 0;
+    int numa = 0;
+    int gemv_vectors = GEMV_MAX_VECTORS;
+    int verify = 0;
+    int failed = 0;
+    int cutoffs[16];
+    int cutoff_count = 0;
+    GemmPrecision precision = GEMM_FP32;
+
+    if (argc > 1) {
+        size = atoi(argv[1]);
+        if (size <= 0) {
+            printUsage(argv[0]);
+            return 0;
+        }
+    }
+    if (argc > 2) {
+        if (strcmp(argv[2], "all") == 0) {
+            all = 1;
+        } else if (strcmp(argv[2], "strassen") == 0) {
+            strassen = 1;
+        } else if (strcmp(argv[2], "specialize") == 0) {
+            specialize = 1;
+        } else if (strcmp(argv[2], "pack") == 0) {
+            packing = 1;
+        } else if (strcmp(argv[2], "ops") == 0) {
+            matrix_ops = 1;
+        } else if (strcmp(argv[2], "transfer") == 0) {
+            transfer = 1;
+        } else if (strcmp(argv[2], "gemv") == 0) {
+            gemv = 1;
+        } else if (strcmp(argv[2], "numa") == 0) {
+            numa = 1;
+        } else if (!parsePrecision(argv[2], &precision)) {
+            printUsage(argv[0]);
+            return 0;
+        }
+    }
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "verify") == 0) {
+            verify = 1;
+        } else if (strassen && cutoff_count == 0 && atoi(argv[i]) > 0) {
+            cutoffs[cutoff_count++] = atoi(argv[i]);
+        } else if (specialize && atoi(argv[i]) > 0) {
+            repeats = atoi(argv[i]);
+        } else if (packing && atoi(argv[i]) > 0) {
+            pack_count = atoi(argv[i]);
+        } else if (transfer && atoi(argv[i]) > 0) {
+            transfer_mb = atoi(argv[i]);
+        } else if (gemv && atoi(argv[i]) > 0) {
+            gemv_vectors = atoi(argv[i]) < GEMV_MAX_VECTORS ? atoi(argv[i]) : GEMV_MAX_VECTORS;
+        }
+    }
+    if (strassen && cutoff_count == 0) {
+        // Sweep the cutoff to find the crossover point of the device.
+        for (int cutoff = 4096; cutoff >= 128 && cutoff_count < 16; cutoff /= 2) {
+            if (cutoff < size) {
+                cutoffs[cutoff_count++] = cutoff;
+            }
+        }
+        if (cutoff_count == 0) {
+            cutoffs[cutoff_count++] = STRASSEN_DEFAULT_CUTOFF;
+        }
+    }
+
+    // The tiled kernel needs a multiple of the tile size, the padding stays zero.
+    int N = gemm_padded_size(size);
+    if (strassen) {
+        N = strassen_padded_size(size, cutoffs[cutoff_count - 1]);
+    }
+    size_t matrixSize = (size_t)N * N * sizeof(float);
+
+    float *A = (float*)calloc((size_t)N * N, sizeof(float));
+    float *B = (float*)calloc((size_t)N * N, sizeof(float));
+    float *C = (float*)malloc(matrixSize);
+    if (A == NULL || B == NULL || C == NULL) {
+        printf("[ERROR] Memory allocation failed\n");
         free(A);
         free(B);
         free(C);
-        return 0;
+        return 1;
     }
 
-    cl_mem d_C = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
-                                    sizeof(float) * MATRIX_SIZE, NULL, &err);
-    if (err != CL_SUCCESS) {
-        printf("[ERROR] Error creating buffer C. Error code: %d\n", err);
+    randomMatrix(A, size, N);
+    randomMatrix(B, size, N);
+
+    GemmContext ctx;
+    if (gemm_init(&ctx, "matrix.cl") != CL_SUCCESS) {
+        gemm_release(&ctx);
         free(A);
         free(B);
         free(C);
-        return 0;
+        return 1;
     }
 
-    clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_A);
-    clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_B);
-    clSetKernelArg(kernel, 2, sizeof(cl_mem), &d_C);
-    clSetKernelArg(kernel, 3, sizeof(int), &N);
+    printf("Matrix size: %d (padded to %d), fp16: %s, fp64: %s\n", size, N,
+           ctx.has_fp16 ? "native" : "storage only", ctx.has_fp64 ? "yes" : "no");
 
-    size_t local_size = 256;
-    size_t groups = (MATRIX_SIZE + local_size - 1) / local_size;
-    size_t global_size = groups * local_size;
-    cl_event event;
+    if (strassen) {
+        runStrassen(&ctx, A, B, C, N, cutoffs, cutoff_count, verify);
+    } else if (specialize) {
+        runSpecialize(&ctx, A, B, C, N, repeats);
+    } else if (packing) {
+        runPacking(&ctx, A, C, size, N, pack_count, verify);
+    } else if (matrix_ops) {
+        runOps(&ctx, A, B, C, size, N, verify);
+    } else if (transfer) {
+        runTransfer(&ctx, transfer_mb);
+    } else if (gemv) {
+        runGemv(&ctx, A, C, size, N, gemv_vectors, verify);
+    } else if (numa) {
+        failed = runNuma(&ctx, A, B, C, N, verify);
+    } else if (all) {
+        failed |= runPrecision(&ctx, GEMM_FP32, A, B, C, N, verify);
+        failed |= runPrecision(&ctx, GEMM_FP16, A, B, C, N, verify);
+        failed |= runPrecision(&ctx, GEMM_FP64, A, B, C, N, verify);
+    } else {
+        failed = runPrecision(&ctx, precision, A, B, C, N, verify);
+    }
 
-    err = clEnqueueNDRangeKernel(command_queue, kernel, 1, NULL, &global_size, &local_size, 0, NULL, &event);
-    clFinish(command_queue);
-    // clWaitForEvents(1, &event);
-    time_t start = clock();
-    printf("%d",start);
-    printf("Kernel execution finished\n");
-    cl_ulong ns;
-    printf("Event : %d\n", ns);
-    // err = clGetEventProfilingInfo(
-    //     event,
-    //     CL_PROFILING_COMMAND_QUEUED,
-    //     sizeof(ns),
-    //     &ns,
-    //     0
-    // );
-    // if (err == CL_PROFILING_INFO_NOT_AVAILABLE) {
-    //     printf("Profiling info not available!\n");
-    //     return 0;
-    // } else if (err != CL_SUCCESS) {
-    //     printf("Error code: %d\n", err);
-    //     return 0;
-    // }
-    printf("Queued : %lu\n", ns);
-    clGetEventProfilingInfo(
-        event,
-        CL_PROFILING_COMMAND_END,
-        sizeof(ns),
-        &ns,
-        NULL
-    );
-    printf("End : %lu\n", ns);
-
-    // Host buffer <- Device buffer
-    clEnqueueReadBuffer(
-        command_queue,
-        d_C,
-        CL_TRUE,
-        0,
-        MATRIX_SIZE * sizeof(int),
-        C,
-        0,
-        NULL,
-        NULL
-    );
-    // cl_event kernelEvent;
-
-    // err = clEnqueueNDRangeKernel(command_queue, kernel, 2, NULL, global_size, local_size, 0, NULL, &kernelEvent);
-    // checkError(err, "Kernel enqueue");
-
-    // // Eredmények visszaolvasása
-    // cl_event readEvent;
-    // err = clEnqueueReadBuffer(command_queue, d_C, CL_TRUE, 0, matrixSize, C, 1, &kernelEvent, &readEvent);
-    // checkError(err, "Buffer read");
-    // clWaitForEvents(1, &readEvent);
-
-    // double kernelTime = getEventTime(kernelEvent);
-    // double readTime = getEventTime(readEvent);
-
-    // printf("Kernel futási idő: %.3f ms\n", kernelTime);
-    // printf("Eredmény visszaolvasási idő: %.3f ms\n", readTime);
-    
-    err = clEnqueueReadBuffer(command_queue, d_C, CL_TRUE, 0, sizeof(float)*MATRIX_SIZE, C, 0, NULL, NULL);
-
-    printf("lefutott");
-
-    clReleaseMemObject(d_A);
-    clReleaseMemObject(d_B);
-    clReleaseMemObject(d_C);
-    clReleaseKernel(kernel);
-    clReleaseProgram(program);
-    clReleaseCommandQueue(command_queue);
-    clReleaseContext(context);
+    gemm_release(&ctx);
 
     free(A);
     free(B);
     free(C);
 
-    return 0;
-}
\ No newline at end of file
+    return failed;
+}
@@ -1,4 +1,15 @@
-#define TILE_SIZE 2
+#ifndef TILE_SIZE
+#define TILE_SIZE 16
+#endif
+
+// With -DMATRIX_N=<n> the dimension and the tile count are compile time
+// constants; otherwise they come from the N kernel argument.
+#ifdef MATRIX_N
+#define DIM MATRIX_N
+#else
+#define DIM N
+#endif
+#define TILE_COUNT (DIM / TILE_SIZE)
 
 __kernel void matrix(__global float* A, __global float* B, __global float* C, int N) {
     __local float Asub[TILE_SIZE][TILE_SIZE];
@@ -8,12 +19,95 @@ __kernel void matrix(__global float* A, __global float* B, __global float* C, in
     int col = get_global_id(1);
     int localRow = get_local_id(0);
     int localCol = get_local_id(1);
-    
+
+    float sum = 0.0f;
+
+    for (int i = 0; i < TILE_COUNT; i++) {
+        Asub[localRow][localCol] = A[row * DIM + (i * TILE_SIZE + localCol)];
+        Bsub[localRow][localCol] = B[(i * TILE_SIZE + localRow) * DIM + col];
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int k = 0; k < TILE_SIZE; k++) {
+            sum += Asub[localRow][k] * Bsub[k][localCol];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    C[row * DIM + col] = sum;
+}
+
+// fp16 storage, fp32 accumulation. vload_half/vstore_half do not require cl_khr_fp16.
+__kernel void matrix_half(__global const half* A, __global const half* B, __global half* C, int N) {
+    __local float Asub[TILE_SIZE][TILE_SIZE];
+    __local float Bsub[TILE_SIZE][TILE_SIZE];
+
+    int row = get_global_id(0);
+    int col = get_global_id(1);
+    int localRow = get_local_id(0);
+    int localCol = get_local_id(1);
+
+    float sum = 0.0f;
+
+    for (int i = 0; i < TILE_COUNT; i++) {
+        Asub[localRow][localCol] = vload_half(row * DIM + (i * TILE_SIZE + localCol), A);
+        Bsub[localRow][localCol] = vload_half((i * TILE_SIZE + localRow) * DIM + col, B);
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int k = 0; k < TILE_SIZE; k++) {
+            sum += Asub[localRow][k] * Bsub[k][localCol];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    vstore_half_rte(sum, row * DIM + col, C);
+}
+
+#ifdef cl_khr_fp64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+
+__kernel void matrix_double(__global const double* A, __global const double* B, __global double* C, int N) {
+    __local double Asub[TILE_SIZE][TILE_SIZE];
+    __local double Bsub[TILE_SIZE][TILE_SIZE];
+
+    int row = get_global_id(0);
+    int col = get_global_id(1);
+    int localRow = get_local_id(0);
+    int localCol = get_local_id(1);
+
+    double sum = 0.0;
+
+    for (int i = 0; i < TILE_COUNT; i++) {
+        Asub[localRow][localCol] = A[row * DIM + (i * TILE_SIZE + localCol)];
+        Bsub[localRow][localCol] = B[(i * TILE_SIZE + localRow) * DIM + col];
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int k = 0; k < TILE_SIZE; k++) {
+            sum += Asub[localRow][k] * Bsub[k][localCol];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    C[row * DIM + col] = sum;
+}
+#endif
+
+// Same tiling on sub-matrix views: every operand has its own offset and leading dimension.
+__kernel void matrix_view(__global const float* A, int offA, int lda,
+                          __global const float* B, int offB, int ldb,
+                          __global float* C, int offC, int ldc, int N) {
+    __local float Asub[TILE_SIZE][TILE_SIZE];
+    __local float Bsub[TILE_SIZE][TILE_SIZE];
+
+    int row = get_global_id(0);
+    int col = get_global_id(1);
+    int localRow = get_local_id(0);
+    int localCol = get_local_id(1);
+
     float sum = 0.0f;
 
     for (int i = 0; i < N / TILE_SIZE; i++) {
-        Asub[localRow][localCol] = A[row * N + (i * TILE_SIZE + localCol)];
-        Bsub[localRow][localCol] = B[(i * TILE_SIZE + localRow) * N + col];
+        Asub[localRow][localCol] = A[offA + row * lda + (i * TILE_SIZE + localCol)];
+        Bsub[localRow][localCol] = B[offB + (i * TILE_SIZE + localRow) * ldb + col];
         barrier(CLK_LOCAL_MEM_FENCE);
 
         for (int k = 0; k < TILE_SIZE; k++) {
@@ -22,5 +116,273 @@ __kernel void matrix(__global float* A, __global float* B, __global float* C, in
         barrier(CLK_LOCAL_MEM_FENCE);
     }
 
-    C[row * N + col] = sum;
+    C[offC + row * ldc + col] = sum;
+}
+
+// Z = X + beta * Y on sub-matrix views. Z may alias X or Y.
+__kernel void matrix_add_view(__global const float* X, int offX, int ldx,
+                              __global const float* Y, int offY, int ldy,
+                              __global float* Z, int offZ, int ldz, float beta) {
+    int row = get_global_id(0);
+    int col = get_global_id(1);
+
+    Z[offZ + row * ldz + col] = X[offX + row * ldx + col] + beta * Y[offY + row * ldy + col];
+}
+
+// Packed layouts: the matrix is padded to whole tiles and every tile is stored
+// contiguously, column-major inside the tile so that neighbouring work-items
+// (dimension 0 is the row) touch neighbouring floats.
+// Row panels (A, C): tile (r, c) is the (r * tile_cols + c)-th tile.
+// Column panels (B): tile (r, c) is the (c * tile_rows + r)-th tile, so the
+// k loop of a work-group walks through consecutive tiles of both operands.
+#define PACKED_INDEX(tile, localRow, localCol) \
+    ((size_t)(tile) * TILE_SIZE * TILE_SIZE + (localCol) * TILE_SIZE + (localRow))
+
+__kernel void pack_tiles(__global const float* src, int rows, int cols,
+                         __global float* dst, int tile_rows, int tile_cols, int column_panels) {
+    int row = get_global_id(0);
+    int col = get_global_id(1);
+    int tileRow = row / TILE_SIZE;
+    int tileCol = col / TILE_SIZE;
+    int tile = column_panels ? tileCol * tile_rows + tileRow : tileRow * tile_cols + tileCol;
+
+    dst[PACKED_INDEX(tile, row % TILE_SIZE, col % TILE_SIZE)] =
+        (row < rows && col < cols) ? src[row * cols + col] : 0.0f;
+}
+
+__kernel void unpack_tiles(__global const float* src, int tile_cols,
+                           __global float* dst, int rows, int cols) {
+    int row = get_global_id(0);
+    int col = get_global_id(1);
+
+    if (row < rows && col < cols) {
+        int tile = (row / TILE_SIZE) * tile_cols + col / TILE_SIZE;
+        dst[row * cols + col] = src[PACKED_INDEX(tile, row % TILE_SIZE, col % TILE_SIZE)];
+    }
+}
+
+// C = A * B on packed operands: A and C in row panels, B in column panels,
+// all of them tiles x tiles tiles.
+__kernel void matrix_packed(__global const float* A, __global const float* B, __global float* C, int tiles) {
+    __local float Asub[TILE_SIZE][TILE_SIZE];
+    __local float Bsub[TILE_SIZE][TILE_SIZE];
+
+    int tileRow = get_group_id(0);
+    int tileCol = get_group_id(1);
+    int localRow = get_local_id(0);
+    int localCol = get_local_id(1);
+    int aTile = tileRow * tiles;
+    int bTile = tileCol * tiles;
+
+    float sum = 0.0f;
+
+    for (int i = 0; i < tiles; i++) {
+        Asub[localRow][localCol] = A[PACKED_INDEX(aTile + i, localRow, localCol)];
+        Bsub[localRow][localCol] = B[PACKED_INDEX(bTile + i, localRow, localCol)];
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int k = 0; k < TILE_SIZE; k++) {
+            sum += Asub[localRow][k] * Bsub[k][localCol];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    C[PACKED_INDEX(tileRow * tiles + tileCol, localRow, localCol)] = sum;
+}
+
+// Out-of-place transpose, dst (cols x rows) = src (rows x cols)^T. The tile goes
+// through local memory so that both the reads and the writes are row-contiguous;
+// the extra column shifts every tile row to a different bank.
+__kernel void transpose(__global const float* src, int offS, int lds,
+                        __global float* dst, int offD, int ldd, int rows, int cols) {
+    __local float tile[TILE_SIZE][TILE_SIZE + 1];
+
+    int localRow = get_local_id(0);
+    int localCol = get_local_id(1);
+    int baseRow = get_group_id(0) * TILE_SIZE;
+    int baseCol = get_group_id(1) * TILE_SIZE;
+
+    // Dimension 0 walks along the row here, see the index swap below.
+    int row = baseRow + localCol;
+    int col = baseCol + localRow;
+    if (row < rows && col < cols) {
+        tile[localCol][localRow] = src[offS + row * lds + col];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    int outRow = baseCol + localCol;
+    int outCol = baseRow + localRow;
+    if (outRow < cols && outCol < rows) {
+        dst[offD + outRow * ldd + outCol] = tile[localRow][localCol];
+    }
+}
+
+// In-place transpose of a square n x n matrix. Work-group (i, j) with i < j swaps
+// tiles (i, j) and (j, i), the groups on the diagonal transpose their own tile,
+// the ones below the diagonal have nothing to do.
+__kernel void transpose_inplace(__global float* M, int off, int ld, int n) {
+    __local float upper[TILE_SIZE][TILE_SIZE + 1];
+    __local float lower[TILE_SIZE][TILE_SIZE + 1];
+
+    int tileRow = get_group_id(0);
+    int tileCol = get_group_id(1);
+    if (tileRow > tileCol) {
+        return;
+    }
+
+    int localRow = get_local_id(0);
+    int localCol = get_local_id(1);
+    int upperRow = tileRow * TILE_SIZE + localCol;
+    int upperCol = tileCol * TILE_SIZE + localRow;
+    int lowerRow = tileCol * TILE_SIZE + localCol;
+    int lowerCol = tileRow * TILE_SIZE + localRow;
+
+    if (upperRow < n && upperCol < n) {
+        upper[localCol][localRow] = M[off + upperRow * ld + upperCol];
+    }
+    if (tileRow != tileCol && lowerRow < n && lowerCol < n) {
+        lower[localCol][localRow] = M[off + lowerRow * ld + lowerCol];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Element (r, c) of the upper tile goes to (c, r) of the lower tile and back.
+    if (lowerRow < n && lowerCol < n) {
+        M[off + lowerRow * ld + lowerCol] = upper[localRow][localCol];
+    }
+    if (tileRow != tileCol && upperRow < n && upperCol < n) {
+        M[off + upperRow * ld + upperCol] = lower[localRow][localCol];
+    }
+}
+
+// Z = alpha * X + beta * Y on rows x cols views with their own leading dimensions.
+// Dimension 0 is the column here, so neighbouring work-items access neighbouring floats.
+__kernel void matrix_axpby(float alpha, __global const float* X, int offX, int ldx,
+                           float beta, __global const float* Y, int offY, int ldy,
+                           __global float* Z, int offZ, int ldz, int rows, int cols) {
+    int col = get_global_id(0);
+    int row = get_global_id(1);
+
+    if (row < rows && col < cols) {
+        float value = alpha * X[offX + row * ldx + col];
+        if (beta != 0.0f) {
+            value += beta * Y[offY + row * ldy + col];
+        }
+        Z[offZ + row * ldz + col] = value;
+    }
+}
+
+// GEMV: Y = alpha * A * X + beta * Y, where X holds count vectors (cols x count,
+// row-major) and Y is rows x count. A work-group takes GEMV_ROWS rows, its
+// GEMV_LANES work-items per row walk the row in coalesced chunks. A chunk of X is
+// loaded into local memory once for all rows of the group, and every element of A
+// is used for all count vectors before the next one is loaded.
+// The sizes have to match gemv.h.
+#define GEMV_LANES 64
+#define GEMV_ROWS 4
+#define GEMV_MAX_VECTORS 8
+
+__kernel void gemv(__global const float* A, int offA, int lda,
+                   __global const float* X, int offX, int ldx,
+                   __global float* Y, int offY, int ldy,
+                   int rows, int cols, int count, float alpha, float beta) {
+    __local float xs[GEMV_LANES * GEMV_MAX_VECTORS];
+    __local float partial[GEMV_ROWS][GEMV_LANES];
+
+    int lane = get_local_id(0);
+    int localRow = get_local_id(1);
+    int row = get_global_id(1);
+    float sum[GEMV_MAX_VECTORS];
+    for (int v = 0; v < GEMV_MAX_VECTORS; v++) {
+        sum[v] = 0.0f;
+    }
+
+    for (int base = 0; base < cols; base += GEMV_LANES) {
+        for (int i = localRow * GEMV_LANES + lane; i < GEMV_LANES * count; i += GEMV_LANES * GEMV_ROWS) {
+            int col = base + i / count;
+            xs[i] = col < cols ? X[offX + col * ldx + i % count] : 0.0f;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        int col = base + lane;
+        if (row < rows && col < cols) {
+            float a = A[offA + row * lda + col];
+            for (int v = 0; v < GEMV_MAX_VECTORS; v++) {
+                if (v < count) {
+                    sum[v] += a * xs[lane * count + v];
+                }
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for (int v = 0; v < GEMV_MAX_VECTORS; v++) {
+        if (v < count) {
+            partial[localRow][lane] = sum[v];
+            barrier(CLK_LOCAL_MEM_FENCE);
+            // Tree sum of the lanes of the row, lane 0 stores the result.
+            for (int s = GEMV_LANES / 2; s > 0; s >>= 1) {
+                if (lane < s) {
+                    partial[localRow][lane] += partial[localRow][lane + s];
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+            }
+            if (lane == 0 && row < rows) {
+                float value = alpha * partial[localRow][0];
+                if (beta != 0.0f) {
+                    value += beta * Y[offY + row * ldy + v];
+                }
+                Y[offY + row * ldy + v] = value;
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+    }
+}
+
+// Transposed GEMV: Y = alpha * A^T * X + beta * Y, X is rows x count and Y is
+// cols x count. Dimension 0 is the column, so neighbouring work-items read
+// neighbouring floats of a row of A. The GEMV_ROWS work-items of a column take
+// every GEMV_ROWS-th row, their partial sums are added in local memory.
+__kernel void gemv_t(__global const float* A, int offA, int lda,
+                     __global const float* X, int offX, int ldx,
+                     __global float* Y, int offY, int ldy,
+                     int rows, int cols, int count, float alpha, float beta) {
+    __local float partial[GEMV_ROWS][GEMV_LANES];
+
+    int lane = get_local_id(0);
+    int slice = get_local_id(1);
+    int col = get_global_id(0);
+    float sum[GEMV_MAX_VECTORS];
+    for (int v = 0; v < GEMV_MAX_VECTORS; v++) {
+        sum[v] = 0.0f;
+    }
+
+    if (col < cols) {
+        for (int row = slice; row < rows; row += GEMV_ROWS) {
+            float a = A[offA + row * lda + col];
+            for (int v = 0; v < GEMV_MAX_VECTORS; v++) {
+                if (v < count) {
+                    sum[v] += a * X[offX + row * ldx + v];
+                }
+            }
+        }
+    }
+
+    for (int v = 0; v < GEMV_MAX_VECTORS; v++) {
+        if (v < count) {
+            partial[slice][lane] = sum[v];
+            barrier(CLK_LOCAL_MEM_FENCE);
+            if (slice == 0 && col < cols) {
+                float total = 0.0f;
+                for (int s = 0; s < GEMV_ROWS; s++) {
+                    total += partial[s][lane];
+                }
+                float value = alpha * total;
+                if (beta != 0.0f) {
+                    value += beta * Y[offY + col * ldy + v];
+                }
+                Y[offY + col * ldy + v] = value;
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+    }
 }
@@ -0,0 +1,126 @@
+#include "matrix_ops.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static size_t round_up(int n)
+{
+    return (size_t)(n + GEMM_TILE_SIZE - 1) / GEMM_TILE_SIZE * GEMM_TILE_SIZE;
+}
+
+cl_int matrix_ops_init(MatrixOps* ops, GemmContext* gemm)
+{
+    cl_int err;
+
+    memset(ops, 0, sizeof(MatrixOps));
+    ops->gemm = gemm;
+
+    ops->kernel_transpose = clCreateKernel(gemm->program, "transpose", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating the transpose kernel. Error code: %d\n", err);
+        return err;
+    }
+    ops->kernel_transpose_inplace = clCreateKernel(gemm->program, "transpose_inplace", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating the transpose_inplace kernel. Error code: %d\n", err);
+        return err;
+    }
+    ops->kernel_axpby = clCreateKernel(gemm->program, "matrix_axpby", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating the matrix_axpby kernel. Error code: %d\n", err);
+    }
+    return err;
+}
+
+void matrix_ops_release(MatrixOps* ops)
+{
+    if (ops->kernel_transpose != NULL) {
+        clReleaseKernel(ops->kernel_transpose);
+    }
+    if (ops->kernel_transpose_inplace != NULL) {
+        clReleaseKernel(ops->kernel_transpose_inplace);
+    }
+    if (ops->kernel_axpby != NULL) {
+        clReleaseKernel(ops->kernel_axpby);
+    }
+    memset(ops, 0, sizeof(MatrixOps));
+}
+
+cl_int matrix_transpose(MatrixOps* ops, MatrixView src, MatrixView dst, int rows, int cols, cl_event* event)
+{
+    cl_kernel kernel = ops->kernel_transpose;
+    cl_int err;
+
+    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &src.mem);
+    err |= clSetKernelArg(kernel, 1, sizeof(int), &src.offset);
+    err |= clSetKernelArg(kernel, 2, sizeof(int), &src.ld);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &dst.mem);
+    err |= clSetKernelArg(kernel, 4, sizeof(int), &dst.offset);
+    err |= clSetKernelArg(kernel, 5, sizeof(int), &dst.ld);
+    err |= clSetKernelArg(kernel, 6, sizeof(int), &rows);
+    err |= clSetKernelArg(kernel, 7, sizeof(int), &cols);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    size_t global_size[2] = {round_up(rows), round_up(cols)};
+    size_t local_size[2] = {GEMM_TILE_SIZE, GEMM_TILE_SIZE};
+    return clEnqueueNDRangeKernel(ops->gemm->command_queue, kernel, 2, NULL, global_size, local_size, 0, NULL, event);
+}
+
+cl_int matrix_transpose_inplace(MatrixOps* ops, MatrixView M, int n, cl_event* event)
+{
+    cl_kernel kernel = ops->kernel_transpose_inplace;
+    cl_int err;
+
+    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &M.mem);
+    err |= clSetKernelArg(kernel, 1, sizeof(int), &M.offset);
+    err |= clSetKernelArg(kernel, 2, sizeof(int), &M.ld);
+    err |= clSetKernelArg(kernel, 3, sizeof(int), &n);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    size_t global_size[2] = {round_up(n), round_up(n)};
+    size_t local_size[2] = {GEMM_TILE_SIZE, GEMM_TILE_SIZE};
+    return clEnqueueNDRangeKernel(ops->gemm->command_queue, kernel, 2, NULL, global_size, local_size, 0, NULL, event);
+}
+
+cl_int matrix_axpby(MatrixOps* ops, float alpha, MatrixView X, float beta, MatrixView Y,
+                    MatrixView Z, int rows, int cols, cl_event* event)
+{
+    cl_kernel kernel = ops->kernel_axpby;
+    cl_int err;
+
+    err = clSetKernelArg(kernel, 0, sizeof(float), &alpha);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &X.mem);
+    err |= clSetKernelArg(kernel, 2, sizeof(int), &X.offset);
+    err |= clSetKernelArg(kernel, 3, sizeof(int), &X.ld);
+    err |= clSetKernelArg(kernel, 4, sizeof(float), &beta);
+    err |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &Y.mem);
+    err |= clSetKernelArg(kernel, 6, sizeof(int), &Y.offset);
+    err |= clSetKernelArg(kernel, 7, sizeof(int), &Y.ld);
+    err |= clSetKernelArg(kernel, 8, sizeof(cl_mem), &Z.mem);
+    err |= clSetKernelArg(kernel, 9, sizeof(int), &Z.offset);
+    err |= clSetKernelArg(kernel, 10, sizeof(int), &Z.ld);
+    err |= clSetKernelArg(kernel, 11, sizeof(int), &rows);
+    err |= clSetKernelArg(kernel, 12, sizeof(int), &cols);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    // Dimension 0 is the column in matrix_axpby.
+    size_t global_size[2] = {round_up(cols), round_up(rows)};
+    size_t local_size[2] = {GEMM_TILE_SIZE, GEMM_TILE_SIZE};
+    return clEnqueueNDRangeKernel(ops->gemm->command_queue, kernel, 2, NULL, global_size, local_size, 0, NULL, event);
+}
+
+cl_int matrix_add(MatrixOps* ops, MatrixView X, MatrixView Y, MatrixView Z, int rows, int cols, cl_event* event)
+{
+    return matrix_axpby(ops, 1.0f, X, 1.0f, Y, Z, rows, cols, event);
+}
+
+cl_int matrix_scale(MatrixOps* ops, float alpha, MatrixView X, MatrixView Z, int rows, int cols, cl_event* event)
+{
+    return matrix_axpby(ops, alpha, X, 0.0f, X, Z, rows, cols, event);
+}
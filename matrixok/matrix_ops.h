@@ -0,0 +1,51 @@
+#ifndef MATRIX_OPS_H
+#define MATRIX_OPS_H
+
+#include "gemm.h"
+
+/**
+ * Transposes and elementwise operations on device matrices, so that they
+ * do not have to round-trip through the host.
+ */
+typedef struct {
+    GemmContext* gemm;
+    cl_kernel kernel_transpose;
+    cl_kernel kernel_transpose_inplace;
+    cl_kernel kernel_axpby;
+} MatrixOps;
+
+cl_int matrix_ops_init(MatrixOps* ops, GemmContext* gemm);
+
+void matrix_ops_release(MatrixOps* ops);
+
+/**
+ * dst (cols x rows) = src (rows x cols)^T, through padded local memory tiles.
+ * src and dst must not overlap.
+ *
+ * event: Event of the kernel, released by the caller (may be NULL)
+ */
+cl_int matrix_transpose(MatrixOps* ops, MatrixView src, MatrixView dst, int rows, int cols, cl_event* event);
+
+/**
+ * M = M^T for a square n x n view.
+ */
+cl_int matrix_transpose_inplace(MatrixOps* ops, MatrixView M, int n, cl_event* event);
+
+/**
+ * Z = alpha * X + beta * Y on rows x cols views. Y is not read when beta is 0.
+ * Z may alias X or Y.
+ */
+cl_int matrix_axpby(MatrixOps* ops, float alpha, MatrixView X, float beta, MatrixView Y,
+                    MatrixView Z, int rows, int cols, cl_event* event);
+
+/**
+ * Z = X + Y
+ */
+cl_int matrix_add(MatrixOps* ops, MatrixView X, MatrixView Y, MatrixView Z, int rows, int cols, cl_event* event);
+
+/**
+ * Z = alpha * X
+ */
+cl_int matrix_scale(MatrixOps* ops, float alpha, MatrixView X, MatrixView Z, int rows, int cols, cl_event* event);
+
+#endif
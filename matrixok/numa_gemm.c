@@ -0,0 +1,242 @@
+#include "numa_gemm.h"
+#include "gemm.h"
+#include "kernel_loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    NumaGemmNode* node;
+    const float* A;
+    const float* B;
+    int N;
+} FirstTouch;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// Runs on a thread of the node, so the pages land in its memory.
+static void first_touch(int node_index, void* arg)
+{
+    FirstTouch* touch = (FirstTouch*)arg;
+    NumaGemmNode* node = touch->node;
+    size_t band = (size_t)node->rows * touch->N;
+    (void)node_index;
+
+    memcpy(node->A, touch->A + (size_t)node->row_start * touch->N, sizeof(float) * band);
+    memcpy(node->B, touch->B, sizeof(float) * touch->N * touch->N);
+    memset(node->C, 0, sizeof(float) * band);
+}
+
+static size_t band_bytes(const NumaGemm* gemm, const NumaGemmNode* node)
+{
+    return sizeof(float) * (size_t)node->rows * gemm->N;
+}
+
+static cl_int create_nodes(NumaGemm* gemm, const float* A, const float* B)
+{
+    int N = gemm->N;
+    size_t matrix_bytes = sizeof(float) * (size_t)N * N;
+    FirstTouch touches[NUMA_MAX_NODES];
+    void* args[NUMA_MAX_NODES];
+
+    // Equal bands of whole tiles, the last node takes the rest.
+    int tiles = N / GEMM_TILE_SIZE;
+    int band_tiles = (tiles + gemm->node_count - 1) / gemm->node_count;
+    for (int i = 0; i < gemm->node_count; i++) {
+        NumaGemmNode* node = &gemm->nodes[i];
+        int first = i * band_tiles < tiles ? i * band_tiles : tiles;
+        int last = (i + 1) * band_tiles < tiles ? (i + 1) * band_tiles : tiles;
+        node->row_start = first * GEMM_TILE_SIZE;
+        node->rows = (last - first) * GEMM_TILE_SIZE;
+        if (node->rows == 0) {
+            gemm->node_count = i;
+            break;
+        }
+        node->A = (float*)numa_alloc(band_bytes(gemm, node));
+        node->B = (float*)numa_alloc(matrix_bytes);
+        node->C = (float*)numa_alloc(band_bytes(gemm, node));
+        if (node->A == NULL || node->B == NULL || node->C == NULL) {
+            printf("[ERROR] Memory allocation failed\n");
+            return CL_OUT_OF_HOST_MEMORY;
+        }
+        touches[i].node = node;
+        touches[i].A = A;
+        touches[i].B = B;
+        touches[i].N = N;
+        args[i] = &touches[i];
+    }
+    if (numa_run_on_nodes(&gemm->topology, gemm->node_count, first_touch, args) != 0) {
+        printf("[ERROR] Could not start the first touch threads\n");
+        return CL_OUT_OF_RESOURCES;
+    }
+    return CL_SUCCESS;
+}
+
+static cl_int build_program(NumaGemm* gemm, const char* path)
+{
+    int error_code;
+    cl_int err;
+    char options[64];
+
+    char* kernel_code = load_kernel_source(path, &error_code);
+    if (error_code != 0) {
+        printf("Source code loading error!\n");
+        return CL_INVALID_VALUE;
+    }
+    gemm->program = clCreateProgramWithSource(gemm->context, 1, (const char**)&kernel_code, NULL, &err);
+    free(kernel_code);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error calling clCreateProgramWithSource. Error code: %d\n", err);
+        return err;
+    }
+    snprintf(options, sizeof(options), "-DTILE_SIZE=%d", GEMM_TILE_SIZE);
+    err = clBuildProgram(gemm->program, gemm->node_count, gemm->sub_devices, options, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error building matrix.cl for the NUMA sub-devices. Error code: %d\n", err);
+    }
+    return err;
+}
+
+cl_int numa_gemm_init(NumaGemm* gemm, cl_device_id device_id, const char* path, const float* A, const float* B, int N)
+{
+    cl_int err;
+
+    memset(gemm, 0, sizeof(NumaGemm));
+    gemm->N = N;
+    numa_detect(&gemm->topology);
+    numa_print(&gemm->topology);
+    if (N % GEMM_TILE_SIZE != 0) {
+        return CL_INVALID_VALUE;
+    }
+
+    err = numa_create_sub_devices(device_id, gemm->sub_devices, NUMA_MAX_NODES, &gemm->sub_device_count);
+    if (err != CL_SUCCESS || gemm->sub_device_count < 2) {
+        printf("The device cannot be partitioned by NUMA node (error code: %d, sub-devices: %u)\n",
+               err, gemm->sub_device_count);
+        return CL_DEVICE_PARTITION_FAILED;
+    }
+    gemm->node_count = (int)gemm->sub_device_count < gemm->topology.node_count
+                     ? (int)gemm->sub_device_count : gemm->topology.node_count;
+
+    err = create_nodes(gemm, A, B);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    gemm->context = clCreateContext(NULL, gemm->node_count, gemm->sub_devices, NULL, NULL, &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error calling clCreateContext. Error code: %d\n", err);
+        return err;
+    }
+    err = build_program(gemm, path);
+
+    int zero = 0;
+    for (int i = 0; i < gemm->node_count && err == CL_SUCCESS; i++) {
+        NumaGemmNode* node = &gemm->nodes[i];
+        node->queue = clCreateCommandQueue(gemm->context, gemm->sub_devices[i], CL_QUEUE_PROFILING_ENABLE, &err);
+        if (err == CL_SUCCESS) {
+            node->kernel = clCreateKernel(gemm->program, "matrix_view", &err);
+        }
+        // The host memory is used in place, so the buffers stay on the node.
+        float* hosts[3] = {node->A, node->B, node->C};
+        size_t sizes[3] = {band_bytes(gemm, node), sizeof(float) * (size_t)N * N, band_bytes(gemm, node)};
+        for (int b = 0; b < 3 && err == CL_SUCCESS; b++) {
+            node->buffers[b] = clCreateBuffer(gemm->context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, sizes[b], hosts[b], &err);
+        }
+        if (err == CL_SUCCESS) {
+            err = clSetKernelArg(node->kernel, 0, sizeof(cl_mem), &node->buffers[0]);
+            err |= clSetKernelArg(node->kernel, 1, sizeof(int), &zero);
+            err |= clSetKernelArg(node->kernel, 2, sizeof(int), &N);
+            err |= clSetKernelArg(node->kernel, 3, sizeof(cl_mem), &node->buffers[1]);
+            err |= clSetKernelArg(node->kernel, 4, sizeof(int), &zero);
+            err |= clSetKernelArg(node->kernel, 5, sizeof(int), &N);
+            err |= clSetKernelArg(node->kernel, 6, sizeof(cl_mem), &node->buffers[2]);
+            err |= clSetKernelArg(node->kernel, 7, sizeof(int), &zero);
+            err |= clSetKernelArg(node->kernel, 8, sizeof(int), &N);
+            err |= clSetKernelArg(node->kernel, 9, sizeof(int), &N);
+        }
+        if (err != CL_SUCCESS) {
+            printf("[ERROR] Error setting up NUMA node %d. Error code: %d\n", gemm->topology.node_ids[i], err);
+        }
+    }
+    return err;
+}
+
+cl_int numa_gemm_run(NumaGemm* gemm, int node_count, double* wall_ms, double* kernel_ms)
+{
+    cl_event events[NUMA_MAX_NODES];
+    cl_int err = CL_SUCCESS;
+    int started = 0;
+
+    if (node_count > gemm->node_count) {
+        node_count = gemm->node_count;
+    }
+    double start = now_ms();
+    for (int i = 0; i < node_count && err == CL_SUCCESS; i++) {
+        NumaGemmNode* node = &gemm->nodes[i];
+        size_t global_size[2] = {(size_t)node->rows, (size_t)gemm->N};
+        size_t local_size[2] = {GEMM_TILE_SIZE, GEMM_TILE_SIZE};
+        err = clEnqueueNDRangeKernel(node->queue, node->kernel, 2, NULL, global_size, local_size, 0, NULL, &events[i]);
+        if (err == CL_SUCCESS) {
+            clFlush(node->queue);
+            started++;
+        }
+    }
+    if (started > 0) {
+        clWaitForEvents(started, events);
+    }
+    *wall_ms = now_ms() - start;
+    for (int i = 0; i < started; i++) {
+        if (kernel_ms != NULL) {
+            kernel_ms[i] = getEventTime(events[i]);
+        }
+        clReleaseEvent(events[i]);
+    }
+    return err;
+}
+
+cl_int numa_gemm_gather(NumaGemm* gemm, float* C)
+{
+    cl_int err = CL_SUCCESS;
+    for (int i = 0; i < gemm->node_count && err == CL_SUCCESS; i++) {
+        NumaGemmNode* node = &gemm->nodes[i];
+        // Mapping makes the results of the device visible in the host memory.
+        float* band = (float*)clEnqueueMapBuffer(node->queue, node->buffers[2], CL_TRUE, CL_MAP_READ, 0,
+                                                 band_bytes(gemm, node), 0, NULL, NULL, &err);
+        if (err == CL_SUCCESS) {
+            memcpy(C + (size_t)node->row_start * gemm->N, band, band_bytes(gemm, node));
+            clEnqueueUnmapMemObject(node->queue, node->buffers[2], band, 0, NULL, NULL);
+            clFinish(node->queue);
+        }
+    }
+    return err;
+}
+
+void numa_gemm_release(NumaGemm* gemm)
+{
+    size_t matrix_bytes = sizeof(float) * (size_t)gemm->N * gemm->N;
+    for (int i = 0; i < NUMA_MAX_NODES; i++) {
+        NumaGemmNode* node = &gemm->nodes[i];
+        for (int b = 0; b < 3; b++) {
+            if (node->buffers[b] != NULL) clReleaseMemObject(node->buffers[b]);
+        }
+        if (node->kernel != NULL) clReleaseKernel(node->kernel);
+        if (node->queue != NULL) clReleaseCommandQueue(node->queue);
+        numa_free(node->A, band_bytes(gemm, node));
+        numa_free(node->B, matrix_bytes);
+        numa_free(node->C, band_bytes(gemm, node));
+    }
+    if (gemm->program != NULL) clReleaseProgram(gemm->program);
+    if (gemm->context != NULL) clReleaseContext(gemm->context);
+    for (cl_uint i = 0; i < gemm->sub_device_count; i++) {
+        clReleaseDevice(gemm->sub_devices[i]);
+    }
+    memset(gemm, 0, sizeof(NumaGemm));
+}
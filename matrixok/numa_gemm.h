@@ -0,0 +1,70 @@
+#ifndef NUMA_GEMM_H
+#define NUMA_GEMM_H
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+#include "numa_topology.h"
+
+/**
+ * The part of a NUMA GEMM computed by one node: rows
+ * [row_start, row_start + rows) of C. The band of A and C and a full
+ * replica of B are allocated untouched and first written by a thread
+ * pinned to the node, so the work-items of the node's sub-device only
+ * read and write node local memory.
+ */
+typedef struct {
+    int row_start;
+    int rows;
+    float* A;
+    float* B;
+    float* C;
+    cl_command_queue queue;
+    cl_kernel kernel;
+    cl_mem buffers[3];
+} NumaGemmNode;
+
+/**
+ * GEMM on a CPU device split into one sub-device per NUMA node
+ * (CL_DEVICE_AFFINITY_DOMAIN_NUMA). B is replicated on every node, since
+ * every row band reads all of it.
+ */
+typedef struct {
+    NumaTopology topology;
+    cl_device_id sub_devices[NUMA_MAX_NODES];
+    cl_uint sub_device_count;
+    int node_count;
+    int N;
+    cl_context context;
+    cl_program program;
+    NumaGemmNode nodes[NUMA_MAX_NODES];
+} NumaGemm;
+
+/**
+ * Partition the device, place A, B (N x N, row-major) on the nodes and
+ * build matrix.cl for the sub-devices.
+ *
+ * path: Path of the matrix.cl source file
+ * N: Matrix size, a multiple of GEMM_TILE_SIZE
+ *
+ * Returns CL_SUCCESS, CL_DEVICE_PARTITION_FAILED when the device has
+ * fewer than two NUMA sub-devices, or the OpenCL error code of the failing call
+ */
+cl_int numa_gemm_init(NumaGemm* gemm, cl_device_id device_id, const char* path, const float* A, const float* B, int N);
+
+/**
+ * Compute the row bands of the first node_count nodes at once.
+ *
+ * wall_ms: Time until every node finished
+ * kernel_ms: Kernel time of every node (may be NULL)
+ */
+cl_int numa_gemm_run(NumaGemm* gemm, int node_count, double* wall_ms, double* kernel_ms);
+
+/**
+ * Copy the row bands of C into C (N x N).
+ */
+cl_int numa_gemm_gather(NumaGemm* gemm, float* C);
+
+void numa_gemm_release(NumaGemm* gemm);
+
+#endif
@@ -0,0 +1,292 @@
+#include "packing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static int tile_count(int n)
+{
+    return (n + GEMM_TILE_SIZE - 1) / GEMM_TILE_SIZE;
+}
+
+static size_t packed_bytes(int rows, int cols)
+{
+    return sizeof(float) * (size_t)tile_count(rows) * tile_count(cols) * GEMM_TILE_SIZE * GEMM_TILE_SIZE;
+}
+
+cl_int pack_cache_init(PackCache* cache, GemmContext* gemm, int capacity)
+{
+    cl_int err;
+
+    memset(cache, 0, sizeof(PackCache));
+    cache->gemm = gemm;
+    cache->capacity = capacity > 0 ? capacity : PACK_CACHE_DEFAULT_CAPACITY;
+    if (cache->capacity < 2) {
+        cache->capacity = 2;
+    }
+    cache->protect_from = (unsigned long)-1;
+    cache->entries = (PackedOperand*)calloc(cache->capacity, sizeof(PackedOperand));
+    if (cache->entries == NULL) {
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+
+    cache->kernel_pack = clCreateKernel(gemm->program, "pack_tiles", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating the pack_tiles kernel. Error code: %d\n", err);
+        return err;
+    }
+    cache->kernel_unpack = clCreateKernel(gemm->program, "unpack_tiles", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating the unpack_tiles kernel. Error code: %d\n", err);
+        return err;
+    }
+    cache->kernel_gemm = clCreateKernel(gemm->program, "matrix_packed", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating the matrix_packed kernel. Error code: %d\n", err);
+    }
+    return err;
+}
+
+static void drop_entry(PackCache* cache, PackedOperand* entry)
+{
+    pool_release(&cache->gemm->pool, entry->packed);
+    *entry = cache->entries[--cache->count];
+}
+
+static cl_int pack(PackCache* cache, PackedOperand* entry)
+{
+    GemmContext* ctx = cache->gemm;
+    cl_kernel kernel = cache->kernel_pack;
+    size_t bytes = sizeof(float) * (size_t)entry->rows * entry->cols;
+    int tile_rows = tile_count(entry->rows);
+    int tile_cols = tile_count(entry->cols);
+    int column_panels = entry->layout == PACK_COLUMN_PANELS;
+    cl_int err;
+
+    cl_mem staging = pool_acquire(&ctx->pool, bytes, &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating the staging buffer. Error code: %d\n", err);
+        return err;
+    }
+    entry->packed = pool_acquire(&ctx->pool, packed_bytes(entry->rows, entry->cols), &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating the packed buffer. Error code: %d\n", err);
+        pool_release(&ctx->pool, staging);
+        return err;
+    }
+
+    err = clEnqueueWriteBuffer(ctx->command_queue, staging, CL_FALSE, 0, bytes, entry->host, 0, NULL, NULL);
+    err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &staging);
+    err |= clSetKernelArg(kernel, 1, sizeof(int), &entry->rows);
+    err |= clSetKernelArg(kernel, 2, sizeof(int), &entry->cols);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &entry->packed);
+    err |= clSetKernelArg(kernel, 4, sizeof(int), &tile_rows);
+    err |= clSetKernelArg(kernel, 5, sizeof(int), &tile_cols);
+    err |= clSetKernelArg(kernel, 6, sizeof(int), &column_panels);
+
+    size_t global_size[2] = {(size_t)tile_rows * GEMM_TILE_SIZE, (size_t)tile_cols * GEMM_TILE_SIZE};
+    size_t local_size[2] = {GEMM_TILE_SIZE, GEMM_TILE_SIZE};
+    if (err == CL_SUCCESS) {
+        err = clEnqueueNDRangeKernel(ctx->command_queue, kernel, 2, NULL, global_size, local_size, 0, NULL, NULL);
+    }
+    clFinish(ctx->command_queue);
+    pool_release(&ctx->pool, staging);
+
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error packing a matrix. Error code: %d\n", err);
+        pool_release(&ctx->pool, entry->packed);
+    }
+    return err;
+}
+
+cl_mem pack_operand(PackCache* cache, const float* host, unsigned long version,
+                    int rows, int cols, PackLayout layout, cl_int* err)
+{
+    cache->clock++;
+
+    for (int i = 0; i < cache->count; i++) {
+        PackedOperand* entry = &cache->entries[i];
+        if (entry->host != host || entry->layout != layout) {
+            continue;
+        }
+        if (entry->version == version && entry->rows == rows && entry->cols == cols) {
+            entry->last_use = cache->clock;
+            cache->hits++;
+            *err = CL_SUCCESS;
+            return entry->packed;
+        }
+        // Stale contents of the same host matrix.
+        drop_entry(cache, entry);
+        break;
+    }
+
+    if (cache->count == cache->capacity) {
+        PackedOperand* oldest = NULL;
+        for (int i = 0; i < cache->count; i++) {
+            PackedOperand* candidate = &cache->entries[i];
+            if (candidate->last_use < cache->protect_from
+                && (oldest == NULL || candidate->last_use < oldest->last_use)) {
+                oldest = candidate;
+            }
+        }
+        if (oldest == NULL) {
+            *err = CL_OUT_OF_RESOURCES;
+            return NULL;
+        }
+        drop_entry(cache, oldest);
+        cache->evictions++;
+    }
+
+    PackedOperand* entry = &cache->entries[cache->count];
+    entry->host = host;
+    entry->version = version;
+    entry->rows = rows;
+    entry->cols = cols;
+    entry->layout = layout;
+    entry->last_use = cache->clock;
+
+    double start = now_ms();
+    *err = pack(cache, entry);
+    if (*err != CL_SUCCESS) {
+        return NULL;
+    }
+    cache->pack_ms += now_ms() - start;
+    cache->packs++;
+    cache->count++;
+    return entry->packed;
+}
+
+void pack_cache_invalidate(PackCache* cache, const float* host)
+{
+    for (int i = cache->count - 1; i >= 0; i--) {
+        if (cache->entries[i].host == host) {
+            drop_entry(cache, &cache->entries[i]);
+        }
+    }
+}
+
+cl_int packed_gemm(PackCache* cache, const float* A, unsigned long a_version,
+                   const float* B, unsigned long b_version, int N, PackedResult* C, double* kernel_ms)
+{
+    GemmContext* ctx = cache->gemm;
+    cl_kernel kernel = cache->kernel_gemm;
+    int tiles = tile_count(N);
+    cl_int err;
+
+    C->packed = NULL;
+    C->rows = N;
+    C->cols = N;
+
+    // Packing B must not evict A.
+    cache->protect_from = cache->clock + 1;
+    cl_mem a = pack_operand(cache, A, a_version, N, N, PACK_ROW_PANELS, &err);
+    cl_mem b = a == NULL ? NULL : pack_operand(cache, B, b_version, N, N, PACK_COLUMN_PANELS, &err);
+    cache->protect_from = (unsigned long)-1;
+    if (a == NULL || b == NULL) {
+        return err;
+    }
+
+    C->packed = pool_acquire(&ctx->pool, packed_bytes(N, N), &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating buffer C. Error code: %d\n", err);
+        C->packed = NULL;
+        return err;
+    }
+
+    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &a);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &b);
+    err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &C->packed);
+    err |= clSetKernelArg(kernel, 3, sizeof(int), &tiles);
+
+    size_t global_size[2] = {(size_t)tiles * GEMM_TILE_SIZE, (size_t)tiles * GEMM_TILE_SIZE};
+    size_t local_size[2] = {GEMM_TILE_SIZE, GEMM_TILE_SIZE};
+    cl_event event;
+
+    if (err == CL_SUCCESS) {
+        err = clEnqueueNDRangeKernel(ctx->command_queue, kernel, 2, NULL, global_size, local_size, 0, NULL, &event);
+    }
+    if (err == CL_SUCCESS) {
+        clWaitForEvents(1, &event);
+        if (kernel_ms != NULL) {
+            *kernel_ms = getEventTime(event);
+        }
+        clReleaseEvent(event);
+    } else {
+        printf("[ERROR] Error running matrix_packed. Error code: %d\n", err);
+        packed_result_release(cache, C);
+    }
+    return err;
+}
+
+cl_int packed_result_unpack(PackCache* cache, const PackedResult* C, float* host)
+{
+    GemmContext* ctx = cache->gemm;
+    cl_kernel kernel = cache->kernel_unpack;
+    size_t bytes = sizeof(float) * (size_t)C->rows * C->cols;
+    int tile_cols = tile_count(C->cols);
+    cl_int err;
+
+    cl_mem staging = pool_acquire(&ctx->pool, bytes, &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating the staging buffer. Error code: %d\n", err);
+        return err;
+    }
+
+    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &C->packed);
+    err |= clSetKernelArg(kernel, 1, sizeof(int), &tile_cols);
+    err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &staging);
+    err |= clSetKernelArg(kernel, 3, sizeof(int), &C->rows);
+    err |= clSetKernelArg(kernel, 4, sizeof(int), &C->cols);
+
+    size_t global_size[2] = {(size_t)tile_count(C->rows) * GEMM_TILE_SIZE, (size_t)tile_cols * GEMM_TILE_SIZE};
+    size_t local_size[2] = {GEMM_TILE_SIZE, GEMM_TILE_SIZE};
+    if (err == CL_SUCCESS) {
+        err = clEnqueueNDRangeKernel(ctx->command_queue, kernel, 2, NULL, global_size, local_size, 0, NULL, NULL);
+    }
+    if (err == CL_SUCCESS) {
+        err = clEnqueueReadBuffer(ctx->command_queue, staging, CL_TRUE, 0, bytes, host, 0, NULL, NULL);
+    }
+    clFinish(ctx->command_queue);
+    pool_release(&ctx->pool, staging);
+    return err;
+}
+
+void packed_result_release(PackCache* cache, PackedResult* C)
+{
+    if (C->packed != NULL) {
+        pool_release(&cache->gemm->pool, C->packed);
+        C->packed = NULL;
+    }
+}
+
+void pack_cache_print_stats(const PackCache* cache, const char* label)
+{
+    printf("%s: %lu hits, %lu packs (%.1f ms), %lu evictions, %d operands cached\n",
+           label, cache->hits, cache->packs, cache->pack_ms, cache->evictions, cache->count);
+}
+
+void pack_cache_release(PackCache* cache)
+{
+    while (cache->count > 0) {
+        drop_entry(cache, &cache->entries[cache->count - 1]);
+    }
+    if (cache->kernel_pack != NULL) {
+        clReleaseKernel(cache->kernel_pack);
+    }
+    if (cache->kernel_unpack != NULL) {
+        clReleaseKernel(cache->kernel_unpack);
+    }
+    if (cache->kernel_gemm != NULL) {
+        clReleaseKernel(cache->kernel_gemm);
+    }
+    free(cache->entries);
+    memset(cache, 0, sizeof(PackCache));
+}
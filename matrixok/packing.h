@@ -0,0 +1,101 @@
+#ifndef PACKING_H
+#define PACKING_H
+
+#include "gemm.h"
+
+#define PACK_CACHE_DEFAULT_CAPACITY 16
+
+typedef enum {
+    PACK_ROW_PANELS,
+    PACK_COLUMN_PANELS
+} PackLayout;
+
+/**
+ * A host matrix converted to a tile-major device layout (see matrix.cl).
+ * The host pointer and the version together identify the contents: the
+ * caller bumps the version whenever it modifies the host matrix.
+ */
+typedef struct {
+    const float* host;
+    unsigned long version;
+    int rows;
+    int cols;
+    PackLayout layout;
+    cl_mem packed;
+    unsigned long last_use;
+} PackedOperand;
+
+/**
+ * Packed operands kept on the device between multiplications. When the
+ * capacity is reached the least recently used operand is dropped, except
+ * for the ones used at or after protect_from (the operands of the
+ * multiplication being prepared).
+ */
+typedef struct {
+    GemmContext* gemm;
+    cl_kernel kernel_pack;
+    cl_kernel kernel_unpack;
+    cl_kernel kernel_gemm;
+    PackedOperand* entries;
+    int count;
+    int capacity;
+    unsigned long clock;
+    unsigned long protect_from;
+
+    unsigned long hits;
+    unsigned long packs;
+    unsigned long evictions;
+    double pack_ms;
+} PackCache;
+
+/**
+ * A product left in the packed row panel layout on the device. It is only
+ * converted back to a row-major host matrix by packed_result_unpack.
+ */
+typedef struct {
+    cl_mem packed;
+    int rows;
+    int cols;
+} PackedResult;
+
+/**
+ * capacity: Number of packed operands kept (at least 2), 0 for the default
+ */
+cl_int pack_cache_init(PackCache* cache, GemmContext* gemm, int capacity);
+
+/**
+ * Return the packed form of a rows x cols row-major host matrix, packing
+ * it only when the (host, version, layout) triple is not cached yet.
+ * An older version of the same host matrix is replaced. The buffer is
+ * owned by the cache and stays valid until the operand is evicted.
+ */
+cl_mem pack_operand(PackCache* cache, const float* host, unsigned long version,
+                    int rows, int cols, PackLayout layout, cl_int* err);
+
+/**
+ * Drop every cached form of the host matrix.
+ */
+void pack_cache_invalidate(PackCache* cache, const float* host);
+
+/**
+ * C = A * B for N x N matrices of any N (padded to whole tiles). The
+ * operands come from the cache, the product stays packed on the device.
+ *
+ * C: Released with packed_result_release
+ * kernel_ms: Kernel execution time in milliseconds (may be NULL)
+ */
+cl_int packed_gemm(PackCache* cache, const float* A, unsigned long a_version,
+                   const float* B, unsigned long b_version, int N, PackedResult* C, double* kernel_ms);
+
+/**
+ * Convert a packed product to a row-major host matrix.
+ */
+cl_int packed_result_unpack(PackCache* cache, const PackedResult* C, float* host);
+
+void packed_result_release(PackCache* cache, PackedResult* C);
+
+void pack_cache_print_stats(const PackCache* cache, const char* label);
+
+void pack_cache_release(PackCache* cache);
+
+#endif
@@ -0,0 +1,207 @@
+#include "strassen.h"
+
+#include <stdio.h>
+#include <time.h>
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+int strassen_padded_size(int N, int cutoff)
+{
+    int unit = GEMM_TILE_SIZE;
+    int n = gemm_padded_size(N);
+
+    while (n > cutoff && n > 2 * GEMM_TILE_SIZE) {
+        n = (n + 1) / 2;
+        unit *= 2;
+    }
+    return (N + unit - 1) / unit * unit;
+}
+
+static MatrixView quadrant(MatrixView M, int half, int row, int col)
+{
+    MatrixView q = M;
+    q.offset = M.offset + row * half * M.ld + col * half;
+    return q;
+}
+
+static cl_int launch_view(GemmContext* ctx, MatrixView A, MatrixView B, MatrixView C, int n)
+{
+    cl_kernel kernel = ctx->kernel_view;
+    cl_int err;
+
+    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &A.mem);
+    err |= clSetKernelArg(kernel, 1, sizeof(int), &A.offset);
+    err |= clSetKernelArg(kernel, 2, sizeof(int), &A.ld);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &B.mem);
+    err |= clSetKernelArg(kernel, 4, sizeof(int), &B.offset);
+    err |= clSetKernelArg(kernel, 5, sizeof(int), &B.ld);
+    err |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &C.mem);
+    err |= clSetKernelArg(kernel, 7, sizeof(int), &C.offset);
+    err |= clSetKernelArg(kernel, 8, sizeof(int), &C.ld);
+    err |= clSetKernelArg(kernel, 9, sizeof(int), &n);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    size_t global_size[2] = {(size_t)n, (size_t)n};
+    size_t local_size[2] = {GEMM_TILE_SIZE, GEMM_TILE_SIZE};
+    return clEnqueueNDRangeKernel(ctx->command_queue, kernel, 2, NULL, global_size, local_size, 0, NULL, NULL);
+}
+
+// Z = X + beta * Y
+static cl_int launch_add(GemmContext* ctx, MatrixView X, MatrixView Y, MatrixView Z, float beta, int n)
+{
+    cl_kernel kernel = ctx->kernel_add;
+    cl_int err;
+
+    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &X.mem);
+    err |= clSetKernelArg(kernel, 1, sizeof(int), &X.offset);
+    err |= clSetKernelArg(kernel, 2, sizeof(int), &X.ld);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &Y.mem);
+    err |= clSetKernelArg(kernel, 4, sizeof(int), &Y.offset);
+    err |= clSetKernelArg(kernel, 5, sizeof(int), &Y.ld);
+    err |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &Z.mem);
+    err |= clSetKernelArg(kernel, 7, sizeof(int), &Z.offset);
+    err |= clSetKernelArg(kernel, 8, sizeof(int), &Z.ld);
+    err |= clSetKernelArg(kernel, 9, sizeof(float), &beta);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    size_t global_size[2] = {(size_t)n, (size_t)n};
+    return clEnqueueNDRangeKernel(ctx->command_queue, kernel, 2, NULL, global_size, NULL, 0, NULL, NULL);
+}
+
+#define STRASSEN_TEMPS 15
+
+cl_int strassen_gemm(GemmContext* ctx, DevicePool* pool,
+                     MatrixView A, MatrixView B, MatrixView C, int N, int cutoff)
+{
+    int h = N / 2;
+    cl_int err = CL_SUCCESS;
+
+    if (N <= cutoff || N % 2 != 0 || h % GEMM_TILE_SIZE != 0) {
+        return launch_view(ctx, A, B, C, N);
+    }
+
+    MatrixView A11 = quadrant(A, h, 0, 0), A12 = quadrant(A, h, 0, 1);
+    MatrixView A21 = quadrant(A, h, 1, 0), A22 = quadrant(A, h, 1, 1);
+    MatrixView B11 = quadrant(B, h, 0, 0), B12 = quadrant(B, h, 0, 1);
+    MatrixView B21 = quadrant(B, h, 1, 0), B22 = quadrant(B, h, 1, 1);
+    MatrixView C11 = quadrant(C, h, 0, 0), C12 = quadrant(C, h, 0, 1);
+    MatrixView C21 = quadrant(C, h, 1, 0), C22 = quadrant(C, h, 1, 1);
+
+    MatrixView t[STRASSEN_TEMPS];
+    int acquired = 0;
+    for (; acquired < STRASSEN_TEMPS; acquired++) {
+        t[acquired].mem = pool_acquire(pool, sizeof(float) * (size_t)h * h, &err);
+        t[acquired].offset = 0;
+        t[acquired].ld = h;
+        if (err != CL_SUCCESS) {
+            goto release;
+        }
+    }
+
+    MatrixView S1 = t[0], S2 = t[1], S3 = t[2], S4 = t[3];
+    MatrixView T1 = t[4], T2 = t[5], T3 = t[6], T4 = t[7];
+    MatrixView P1 = t[8], P2 = t[9], P3 = t[10], P4 = t[11];
+    MatrixView P5 = t[12], P6 = t[13], P7 = t[14];
+
+    err = launch_add(ctx, A21, A22, S1, 1.0f, h);
+    err |= launch_add(ctx, S1, A11, S2, -1.0f, h);
+    err |= launch_add(ctx, A11, A21, S3, -1.0f, h);
+    err |= launch_add(ctx, A12, S2, S4, -1.0f, h);
+    err |= launch_add(ctx, B12, B11, T1, -1.0f, h);
+    err |= launch_add(ctx, B22, T1, T2, -1.0f, h);
+    err |= launch_add(ctx, B22, B12, T3, -1.0f, h);
+    err |= launch_add(ctx, T2, B21, T4, -1.0f, h);
+    if (err != CL_SUCCESS) {
+        goto release;
+    }
+
+    if ((err = strassen_gemm(ctx, pool, A11, B11, P1, h, cutoff)) != CL_SUCCESS) goto release;
+    if ((err = strassen_gemm(ctx, pool, A12, B21, P2, h, cutoff)) != CL_SUCCESS) goto release;
+    if ((err = strassen_gemm(ctx, pool, S4, B22, P3, h, cutoff)) != CL_SUCCESS) goto release;
+    if ((err = strassen_gemm(ctx, pool, A22, T4, P4, h, cutoff)) != CL_SUCCESS) goto release;
+    if ((err = strassen_gemm(ctx, pool, S1, T1, P5, h, cutoff)) != CL_SUCCESS) goto release;
+    if ((err = strassen_gemm(ctx, pool, S2, T2, P6, h, cutoff)) != CL_SUCCESS) goto release;
+    if ((err = strassen_gemm(ctx, pool, S3, T3, P7, h, cutoff)) != CL_SUCCESS) goto release;
+
+    // C11 = P1 + P2, U2 = P1 + P6 (in place), C12 = U2 + P5 + P3,
+    // C22 = U2 + P7 (= U3), C21 = U3 - P4, C22 = U3 + P5
+    err = launch_add(ctx, P1, P2, C11, 1.0f, h);
+    err |= launch_add(ctx, P1, P6, P1, 1.0f, h);
+    err |= launch_add(ctx, P1, P5, C12, 1.0f, h);
+    err |= launch_add(ctx, C12, P3, C12, 1.0f, h);
+    err |= launch_add(ctx, P1, P7, C22, 1.0f, h);
+    err |= launch_add(ctx, C22, P4, C21, -1.0f, h);
+    err |= launch_add(ctx, C22, P5, C22, 1.0f, h);
+
+release:
+    // The queue is in-order, so the buffers can be reused by the next enqueued level.
+    for (int i = 0; i < acquired; i++) {
+        pool_release(pool, t[i].mem);
+    }
+    return err;
+}
+
+cl_int strassen_run(GemmContext* ctx, DevicePool* pool,
+                    const float* A, const float* B, float* C, int N, int cutoff, double* elapsed_ms)
+{
+    cl_int err;
+    size_t bytes = sizeof(float) * (size_t)N * N;
+
+    if (N % GEMM_TILE_SIZE != 0) {
+        return CL_INVALID_VALUE;
+    }
+
+    cl_mem d_A = pool_acquire(pool, bytes, &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating buffer A. Error code: %d\n", err);
+        return err;
+    }
+    cl_mem d_B = pool_acquire(pool, bytes, &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating buffer B. Error code: %d\n", err);
+        pool_release(pool, d_A);
+        return err;
+    }
+    cl_mem d_C = pool_acquire(pool, bytes, &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating buffer C. Error code: %d\n", err);
+        pool_release(pool, d_A);
+        pool_release(pool, d_B);
+        return err;
+    }
+
+    err = clEnqueueWriteBuffer(ctx->command_queue, d_A, CL_FALSE, 0, bytes, A, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(ctx->command_queue, d_B, CL_FALSE, 0, bytes, B, 0, NULL, NULL);
+    clFinish(ctx->command_queue);
+
+    if (err == CL_SUCCESS) {
+        MatrixView vA = {d_A, 0, N};
+        MatrixView vB = {d_B, 0, N};
+        MatrixView vC = {d_C, 0, N};
+
+        double start = now_ms();
+        err = strassen_gemm(ctx, pool, vA, vB, vC, N, cutoff);
+        clFinish(ctx->command_queue);
+        if (elapsed_ms != NULL) {
+            *elapsed_ms = now_ms() - start;
+        }
+    }
+
+    if (err == CL_SUCCESS) {
+        err = clEnqueueReadBuffer(ctx->command_queue, d_C, CL_TRUE, 0, bytes, C, 0, NULL, NULL);
+    }
+
+    pool_release(pool, d_A);
+    pool_release(pool, d_B);
+    pool_release(pool, d_C);
+    return err;
+}
@@ -0,0 +1,33 @@
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+#include "gemm.h"
+#include "device_pool.h"
+
+#define STRASSEN_DEFAULT_CUTOFF 1024
+
+/**
+ * Size to pad N to, so that every Strassen level splits into halves that
+ * are still multiples of the tile size until the cutoff is reached.
+ */
+int strassen_padded_size(int N, int cutoff);
+
+/**
+ * C = A * B on device views with the Strassen-Winograd recursion
+ * (7 products, 15 additions per level). Below the cutoff, or when the
+ * half size is not a tile multiple, the tiled matrix_view kernel is used.
+ * Temporaries come from the pool and are given back after each level.
+ */
+cl_int strassen_gemm(GemmContext* ctx, DevicePool* pool,
+                     MatrixView A, MatrixView B, MatrixView C, int N, int cutoff);
+
+/**
+ * Upload A and B, run strassen_gemm and read C back.
+ *
+ * A, B, C: Row-major host matrices of N x N floats
+ * elapsed_ms: Device time of the recursion without the transfers (may be NULL)
+ */
+cl_int strassen_run(GemmContext* ctx, DevicePool* pool,
+                    const float* A, const float* B, float* C, int N, int cutoff, double* elapsed_ms);
+
+#endif
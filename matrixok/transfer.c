@@ -0,0 +1,302 @@
+#include "transfer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+cl_int transfer_init(TransferManager* manager, GemmContext* gemm)
+{
+    memset(manager, 0, sizeof(TransferManager));
+    manager->gemm = gemm;
+    return CL_SUCCESS;
+}
+
+static int grow(void** array, int* capacity, int count, size_t item_size)
+{
+    if (count < *capacity) {
+        return 1;
+    }
+    int new_capacity = *capacity > 0 ? *capacity * 2 : 16;
+    void* grown = realloc(*array, item_size * new_capacity);
+    if (grown == NULL) {
+        return 0;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+void* transfer_alloc_pinned(TransferManager* manager, size_t bytes, cl_int* err)
+{
+    GemmContext* ctx = manager->gemm;
+    PinnedBuffer* best = NULL;
+
+    for (int i = 0; i < manager->pinned_count; i++) {
+        PinnedBuffer* buffer = &manager->pinned[i];
+        if (!buffer->in_use && buffer->size >= bytes && (best == NULL || buffer->size < best->size)) {
+            best = buffer;
+        }
+    }
+    if (best != NULL) {
+        best->in_use = 1;
+        *err = CL_SUCCESS;
+        return best->host;
+    }
+
+    if (!grow((void**)&manager->pinned, &manager->pinned_capacity, manager->pinned_count, sizeof(PinnedBuffer))) {
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return NULL;
+    }
+    PinnedBuffer* buffer = &manager->pinned[manager->pinned_count];
+    buffer->mem = clCreateBuffer(ctx->context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, bytes, NULL, err);
+    if (*err != CL_SUCCESS) {
+        printf("[ERROR] Error creating a pinned buffer. Error code: %d\n", *err);
+        return NULL;
+    }
+    // Mapped once: the pointer stays valid (and page-locked) until transfer_release.
+    buffer->host = clEnqueueMapBuffer(ctx->command_queue, buffer->mem, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+                                      0, bytes, 0, NULL, NULL, err);
+    if (*err != CL_SUCCESS) {
+        printf("[ERROR] Error mapping a pinned buffer. Error code: %d\n", *err);
+        clReleaseMemObject(buffer->mem);
+        return NULL;
+    }
+    buffer->size = bytes;
+    buffer->in_use = 1;
+    manager->pinned_count++;
+    return buffer->host;
+}
+
+void transfer_free_pinned(TransferManager* manager, void* host)
+{
+    for (int i = 0; i < manager->pinned_count; i++) {
+        if (manager->pinned[i].host == host) {
+            manager->pinned[i].in_use = 0;
+            return;
+        }
+    }
+}
+
+cl_int transfer_flush(TransferManager* manager, cl_event* event)
+{
+    cl_command_queue queue = manager->gemm->command_queue;
+    cl_int err = CL_SUCCESS;
+
+    if (manager->batch_count > 0) {
+        cl_event written;
+        err = clEnqueueWriteBuffer(queue, manager->batch_device, CL_FALSE, 0, manager->batch_used,
+                                   manager->batch_host, 0, NULL, &written);
+        if (err != CL_SUCCESS) {
+            printf("[ERROR] Error writing a transfer batch. Error code: %d\n", err);
+            return err;
+        }
+        if (manager->batch_event != NULL) {
+            clReleaseEvent(manager->batch_event);
+        }
+        // The pinned batch can be refilled once this write has completed.
+        manager->batch_event = written;
+
+        // Neighbouring writes into the same buffer become one device side copy.
+        for (int i = 0; i < manager->batch_count && err == CL_SUCCESS;) {
+            BatchedWrite run = manager->batch_writes[i++];
+            while (i < manager->batch_count && manager->batch_writes[i].dst == run.dst
+                   && manager->batch_writes[i].dst_offset == run.dst_offset + run.bytes) {
+                run.bytes += manager->batch_writes[i++].bytes;
+            }
+            err = clEnqueueCopyBuffer(queue, manager->batch_device, run.dst, run.batch_offset, run.dst_offset,
+                                      run.bytes, 0, NULL, NULL);
+        }
+        manager->batch_count = 0;
+        manager->batch_used = 0;
+        manager->batches++;
+        if (err != CL_SUCCESS) {
+            printf("[ERROR] Error copying a transfer batch. Error code: %d\n", err);
+            return err;
+        }
+    }
+
+    if (event != NULL) {
+        err = clEnqueueMarkerWithWaitList(queue, 0, NULL, event);
+    }
+    clFlush(queue);
+    return err;
+}
+
+static cl_int batch_write(TransferManager* manager, cl_mem dst, size_t offset, const void* host, size_t bytes)
+{
+    cl_int err = CL_SUCCESS;
+
+    if (manager->batch_host == NULL) {
+        manager->batch_host = transfer_alloc_pinned(manager, TRANSFER_BATCH_SIZE, &err);
+        if (err != CL_SUCCESS) {
+            return err;
+        }
+        manager->batch_device = pool_acquire(&manager->gemm->pool, TRANSFER_BATCH_SIZE, &err);
+        if (err != CL_SUCCESS) {
+            printf("[ERROR] Error creating the batch buffer. Error code: %d\n", err);
+            manager->batch_device = NULL;
+            return err;
+        }
+    }
+    if (manager->batch_used + bytes > TRANSFER_BATCH_SIZE
+        || !grow((void**)&manager->batch_writes, &manager->batch_capacity, manager->batch_count, sizeof(BatchedWrite))) {
+        if ((err = transfer_flush(manager, NULL)) != CL_SUCCESS) {
+            return err;
+        }
+        if (!grow((void**)&manager->batch_writes, &manager->batch_capacity, manager->batch_count, sizeof(BatchedWrite))) {
+            return CL_OUT_OF_HOST_MEMORY;
+        }
+    }
+    if (manager->batch_used == 0 && manager->batch_event != NULL) {
+        clWaitForEvents(1, &manager->batch_event);
+        clReleaseEvent(manager->batch_event);
+        manager->batch_event = NULL;
+    }
+
+    BatchedWrite* write = &manager->batch_writes[manager->batch_count++];
+    write->dst = dst;
+    write->dst_offset = offset;
+    write->batch_offset = manager->batch_used;
+    write->bytes = bytes;
+    memcpy((char*)manager->batch_host + manager->batch_used, host, bytes);
+    manager->batch_used += bytes;
+    manager->coalesced_writes++;
+    return CL_SUCCESS;
+}
+
+cl_int transfer_write(TransferManager* manager, cl_mem dst, size_t offset, const void* host, size_t bytes,
+                      cl_uint wait_count, const cl_event* wait_list, cl_event* event)
+{
+    cl_int err;
+
+    manager->writes++;
+    manager->bytes_written += bytes;
+    if (bytes < TRANSFER_COALESCE_LIMIT && wait_count == 0 && event == NULL) {
+        return batch_write(manager, dst, offset, host, bytes);
+    }
+
+    // Earlier small writes go first, the queue keeps the order.
+    if ((err = transfer_flush(manager, NULL)) != CL_SUCCESS) {
+        return err;
+    }
+    err = clEnqueueWriteBuffer(manager->gemm->command_queue, dst, CL_FALSE, offset, bytes, host,
+                               wait_count, wait_list, event);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error writing a buffer. Error code: %d\n", err);
+    }
+    return err;
+}
+
+cl_int transfer_read(TransferManager* manager, cl_mem src, size_t offset, size_t bytes,
+                     cl_uint wait_count, const cl_event* wait_list, TransferCallback callback, void* user_data)
+{
+    cl_int err;
+
+    if ((err = transfer_flush(manager, NULL)) != CL_SUCCESS) {
+        return err;
+    }
+    if (!grow((void**)&manager->reads, &manager->read_capacity, manager->read_count, sizeof(PendingRead))) {
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    void* host = transfer_alloc_pinned(manager, bytes, &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    PendingRead* read = &manager->reads[manager->read_count];
+    err = clEnqueueReadBuffer(manager->gemm->command_queue, src, CL_FALSE, offset, bytes, host,
+                              wait_count, wait_list, &read->event);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error reading a buffer. Error code: %d\n", err);
+        transfer_free_pinned(manager, host);
+        return err;
+    }
+    clFlush(manager->gemm->command_queue);
+    read->host = host;
+    read->bytes = bytes;
+    read->callback = callback;
+    read->user_data = user_data;
+    manager->read_count++;
+    return CL_SUCCESS;
+}
+
+int transfer_poll(TransferManager* manager)
+{
+    int done_count = 0;
+    int kept = 0;
+
+    if (manager->read_count == 0) {
+        return 0;
+    }
+    // Completed reads are taken out first, so the callbacks may start new transfers.
+    PendingRead* done = (PendingRead*)malloc(sizeof(PendingRead) * manager->read_count);
+    if (done == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < manager->read_count; i++) {
+        cl_int status = CL_QUEUED;
+        clGetEventInfo(manager->reads[i].event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+        if (status <= CL_COMPLETE) {
+            done[done_count++] = manager->reads[i];
+        } else {
+            manager->reads[kept++] = manager->reads[i];
+        }
+    }
+    manager->read_count = kept;
+
+    for (int i = 0; i < done_count; i++) {
+        cl_int status = CL_COMPLETE;
+        clGetEventInfo(done[i].event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+        if (done[i].callback != NULL) {
+            done[i].callback(done[i].host, done[i].bytes, status, done[i].user_data);
+        }
+        clReleaseEvent(done[i].event);
+        transfer_free_pinned(manager, done[i].host);
+        manager->reads_done++;
+        manager->bytes_read += done[i].bytes;
+    }
+    free(done);
+    return done_count;
+}
+
+cl_int transfer_finish(TransferManager* manager)
+{
+    cl_int err = transfer_flush(manager, NULL);
+    clFinish(manager->gemm->command_queue);
+    // Callbacks may have queued further reads.
+    while (transfer_poll(manager) > 0 && manager->read_count > 0) {
+        clFinish(manager->gemm->command_queue);
+    }
+    return err;
+}
+
+void transfer_print_stats(const TransferManager* manager, const char* label)
+{
+    printf("%s: %lu writes (%lu coalesced in %lu batches, %.1f MB), %lu reads (%.1f MB), %d pinned buffers\n",
+           label, manager->writes, manager->coalesced_writes, manager->batches, manager->bytes_written / 1e6,
+           manager->reads_done, manager->bytes_read / 1e6, manager->pinned_count);
+}
+
+void transfer_release(TransferManager* manager)
+{
+    GemmContext* ctx = manager->gemm;
+
+    transfer_finish(manager);
+    if (manager->batch_event != NULL) {
+        clReleaseEvent(manager->batch_event);
+    }
+    if (manager->batch_device != NULL) {
+        pool_release(&ctx->pool, manager->batch_device);
+    }
+    for (int i = 0; i < manager->pinned_count; i++) {
+        clEnqueueUnmapMemObject(ctx->command_queue, manager->pinned[i].mem, manager->pinned[i].host, 0, NULL, NULL);
+    }
+    clFinish(ctx->command_queue);
+    for (int i = 0; i < manager->pinned_count; i++) {
+        clReleaseMemObject(manager->pinned[i].mem);
+    }
+    free(manager->pinned);
+    free(manager->batch_writes);
+    free(manager->reads);
+    memset(manager, 0, sizeof(TransferManager));
+}
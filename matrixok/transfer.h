@@ -0,0 +1,136 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include "gemm.h"
+
+/**
+ * Writes below this size without an event are copied into a pinned batch
+ * and sent together by transfer_flush: one host to device write into a
+ * device staging buffer, then device side copies to the destinations.
+ */
+#define TRANSFER_COALESCE_LIMIT ((size_t)64 * 1024)
+#define TRANSFER_BATCH_SIZE ((size_t)4 * 1024 * 1024)
+
+/**
+ * Called from transfer_poll or transfer_finish (on the caller's thread)
+ * when a read has completed. host is a pinned buffer owned by the manager:
+ * it is reused after the callback returns.
+ *
+ * status: CL_COMPLETE, or the negative error code of the failed read
+ */
+typedef void (*TransferCallback)(void* host, size_t bytes, cl_int status, void* user_data);
+
+/**
+ * Page-locked host memory: a CL_MEM_ALLOC_HOST_PTR buffer kept mapped for
+ * its whole life. Transfers from and to it run at DMA speed and may be
+ * asynchronous.
+ */
+typedef struct {
+    cl_mem mem;
+    void* host;
+    size_t size;
+    int in_use;
+} PinnedBuffer;
+
+typedef struct {
+    cl_mem dst;
+    size_t dst_offset;
+    size_t batch_offset;
+    size_t bytes;
+} BatchedWrite;
+
+typedef struct {
+    cl_event event;
+    void* host;
+    size_t bytes;
+    TransferCallback callback;
+    void* user_data;
+} PendingRead;
+
+/**
+ * Non-blocking transfers on the in-order queue of a GemmContext with
+ * reusable pinned staging memory.
+ */
+typedef struct {
+    GemmContext* gemm;
+
+    PinnedBuffer* pinned;
+    int pinned_count;
+    int pinned_capacity;
+
+    void* batch_host;
+    cl_mem batch_device;
+    cl_event batch_event;
+    size_t batch_used;
+    BatchedWrite* batch_writes;
+    int batch_count;
+    int batch_capacity;
+
+    PendingRead* reads;
+    int read_count;
+    int read_capacity;
+
+    unsigned long writes;
+    unsigned long coalesced_writes;
+    unsigned long batches;
+    unsigned long reads_done;
+    size_t bytes_written;
+    size_t bytes_read;
+} TransferManager;
+
+cl_int transfer_init(TransferManager* manager, GemmContext* gemm);
+
+/**
+ * Return pinned host memory of at least bytes bytes, reusing a free
+ * buffer when one is large enough.
+ */
+void* transfer_alloc_pinned(TransferManager* manager, size_t bytes, cl_int* err);
+
+/**
+ * Give pinned memory back for reuse. It stays allocated and mapped.
+ */
+void transfer_free_pinned(TransferManager* manager, void* host);
+
+/**
+ * Asynchronous host to device write. The host memory must stay unchanged
+ * until the event completes (pinned memory of the manager is fastest).
+ * Small writes without wait list and event are coalesced and only sent
+ * by the next transfer_flush, transfer_read or large write.
+ *
+ * event: Completion of the write, may be NULL
+ */
+cl_int transfer_write(TransferManager* manager, cl_mem dst, size_t offset, const void* host, size_t bytes,
+                      cl_uint wait_count, const cl_event* wait_list, cl_event* event);
+
+/**
+ * Send the coalesced small writes.
+ *
+ * event: Completes when every write so far has reached the device (may be NULL)
+ */
+cl_int transfer_flush(TransferManager* manager, cl_event* event);
+
+/**
+ * Asynchronous device to host read into pinned staging memory. The
+ * callback receives the data once transfer_poll or transfer_finish sees
+ * the read completed.
+ */
+cl_int transfer_read(TransferManager* manager, cl_mem src, size_t offset, size_t bytes,
+                     cl_uint wait_count, const cl_event* wait_list, TransferCallback callback, void* user_data);
+
+/**
+ * Hand every completed read to its callback without waiting.
+ *
+ * Returns the number of callbacks called
+ */
+int transfer_poll(TransferManager* manager);
+
+/**
+ * Flush, wait for every transfer and call the remaining callbacks.
+ */
+cl_int transfer_finish(TransferManager* manager);
+
+void transfer_print_stats(const TransferManager* manager, const char* label);
+
+void transfer_release(TransferManager* manager);
+
+#endif
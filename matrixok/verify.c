@@ -0,0 +1,140 @@
+#include "verify.h"
+#include "perf_regions.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REF_BLOCK_K 128
+#define REF_BLOCK_J 512
+
+uint16_t float_to_half(float value)
+{
+    uint32_t x;
+    memcpy(&x, &value, sizeof(x));
+
+    uint32_t sign = (x >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = x & 0x7fffff;
+
+    if (((x >> 23) & 0xff) == 0xff) {
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31) {
+        return (uint16_t)(sign | 0x7c00);
+    }
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return (uint16_t)sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (rest > midpoint || (rest == midpoint && (half & 1))) {
+            half++;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return (uint16_t)(sign | half);
+}
+
+float half_to_float(uint16_t value)
+{
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    uint32_t x;
+    float result;
+
+    if (exponent == 0) {
+        result = ldexpf((float)mantissa, -24);
+        return sign ? -result : result;
+    }
+    if (exponent == 31) {
+        x = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        x = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+    memcpy(&result, &x, sizeof(result));
+    return result;
+}
+
+void reference_gemm_rows(const float* A, const float* B, int N,
+                         const int* rows, int row_count, double* ref)
+{
+    memset(ref, 0, sizeof(double) * (size_t)row_count * N);
+
+    for (int jj = 0; jj < N; jj += REF_BLOCK_J) {
+        int j_end = jj + REF_BLOCK_J < N ? jj + REF_BLOCK_J : N;
+        for (int kk = 0; kk < N; kk += REF_BLOCK_K) {
+            int k_end = kk + REF_BLOCK_K < N ? kk + REF_BLOCK_K : N;
+            for (int r = 0; r < row_count; r++) {
+                const float* a_row = A + (size_t)rows[r] * N;
+                double* ref_row = ref + (size_t)r * N;
+                for (int k = kk; k < k_end; k++) {
+                    double a = a_row[k];
+                    const float* b_row = B + (size_t)k * N;
+                    for (int j = jj; j < j_end; j++) {
+                        ref_row[j] += a * b_row[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+GemmError verify_gemm(const float* A, const float* B, const float* C, int N, int max_rows)
+{
+    GemmError result = {0, 0.0, 0.0};
+    if (N <= 0) {
+        return result;
+    }
+    int row_count = (max_rows <= 0 || max_rows > N) ? N : max_rows;
+
+    int* rows = (int*)malloc(sizeof(int) * row_count);
+    double* ref = (double*)malloc(sizeof(double) * (size_t)row_count * N);
+    if (rows == NULL || ref == NULL) {
+        free(rows);
+        free(ref);
+        return result;
+    }
+
+    perf_region_begin("verify_gemm");
+    for (int r = 0; r < row_count; r++) {
+        rows[r] = (int)((long long)r * N / row_count);
+    }
+    perf_region_begin("reference_gemm_rows");
+    reference_gemm_rows(A, B, N, rows, row_count, ref);
+    perf_region_end();
+
+    double max_ref = 0.0;
+    for (int r = 0; r < row_count; r++) {
+        const float* c_row = C + (size_t)rows[r] * N;
+        const double* ref_row = ref + (size_t)r * N;
+        for (int j = 0; j < N; j++) {
+            double diff = fabs((double)c_row[j] - ref_row[j]);
+            if (diff > result.max_abs_error) {
+                result.max_abs_error = diff;
+            }
+            if (fabs(ref_row[j]) > max_ref) {
+                max_ref = fabs(ref_row[j]);
+            }
+        }
+    }
+
+    result.checked_rows = row_count;
+    result.max_rel_error = max_ref > 0.0 ? result.max_abs_error / max_ref : 0.0;
+    perf_region_end();
+
+    free(rows);
+    free(ref);
+    return result;
+}
@@ -0,0 +1,38 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stdint.h>
+
+typedef struct {
+    int checked_rows;
+    double max_abs_error;
+    double max_rel_error;
+} GemmError;
+
+/**
+ * IEEE 754 binary16 <-> binary32 conversion (round to nearest even).
+ */
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t value);
+
+/**
+ * Compute the selected rows of A * B in double precision with a
+ * cache-blocked loop nest.
+ *
+ * rows: Indices of the rows to compute
+ * ref: Output, row_count x N doubles
+ */
+void reference_gemm_rows(const float* A, const float* B, int N,
+                         const int* rows, int row_count, double* ref);
+
+/**
+ * Compare C against the fp64 reference on evenly spaced sample rows.
+ *
+ * max_rows: Number of rows to check, 0 or >= N checks the full matrix
+ *
+ * The relative error is the largest absolute error divided by the
+ * largest absolute reference value of the checked rows.
+ */
+GemmError verify_gemm(const float* A, const float* B, const float* C, int N, int max_rows);
+
+#endif
@@ -2,25 +2,281 @@
 #define CL_TARGET_OPENCL_VERSION 220
 #include <stdlib.h>
 #include <CL/cl.h>
+#ifndef DEVICE_TYPE
+#define DEVICE_TYPE CL_DEVICE_TYPE_GPU
+#endif
 #include <time.h>
 #include "kernel_loader.h"
+#include "kernel_cache.h"
+#include "selection.h"
 #include <string.h>
 
 #define ARRAY_SIZE 12
 #define NUM_THREADS 1024
 
-int main() {
+// A top-k meres parameterei: bemenetmeretek es k ertekek.
+#define TOPK_REPEATS 3
+#define SPECIALIZE_REPEATS 3
+static const int topkSizes[] = {1 << 16, 1 << 20, 1 << 23};
+static const int topkCounts[] = {1, 32, 1024, 16384, 262144};
+
+static double nowMs(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static int compareInts(const void* a, const void* b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static int compareFloatsDescending(const void* a, const void* b) {
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+    return (x < y) - (x > y);
+}
+
+// Legjobb ido TOPK_REPEATS futasbol.
+static double timeTopK(SelectionContext* selection, cl_mem keys, int n, int k, cl_mem outKeys, cl_int* err) {
+    double best = 0.0;
+    for (int r = 0; r < TOPK_REPEATS; r++) {
+        double start = nowMs();
+        *err = select_top_k(selection, keys, n, SELECTION_INT, 0, k, outKeys, NULL);
+        double elapsed = nowMs() - start;
+        if (*err != CL_SUCCESS) {
+            return 0.0;
+        }
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+// Egy bogosort futas ideje (ms) az eredeti tombon, a kernel esemenye alapjan.
+static double timeRandomSort(cl_command_queue queue, cl_kernel kernel, cl_mem input_mem, cl_mem result_flag,
+                             const int* data, cl_int* err) {
+    int zero = 0;
+    int array_size = ARRAY_SIZE;
+    size_t local_size[1] = {1};
+    size_t global_size[1] = {NUM_THREADS};
+    cl_event event;
+    cl_ulong time_start, time_end;
+
+    *err = clEnqueueWriteBuffer(queue, input_mem, CL_FALSE, 0, sizeof(int) * ARRAY_SIZE, data, 0, NULL, NULL);
+    *err |= clEnqueueWriteBuffer(queue, result_flag, CL_FALSE, 0, sizeof(int), &zero, 0, NULL, NULL);
+    *err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &input_mem);
+    *err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &result_flag);
+    *err |= clSetKernelArg(kernel, 2, sizeof(int), &array_size);
+    if (*err != CL_SUCCESS) {
+        return 0.0;
+    }
+    *err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, global_size, local_size, 0, NULL, &event);
+    if (*err != CL_SUCCESS) {
+        return 0.0;
+    }
+    clWaitForEvents(1, &event);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(time_start), &time_start, NULL);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(time_end), &time_end, NULL);
+    clReleaseEvent(event);
+    return (double)(time_end - time_start) / 1000000.0;
+}
+
+// Az altalanos es a specializalt kernel ugyanazon a tombon. A szalak magja a
+// globalis indexbol jon, igy mindket kernel ugyanazokat a keveresi koroket
+// futtatja: a kulonbseg a specializacio hatasa. Legjobb ido SPECIALIZE_REPEATS futasbol.
+static int compareSpecialized(KernelCache* cache, const char* options, cl_command_queue queue,
+                              cl_mem input_mem, cl_mem result_flag, const int* data) {
+    const char* variants[2] = {"", options};
+    double best[2] = {0.0, 0.0};
+    cl_int err;
+
+    for (int v = 0; v < 2; v++) {
+        double compile_ms;
+        cl_kernel kernel = kernel_cache_get_kernel(cache, variants[v], "random_sort", &compile_ms, &err);
+        if (kernel == NULL) {
+            fprintf(stderr, "kernel_cache_get_kernel hiba: %d\n", err);
+            return 1;
+        }
+        for (int r = 0; r < SPECIALIZE_REPEATS; r++) {
+            double ms = timeRandomSort(queue, kernel, input_mem, result_flag, data, &err);
+            if (err != CL_SUCCESS) {
+                fprintf(stderr, "random_sort hiba: %d\n", err);
+                return 1;
+            }
+            if (r == 0 || ms < best[v]) {
+                best[v] = ms;
+            }
+        }
+        printf("%-12s kernel %10.3f ms (forditas/betoltes %.1f ms)\n",
+               v == 0 ? "altalanos:" : "specializalt:", best[v], compile_ms);
+    }
+    printf("gyorsulas: %.2fx\n", best[1] > 0.0 ? best[0] / best[1] : 0.0);
+    return 0;
+}
+
+// A k legkisebb int kulcs es az n/2-edik elem, osszevetve a teljes bitonikus rendezessel,
+// vegul egy float / legnagyobbak / indexek ellenorzes.
+static int runTopKBenchmark(cl_context context, cl_command_queue queue, SelectionContext* selection) {
+    int maxSize = topkSizes[sizeof(topkSizes) / sizeof(topkSizes[0]) - 1];
+    int* keys = (int*)malloc(sizeof(int) * maxSize);
+    int* sorted = (int*)malloc(sizeof(int) * maxSize);
+    int* result = (int*)malloc(sizeof(int) * maxSize);
+    int failures = 0;
+    cl_int ret;
+
+    if (keys == NULL || sorted == NULL || result == NULL) {
+        fprintf(stderr, "Nincs eleg memoria!\n");
+        free(keys);
+        free(sorted);
+        free(result);
+        return 1;
+    }
+
+    cl_mem keysMem = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(int) * maxSize, NULL, &ret);
+    cl_mem sortMem = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(int) * maxSize, NULL, &ret);
+    cl_mem outKeys = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(int) * maxSize, NULL, &ret);
+    cl_mem outIndices = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(int) * maxSize, NULL, &ret);
+    if (keysMem == NULL || sortMem == NULL || outKeys == NULL || outIndices == NULL) {
+        fprintf(stderr, "clCreateBuffer hiba: %d\n", ret);
+        ret = CL_OUT_OF_RESOURCES;
+        goto cleanup;
+    }
+
+    for (size_t s = 0; s < sizeof(topkSizes) / sizeof(topkSizes[0]) && ret == CL_SUCCESS; s++) {
+        int n = topkSizes[s];
+        for (int i = 0; i < n; i++) {
+            keys[i] = (int)(((unsigned)rand() << 16) ^ (unsigned)rand());
+        }
+        memcpy(sorted, keys, sizeof(int) * n);
+        qsort(sorted, n, sizeof(int), compareInts);
+        clEnqueueWriteBuffer(queue, keysMem, CL_TRUE, 0, sizeof(int) * n, keys, 0, NULL, NULL);
+
+        // A teljes rendezes egy masolaton fut, az elso futas bemelegites.
+        double sortMs = 0.0;
+        for (int r = 0; r <= TOPK_REPEATS && ret == CL_SUCCESS; r++) {
+            clEnqueueCopyBuffer(queue, keysMem, sortMem, 0, 0, sizeof(int) * n, 0, NULL, NULL);
+            clFinish(queue);
+            double start = nowMs();
+            ret = selection_full_sort(selection, sortMem, n);
+            double elapsed = nowMs() - start;
+            if (r == 1 || (r > 1 && elapsed < sortMs)) {
+                sortMs = elapsed;
+            }
+        }
+        if (ret != CL_SUCCESS) {
+            break;
+        }
+        clEnqueueReadBuffer(queue, sortMem, CL_TRUE, 0, sizeof(int) * n, result, 0, NULL, NULL);
+        int sortOk = memcmp(result, sorted, sizeof(int) * n) == 0;
+        failures += !sortOk;
+        printf("n=%d: teljes rendezes %.2f ms %s\n", n, sortMs, sortOk ? "OK" : "HIBA");
+
+        for (size_t c = 0; c < sizeof(topkCounts) / sizeof(topkCounts[0]); c++) {
+            int k = topkCounts[c];
+            if (k > n / 4) {
+                continue;
+            }
+            timeTopK(selection, keysMem, n, k, outKeys, &ret);
+            double topkMs = timeTopK(selection, keysMem, n, k, outKeys, &ret);
+            if (ret != CL_SUCCESS) {
+                break;
+            }
+            clEnqueueReadBuffer(queue, outKeys, CL_TRUE, 0, sizeof(int) * k, result, 0, NULL, NULL);
+            if (k > SELECTION_BITONIC_MAX_K) {
+                qsort(result, k, sizeof(int), compareInts);
+            }
+            int ok = memcmp(result, sorted, sizeof(int) * k) == 0;
+            failures += !ok;
+            printf("  k=%-7d top-k %8.3f ms (%s), %6.1fx gyorsabb a rendezesnel %s\n", k, topkMs,
+                   k > SELECTION_BITONIC_MAX_K ? "radix-select" : "bitonikus", sortMs / topkMs, ok ? "OK" : "HIBA");
+        }
+        if (ret != CL_SUCCESS) {
+            break;
+        }
+
+        cl_uint median;
+        double start = nowMs();
+        ret = select_nth(selection, keysMem, n, SELECTION_INT, n / 2, &median);
+        double nthMs = nowMs() - start;
+        if (ret != CL_SUCCESS) {
+            break;
+        }
+        int ok = (int)median == sorted[n / 2];
+        failures += !ok;
+        printf("  n/2-edik elem %8.3f ms, %6.1fx gyorsabb a rendezesnel %s\n", nthMs, sortMs / nthMs, ok ? "OK" : "HIBA");
+    }
+
+    // Float kulcsok, a legnagyobbak indexekkel: az indexek a bemenet megfelelo elemeire mutatnak.
+    if (ret == CL_SUCCESS) {
+        int n = 1 << 20;
+        int counts[2] = {100, 5000};
+        float* values = (float*)keys;
+        float* reference = (float*)sorted;
+        int* indices = (int*)malloc(sizeof(int) * counts[1]);
+        for (int i = 0; i < n; i++) {
+            values[i] = (float)rand() / RAND_MAX * 2000.0f - 1000.0f;
+        }
+        memcpy(reference, values, sizeof(float) * n);
+        qsort(reference, n, sizeof(float), compareFloatsDescending);
+        clEnqueueWriteBuffer(queue, keysMem, CL_TRUE, 0, sizeof(float) * n, values, 0, NULL, NULL);
+
+        for (int c = 0; c < 2 && ret == CL_SUCCESS && indices != NULL; c++) {
+            int k = counts[c];
+            ret = select_top_k(selection, keysMem, n, SELECTION_FLOAT, 1, k, outKeys, outIndices);
+            if (ret != CL_SUCCESS) {
+                break;
+            }
+            float* found = (float*)result;
+            clEnqueueReadBuffer(queue, outKeys, CL_TRUE, 0, sizeof(float) * k, found, 0, NULL, NULL);
+            clEnqueueReadBuffer(queue, outIndices, CL_TRUE, 0, sizeof(int) * k, indices, 0, NULL, NULL);
+            int ok = 1;
+            for (int i = 0; i < k; i++) {
+                ok &= indices[i] >= 0 && indices[i] < n && values[indices[i]] == found[i];
+            }
+            qsort(found, k, sizeof(float), compareFloatsDescending);
+            ok &= memcmp(found, reference, sizeof(float) * k) == 0;
+            failures += !ok;
+            printf("float, legnagyobb %d indexekkel: %s\n", k, ok ? "OK" : "HIBA");
+        }
+        free(indices);
+    }
+
+    if (ret == CL_SUCCESS) {
+        printf("%s\n", failures == 0 ? "Minden eredmeny helyes." : "Hibas eredmenyek!");
+    } else {
+        fprintf(stderr, "Kivalasztasi hiba: %d\n", ret);
+    }
+
+cleanup:
+    if (keysMem != NULL) clReleaseMemObject(keysMem);
+    if (sortMem != NULL) clReleaseMemObject(sortMem);
+    if (outKeys != NULL) clReleaseMemObject(outKeys);
+    if (outIndices != NULL) clReleaseMemObject(outIndices);
+    free(keys);
+    free(sorted);
+    free(result);
+    return ret != CL_SUCCESS || failures > 0;
+}
+
+int main(int argc, char* argv[]) {
     int data[ARRAY_SIZE];
     srand(time(NULL));
     for (int i = 0; i < ARRAY_SIZE; i++) {
         data[i] = rand() % 100;
     }
 
-    printf("Eredeti tömb:\n");
-    for (int i = 0; i < ARRAY_SIZE; i++) {
-        printf("%d ", data[i]);
+    // "topk": kivalasztasi meres a bogosort helyett.
+    int topk = argc > 1 && strcmp(argv[1], "topk") == 0;
+    if (!topk) {
+        printf("Eredeti tömb:\n");
+        for (int i = 0; i < ARRAY_SIZE; i++) {
+            printf("%d ", data[i]);
+        }
+        printf("\n");
     }
-    printf("\n");
 
     cl_platform_id platform_id;
     cl_device_id device_id;
@@ -34,13 +290,12 @@ int main() {
     int success = 0;
     cl_int ret;
 
-    int error_code;
-    char* source_str = load_kernel_source("randomsort.cl", &error_code);
-    if (error_code != 0) {
-        fprintf(stderr, "Nem sikerült betölteni a kernelt!\n");
-        return 1;
+    // "specialize": a tomb merete forditasi ideju konstans lesz (-DSORT_SIZE).
+    int specialize = argc > 1 && strcmp(argv[1], "specialize") == 0;
+    char options[64] = "";
+    if (specialize) {
+        snprintf(options, sizeof(options), "-DSORT_SIZE=%d", ARRAY_SIZE);
     }
-    const size_t source_size = strlen(source_str);
 
     ret = clGetPlatformIDs(1, &platform_id, NULL);
     if (ret != CL_SUCCESS) {
@@ -48,7 +303,7 @@ int main() {
         return 1;
     }
 
-    ret = clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_GPU, 1, &device_id, NULL);
+    ret = clGetDeviceIDs(platform_id, DEVICE_TYPE, 1, &device_id, NULL);
     if (ret != CL_SUCCESS) {
         fprintf(stderr, "clGetDeviceIDs hiba: %d\n", ret);
         return 1;
@@ -78,26 +333,47 @@ int main() {
         return 1;
     }
 
-    program = clCreateProgramWithSource(context, 1, (const char**)&source_str, &source_size, &ret);
+    KernelCache cache;
+    ret = kernel_cache_init(&cache, context, device_id, "randomsort.cl", NULL, 2, ".kernel_cache");
     if (ret != CL_SUCCESS) {
-        fprintf(stderr, "clCreateProgramWithSource hiba: %d\n", ret);
+        fprintf(stderr, "Nem sikerült betölteni a kernelt!\n");
         return 1;
     }
 
-    ret = clBuildProgram(program, 1, &device_id, NULL, NULL, NULL);
+    double compile_ms;
+    program = kernel_cache_get(&cache, options, &compile_ms, &ret);
     if (ret != CL_SUCCESS) {
-        size_t log_size;
-        clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
-
-        char *log = (char *) malloc(log_size);
-        clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
-
         fprintf(stderr, "clBuildProgram hiba: %d\n", ret);
-        fprintf(stderr, "Build log:\n%s\n", log);
-        free(log);
-
         return 1;
     }
+    printf("Program (%s): %.1f ms forditas/betoltes\n", specialize ? options : "altalanos", compile_ms);
+
+    if (topk) {
+        SelectionContext selection;
+        int result = 1;
+        if (selection_init(&selection, context, device_id, queue, program) == CL_SUCCESS) {
+            result = runTopKBenchmark(context, queue, &selection);
+        }
+        selection_release(&selection);
+        clReleaseMemObject(input_mem);
+        clReleaseMemObject(result_flag);
+        kernel_cache_release(&cache);
+        clReleaseCommandQueue(queue);
+        clReleaseContext(context);
+        return result;
+    }
+
+    if (specialize) {
+        if (compareSpecialized(&cache, options, queue, input_mem, result_flag, data) != 0) {
+            return 1;
+        }
+        // Az osszevetes rendezte a tombot, a bemutato futas az eredetivel indul.
+        ret = clEnqueueWriteBuffer(queue, input_mem, CL_TRUE, 0, sizeof(int) * ARRAY_SIZE, data, 0, NULL, NULL);
+        if (ret != CL_SUCCESS) {
+            fprintf(stderr, "clEnqueueWriteBuffer hiba: %d\n", ret);
+            return 1;
+        }
+    }
 
     kernel = clCreateKernel(program, "random_sort", &ret);
     if (ret != CL_SUCCESS) {
@@ -172,11 +448,10 @@ int main() {
     clReleaseMemObject(input_mem);
     clReleaseMemObject(result_flag);
     clReleaseKernel(kernel);
-    clReleaseProgram(program);
+    kernel_cache_release(&cache);
     clReleaseCommandQueue(queue);
     clReleaseContext(context);
     clReleaseEvent(event);
-    free(source_str);
 
     return 0;
 }
\ No newline at end of file
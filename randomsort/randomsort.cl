@@ -3,20 +3,42 @@ uint rand_custom(uint* seed) {
     return *seed;
 }
 
-__kernel void random_sort(__global int* input, __global atomic_int* success_flag, const int size) {
+// SORT_SIZE megadasakor a tomb merete forditasi ideju konstans: a ciklusok
+// kigorgethetok, es a lokalis tomb pontosan akkora, amekkora kell.
+#ifdef SORT_SIZE
+#define LOCAL_CAPACITY SORT_SIZE
+#define SIZE SORT_SIZE
+#else
+#define LOCAL_CAPACITY 64
+#define SIZE size
+#endif
+
+// COUNT_ROUNDS megadasakor a kernel egy negyedik argumentumban osszegzi, hany
+// keveresi kort futtattak a szalak (a roofline meres ebbol szamolja a muveleteket).
+#ifdef COUNT_ROUNDS
+#define ROUNDS_ARG , __global atomic_int* rounds
+#define ADD_ROUNDS() atomic_fetch_add_explicit(rounds, round_count, memory_order_relaxed)
+#else
+#define ROUNDS_ARG
+#define ADD_ROUNDS()
+#endif
+
+__kernel void random_sort(__global int* input, __global atomic_int* success_flag, const int size ROUNDS_ARG) {
     int id = get_global_id(0);
 
     uint seed = (uint)(id + 1) * 123456789;
+    int round_count = 0;
 
-    int local_data[64];
-    if (size > 64) return;
+    int local_data[LOCAL_CAPACITY];
+    if (size > LOCAL_CAPACITY || size != SIZE) return;
 
-    for (int i = 0; i < size; i++) {
+    for (int i = 0; i < SIZE; i++) {
         local_data[i] = input[i];
     }
 
     while (atomic_load(success_flag) == 0) {
-        for (int i = size - 1; i > 0; i--) {
+        round_count++;
+        for (int i = SIZE - 1; i > 0; i--) {
             int j = rand_custom(&seed) % (i + 1);
             int temp = local_data[i];
             local_data[i] = local_data[j];
@@ -24,7 +46,7 @@ __kernel void random_sort(__global int* input, __global atomic_int* success_flag
         }
 
         int sorted = 1;
-        for (int i = 1; i < size; i++) {
+        for (int i = 1; i < SIZE; i++) {
             if (local_data[i-1] > local_data[i]) {
                 sorted = 0;
                 break;
@@ -33,10 +55,258 @@ __kernel void random_sort(__global int* input, __global atomic_int* success_flag
 
         if (sorted) {
             atomic_store(success_flag, 1);
-            for (int i = 0; i < size; i++) {
+            for (int i = 0; i < SIZE; i++) {
                 input[i] = local_data[i];
             }
-            return;
+            break;
+        }
+    }
+    ADD_ROUNDS();
+}
+
+// Egy bitonikus lepes (k: a rendezett blokkok merete, j: az osszehasonlitasi tavolsag).
+// A segment meretu szakaszok egymastol fuggetlenul, mind novekvo sorrendbe rendezodnek,
+// igy tobb kulon tomb is rendezheto egyetlen inditassal.
+__kernel void bitonic_sort_step(__global int* data, const int j, const int k, const int segment) {
+    int i = get_global_id(0);
+    int partner = i ^ j;
+
+    if (partner > i) {
+        int up = (k >= segment) || ((i & k) == 0);
+        int a = data[i];
+        int b = data[partner];
+        if ((a > b) == up) {
+            data[i] = b;
+            data[partner] = a;
+        }
+    }
+}
+
+// Kivalasztas (top-k, n-edik elem). A kulcsokat monoton, elojel nelkuli formara
+// alakitjuk, igy az int es float kulcsok, valamint a legnagyobbak keresese is
+// ugyanazzal az elojel nelkuli osszehasonlitassal megy.
+#define SELECT_FLOAT 1
+#define SELECT_LARGEST 2
+#define RADIX_BINS 256
+
+uint ordered_key(uint bits, uint mode) {
+    uint key;
+    if (mode & SELECT_FLOAT) {
+        key = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    } else {
+        key = bits ^ 0x80000000u;
+    }
+    return (mode & SELECT_LARGEST) ? ~key : key;
+}
+
+uint original_key(uint key, uint mode) {
+    if (mode & SELECT_LARGEST) {
+        key = ~key;
+    }
+    if (mode & SELECT_FLOAT) {
+        return (key & 0x80000000u) ? (key ^ 0x80000000u) : ~key;
+    }
+    return key ^ 0x80000000u;
+}
+
+// A jelolt (kulcs << 32 | index), az azonos kulcsok kozul a kisebb index nyer.
+// A kitolto ertek ULONG_MAX, ez minden valodi jeloltnel nagyobb.
+void local_bitonic_sort(__local ulong* a, int size) {
+    int lid = get_local_id(0);
+    int group_size = get_local_size(0);
+
+    for (int k = 2; k <= size; k <<= 1) {
+        for (int j = k >> 1; j > 0; j >>= 1) {
+            for (int p = lid; p < size / 2; p += group_size) {
+                int i = 2 * p - (p & (j - 1));
+                int up = (i & k) == 0;
+                ulong x = a[i];
+                ulong y = a[i + j];
+                if ((x > y) == up) {
+                    a[i] = y;
+                    a[i + j] = x;
+                }
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+    }
+}
+
+// Bitonikus sorozat novekvo sorrendbe fesulese.
+void local_bitonic_merge(__local ulong* a, int size) {
+    int lid = get_local_id(0);
+    int group_size = get_local_size(0);
+
+    for (int j = size >> 1; j > 0; j >>= 1) {
+        for (int p = lid; p < size / 2; p += group_size) {
+            int i = 2 * p - (p & (j - 1));
+            ulong x = a[i];
+            ulong y = a[i + j];
+            if (x > y) {
+                a[i] = y;
+                a[i + j] = x;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+// Minden munkacsoport a sajat chunk meretu szakaszanak tile legkisebb jeloltjet
+// tartja a lokalis memoriaban (best, novekvo sorrendben). Az uj tile elemei kozul
+// csak a jelenlegi kuszobnel (best[tile - 1]) kisebbek maradnak meg; ha egy sem,
+// a tile kimarad. Kulonben a tile rendezese utan a ket sorozat elemenkenti
+// minimuma (best[t], tile[tile - 1 - t]) bitonikus, es pontosan a tile legkisebb
+// elemet tartalmazza, amit egy bitonikus fesules rendez vissza.
+// packed == 0: nyers kulcsok a keys-ben, packed == 1: egy korabbi kor jeloltjei.
+__kernel void top_k_tiles(__global const uint* keys, __global const ulong* packed_input, const int packed,
+                          const int n, const uint mode, const int tile, const int chunk,
+                          __global ulong* candidates, __local ulong* best, __local ulong* tile_data) {
+    __local int survivors;
+    int lid = get_local_id(0);
+    int group_size = get_local_size(0);
+    int group = get_group_id(0);
+    int begin = group * chunk;
+    int end = min(begin + chunk, n);
+
+    for (int t = lid; t < tile; t += group_size) {
+        best[t] = ULONG_MAX;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int base = begin; base < end; base += tile) {
+        ulong threshold = best[tile - 1];
+        if (lid == 0) {
+            survivors = 0;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int t = lid; t < tile; t += group_size) {
+            int pos = base + t;
+            ulong value = ULONG_MAX;
+            if (pos < end) {
+                value = packed ? packed_input[pos] : ((ulong)ordered_key(keys[pos], mode) << 32) | (uint)pos;
+            }
+            if (value < threshold) {
+                atomic_inc(&survivors);
+            } else {
+                value = ULONG_MAX;
+            }
+            tile_data[t] = value;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        int any = survivors;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (any == 0) {
+            continue;
+        }
+
+        local_bitonic_sort(tile_data, tile);
+        for (int t = lid; t < tile; t += group_size) {
+            ulong value = tile_data[tile - 1 - t];
+            if (value < best[t]) {
+                best[t] = value;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        local_bitonic_merge(best, tile);
+    }
+
+    for (int t = lid; t < tile; t += group_size) {
+        candidates[(size_t)group * tile + t] = best[t];
+    }
+}
+
+__kernel void top_k_unpack(__global const ulong* candidates, const int k, const uint mode,
+                           __global uint* out_keys, __global uint* out_indices, const int with_indices) {
+    int i = get_global_id(0);
+    if (i >= k) return;
+
+    ulong value = candidates[i];
+    out_keys[i] = original_key((uint)(value >> 32), mode);
+    if (with_indices) {
+        out_indices[i] = (uint)value;
+    }
+}
+
+// A radix-select egy 8 bites lepese: a prefix-szel egyezo kulcsok kovetkezo
+// szamjegyenek hisztogramja (lokalis hisztogram, csoportonkent egy atomikus osszeadas).
+__kernel void radix_select_histogram(__global const uint* keys, const int n, const uint mode,
+                                     const uint prefix, const uint prefix_mask, const int shift,
+                                     __global uint* histogram) {
+    __local uint local_histogram[RADIX_BINS];
+    int lid = get_local_id(0);
+    int group_size = get_local_size(0);
+
+    for (int b = lid; b < RADIX_BINS; b += group_size) {
+        local_histogram[b] = 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int i = get_global_id(0); i < n; i += get_global_size(0)) {
+        uint key = ordered_key(keys[i], mode);
+        if ((key & prefix_mask) == prefix) {
+            atomic_inc(&local_histogram[(key >> shift) & (RADIX_BINS - 1)]);
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int b = lid; b < RADIX_BINS; b += group_size) {
+        if (local_histogram[b] > 0) {
+            atomic_add(&histogram[b], local_histogram[b]);
+        }
+    }
+}
+
+// Kuszob szerinti szures: a threshold alatti kulcsok mind, a vele egyenlok kozul
+// az elso equal_count kerul a kimenetbe (sorrend nelkul). A helyeket csoportonkent
+// egy-egy globalis atomikus muvelet foglalja le.
+__kernel void select_filter(__global const uint* keys, const int n, const uint mode,
+                            const uint threshold, const int less_count, const int equal_count,
+                            __global uint* counters, __global uint* out_keys, __global uint* out_indices,
+                            const int with_indices) {
+    __local uint local_less, local_equal, base_less, base_equal;
+    int lid = get_local_id(0);
+    int group_size = get_local_size(0);
+
+    for (int base = get_group_id(0) * group_size; base < n; base += get_global_size(0)) {
+        int i = base + lid;
+        uint key = i < n ? ordered_key(keys[i], mode) : 0xffffffffu;
+        if (lid == 0) {
+            local_less = 0;
+            local_equal = 0;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        int slot = -1;
+        int equal = 0;
+        if (i < n && key < threshold) {
+            slot = atomic_inc(&local_less);
+        } else if (i < n && key == threshold) {
+            slot = atomic_inc(&local_equal);
+            equal = 1;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if (lid == 0) {
+            base_less = local_less > 0 ? atomic_add(&counters[0], local_less) : 0;
+            base_equal = local_equal > 0 ? atomic_add(&counters[1], local_equal) : 0;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if (slot >= 0) {
+            int pos = -1;
+            if (!equal) {
+                pos = base_less + slot;
+            } else if (base_equal + slot < (uint)equal_count) {
+                pos = less_count + base_equal + slot;
+            }
+            if (pos >= 0) {
+                out_keys[pos] = original_key(key, mode);
+                if (with_indices) {
+                    out_indices[pos] = i;
+                }
+            }
         }
+        barrier(CLK_LOCAL_MEM_FENCE);
     }
-}
\ No newline at end of file
+}
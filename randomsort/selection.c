@@ -0,0 +1,347 @@
+#include "selection.h"
+
+#include <stdio.h>
+
+#define SELECT_FLOAT_MODE 1
+#define SELECT_LARGEST_MODE 2
+#define RADIX_BINS 256
+
+static cl_kernel create_kernel(cl_program program, const char* name, cl_int* err)
+{
+    cl_kernel kernel = clCreateKernel(program, name, err);
+    if (*err != CL_SUCCESS) {
+        fprintf(stderr, "clCreateKernel (%s) hiba: %d\n", name, *err);
+    }
+    return kernel;
+}
+
+cl_int selection_init(SelectionContext* ctx, cl_context context, cl_device_id device_id,
+                      cl_command_queue queue, cl_program program)
+{
+    cl_int err;
+    cl_uint compute_units = 1;
+    size_t kernel_group_size = SELECTION_GROUP_SIZE;
+
+    ctx->context = context;
+    ctx->queue = queue;
+    ctx->kernel_tiles = NULL;
+    ctx->kernel_unpack = NULL;
+    ctx->kernel_histogram = NULL;
+    ctx->kernel_filter = NULL;
+    ctx->kernel_sort_step = NULL;
+
+    if ((ctx->kernel_tiles = create_kernel(program, "top_k_tiles", &err)) == NULL
+        || (ctx->kernel_unpack = create_kernel(program, "top_k_unpack", &err)) == NULL
+        || (ctx->kernel_histogram = create_kernel(program, "radix_select_histogram", &err)) == NULL
+        || (ctx->kernel_filter = create_kernel(program, "select_filter", &err)) == NULL
+        || (ctx->kernel_sort_step = create_kernel(program, "bitonic_sort_step", &err)) == NULL) {
+        return err;
+    }
+
+    // A csoportmeretet a legszigorubb kernel korlatja hatarozza meg.
+    ctx->group_size = SELECTION_GROUP_SIZE;
+    cl_kernel kernels[3] = {ctx->kernel_tiles, ctx->kernel_histogram, ctx->kernel_filter};
+    for (int i = 0; i < 3; i++) {
+        if (clGetKernelWorkGroupInfo(kernels[i], device_id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t),
+                                     &kernel_group_size, NULL) == CL_SUCCESS
+            && kernel_group_size < ctx->group_size) {
+            ctx->group_size = kernel_group_size;
+        }
+    }
+    clGetDeviceInfo(device_id, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &compute_units, NULL);
+    ctx->max_groups = (size_t)compute_units * 8;
+    return CL_SUCCESS;
+}
+
+void selection_release(SelectionContext* ctx)
+{
+    cl_kernel kernels[5] = {ctx->kernel_tiles, ctx->kernel_unpack, ctx->kernel_histogram,
+                            ctx->kernel_filter, ctx->kernel_sort_step};
+    for (int i = 0; i < 5; i++) {
+        if (kernels[i] != NULL) {
+            clReleaseKernel(kernels[i]);
+        }
+    }
+}
+
+static cl_uint key_mode(SelectionKeyType type, int largest)
+{
+    return (type == SELECTION_FLOAT ? SELECT_FLOAT_MODE : 0) | (largest ? SELECT_LARGEST_MODE : 0);
+}
+
+// A kernelbeli original_key parja.
+static cl_uint original_key(cl_uint key, cl_uint mode)
+{
+    if (mode & SELECT_LARGEST_MODE) {
+        key = ~key;
+    }
+    if (mode & SELECT_FLOAT_MODE) {
+        return (key & 0x80000000u) ? (key ^ 0x80000000u) : ~key;
+    }
+    return key ^ 0x80000000u;
+}
+
+// Racson atfuto (grid-stride) kernelek globalis merete.
+static size_t stride_global_size(const SelectionContext* ctx, int n)
+{
+    size_t groups = ((size_t)n + ctx->group_size - 1) / ctx->group_size;
+    if (groups > ctx->max_groups) {
+        groups = ctx->max_groups;
+    }
+    return (groups > 0 ? groups : 1) * ctx->group_size;
+}
+
+static cl_int run_tiles(SelectionContext* ctx, cl_mem keys, cl_mem input, int packed, int n, cl_uint mode,
+                        int tile, int* groups, cl_mem* candidates)
+{
+    cl_kernel kernel = ctx->kernel_tiles;
+    cl_int err;
+    int per_group = tile * SELECTION_TILES_PER_GROUP;
+
+    *groups = (n + per_group - 1) / per_group;
+    int chunk = (n + *groups - 1) / *groups;
+    chunk = (chunk + tile - 1) / tile * tile;
+    *groups = (n + chunk - 1) / chunk;
+
+    *candidates = clCreateBuffer(ctx->context, CL_MEM_READ_WRITE, sizeof(cl_ulong) * (size_t)*groups * tile, NULL, &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "clCreateBuffer (candidates) hiba: %d\n", err);
+        return err;
+    }
+
+    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &keys);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernel, 2, sizeof(int), &packed);
+    err |= clSetKernelArg(kernel, 3, sizeof(int), &n);
+    err |= clSetKernelArg(kernel, 4, sizeof(cl_uint), &mode);
+    err |= clSetKernelArg(kernel, 5, sizeof(int), &tile);
+    err |= clSetKernelArg(kernel, 6, sizeof(int), &chunk);
+    err |= clSetKernelArg(kernel, 7, sizeof(cl_mem), candidates);
+    err |= clSetKernelArg(kernel, 8, sizeof(cl_ulong) * tile, NULL);
+    err |= clSetKernelArg(kernel, 9, sizeof(cl_ulong) * tile, NULL);
+
+    size_t local_size[1] = {ctx->group_size};
+    size_t global_size[1] = {(size_t)*groups * ctx->group_size};
+    if (err == CL_SUCCESS) {
+        err = clEnqueueNDRangeKernel(ctx->queue, kernel, 1, NULL, global_size, local_size, 0, NULL, NULL);
+    }
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "top_k_tiles hiba: %d\n", err);
+        clReleaseMemObject(*candidates);
+        *candidates = NULL;
+    }
+    return err;
+}
+
+static cl_int bitonic_top_k(SelectionContext* ctx, cl_mem keys, int n, cl_uint mode, int k,
+                            cl_mem out_keys, cl_mem out_indices)
+{
+    int tile = SELECTION_MIN_TILE;
+    while (tile < k) {
+        tile <<= 1;
+    }
+
+    // Minden kor a csoportonkenti tile legjobb jeloltjet adja tovabb, amig egy csoport marad.
+    int groups;
+    cl_mem candidates;
+    cl_int err = run_tiles(ctx, keys, keys, 0, n, mode, tile, &groups, &candidates);
+    while (err == CL_SUCCESS && groups > 1) {
+        cl_mem next;
+        err = run_tiles(ctx, keys, candidates, 1, groups * tile, mode, tile, &groups, &next);
+        clReleaseMemObject(candidates);
+        candidates = next;
+    }
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    cl_kernel kernel = ctx->kernel_unpack;
+    int with_indices = out_indices != NULL;
+    cl_mem indices = with_indices ? out_indices : out_keys;
+    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &candidates);
+    err |= clSetKernelArg(kernel, 1, sizeof(int), &k);
+    err |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &mode);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &out_keys);
+    err |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &indices);
+    err |= clSetKernelArg(kernel, 5, sizeof(int), &with_indices);
+
+    size_t local_size[1] = {ctx->group_size};
+    size_t global_size[1] = {((size_t)k + ctx->group_size - 1) / ctx->group_size * ctx->group_size};
+    if (err == CL_SUCCESS) {
+        err = clEnqueueNDRangeKernel(ctx->queue, kernel, 1, NULL, global_size, local_size, 0, NULL, NULL);
+    }
+    clFinish(ctx->queue);
+    clReleaseMemObject(candidates);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "top_k_unpack hiba: %d\n", err);
+    }
+    return err;
+}
+
+/**
+ * rank: 0 based position in the ascending order of the ordered keys
+ * threshold: The ordered key at that position
+ * equal_before: Number of keys equal to threshold that precede it (0 <= equal_before <= rank)
+ */
+static cl_int radix_select(SelectionContext* ctx, cl_mem keys, int n, cl_uint mode, int rank,
+                           cl_uint* threshold, int* equal_before)
+{
+    cl_kernel kernel = ctx->kernel_histogram;
+    cl_uint histogram[RADIX_BINS];
+    cl_uint prefix = 0;
+    cl_uint prefix_mask = 0;
+    cl_uint zero = 0;
+    cl_int err;
+
+    cl_mem histogram_mem = clCreateBuffer(ctx->context, CL_MEM_READ_WRITE, sizeof(histogram), NULL, &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "clCreateBuffer (histogram) hiba: %d\n", err);
+        return err;
+    }
+
+    size_t local_size[1] = {ctx->group_size};
+    size_t global_size[1] = {stride_global_size(ctx, n)};
+
+    // 8 bites szamjegyenkent a legfelsotol: a rank helyet tartalmazo kosar szukiti a prefixet.
+    for (int shift = 24; shift >= 0 && err == CL_SUCCESS; shift -= 8) {
+        err = clEnqueueFillBuffer(ctx->queue, histogram_mem, &zero, sizeof(zero), 0, sizeof(histogram), 0, NULL, NULL);
+        err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &keys);
+        err |= clSetKernelArg(kernel, 1, sizeof(int), &n);
+        err |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &mode);
+        err |= clSetKernelArg(kernel, 3, sizeof(cl_uint), &prefix);
+        err |= clSetKernelArg(kernel, 4, sizeof(cl_uint), &prefix_mask);
+        err |= clSetKernelArg(kernel, 5, sizeof(int), &shift);
+        err |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &histogram_mem);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueNDRangeKernel(ctx->queue, kernel, 1, NULL, global_size, local_size, 0, NULL, NULL);
+        }
+        if (err == CL_SUCCESS) {
+            err = clEnqueueReadBuffer(ctx->queue, histogram_mem, CL_TRUE, 0, sizeof(histogram), histogram, 0, NULL, NULL);
+        }
+        if (err != CL_SUCCESS) {
+            break;
+        }
+
+        int digit = 0;
+        while (digit < RADIX_BINS - 1 && (cl_uint)rank >= histogram[digit]) {
+            rank -= histogram[digit];
+            digit++;
+        }
+        prefix |= (cl_uint)digit << shift;
+        prefix_mask |= 0xffu << shift;
+    }
+
+    clReleaseMemObject(histogram_mem);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "radix_select_histogram hiba: %d\n", err);
+        return err;
+    }
+    *threshold = prefix;
+    *equal_before = rank;
+    return CL_SUCCESS;
+}
+
+static cl_int radix_top_k(SelectionContext* ctx, cl_mem keys, int n, cl_uint mode, int k,
+                          cl_mem out_keys, cl_mem out_indices)
+{
+    cl_kernel kernel = ctx->kernel_filter;
+    cl_uint threshold;
+    cl_uint zero = 0;
+    int equal_before;
+
+    cl_int err = radix_select(ctx, keys, n, mode, k - 1, &threshold, &equal_before);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    int equal_count = equal_before + 1;
+    int less_count = k - equal_count;
+
+    cl_mem counters = clCreateBuffer(ctx->context, CL_MEM_READ_WRITE, 2 * sizeof(cl_uint), NULL, &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "clCreateBuffer (counters) hiba: %d\n", err);
+        return err;
+    }
+
+    int with_indices = out_indices != NULL;
+    cl_mem indices = with_indices ? out_indices : out_keys;
+    err = clEnqueueFillBuffer(ctx->queue, counters, &zero, sizeof(zero), 0, 2 * sizeof(cl_uint), 0, NULL, NULL);
+    err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &keys);
+    err |= clSetKernelArg(kernel, 1, sizeof(int), &n);
+    err |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &mode);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_uint), &threshold);
+    err |= clSetKernelArg(kernel, 4, sizeof(int), &less_count);
+    err |= clSetKernelArg(kernel, 5, sizeof(int), &equal_count);
+    err |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &counters);
+    err |= clSetKernelArg(kernel, 7, sizeof(cl_mem), &out_keys);
+    err |= clSetKernelArg(kernel, 8, sizeof(cl_mem), &indices);
+    err |= clSetKernelArg(kernel, 9, sizeof(int), &with_indices);
+
+    size_t local_size[1] = {ctx->group_size};
+    size_t global_size[1] = {stride_global_size(ctx, n)};
+    if (err == CL_SUCCESS) {
+        err = clEnqueueNDRangeKernel(ctx->queue, kernel, 1, NULL, global_size, local_size, 0, NULL, NULL);
+    }
+    clFinish(ctx->queue);
+    clReleaseMemObject(counters);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "select_filter hiba: %d\n", err);
+    }
+    return err;
+}
+
+cl_int select_top_k(SelectionContext* ctx, cl_mem keys, int n, SelectionKeyType type, int largest, int k,
+                    cl_mem out_keys, cl_mem out_indices)
+{
+    if (k < 1 || k > n) {
+        return CL_INVALID_VALUE;
+    }
+    cl_uint mode = key_mode(type, largest);
+    if (k <= SELECTION_BITONIC_MAX_K) {
+        return bitonic_top_k(ctx, keys, n, mode, k, out_keys, out_indices);
+    }
+    return radix_top_k(ctx, keys, n, mode, k, out_keys, out_indices);
+}
+
+cl_int select_nth(SelectionContext* ctx, cl_mem keys, int n, SelectionKeyType type, int nth, cl_uint* value)
+{
+    cl_uint mode = key_mode(type, 0);
+    cl_uint threshold;
+    int equal_before;
+
+    if (nth < 0 || nth >= n) {
+        return CL_INVALID_VALUE;
+    }
+    cl_int err = radix_select(ctx, keys, n, mode, nth, &threshold, &equal_before);
+    if (err == CL_SUCCESS) {
+        *value = original_key(threshold, mode);
+    }
+    return err;
+}
+
+cl_int selection_full_sort(SelectionContext* ctx, cl_mem keys, int n)
+{
+    cl_kernel kernel = ctx->kernel_sort_step;
+    cl_int err = CL_SUCCESS;
+
+    if (n < 1 || (n & (n - 1)) != 0) {
+        return CL_INVALID_VALUE;
+    }
+
+    size_t global_size[1] = {(size_t)n};
+    err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &keys);
+    err |= clSetKernelArg(kernel, 3, sizeof(int), &n);
+    for (int k = 2; k <= n && err == CL_SUCCESS; k <<= 1) {
+        for (int j = k >> 1; j > 0 && err == CL_SUCCESS; j >>= 1) {
+            err = clSetKernelArg(kernel, 1, sizeof(int), &j);
+            err |= clSetKernelArg(kernel, 2, sizeof(int), &k);
+            if (err == CL_SUCCESS) {
+                err = clEnqueueNDRangeKernel(ctx->queue, kernel, 1, NULL, global_size, NULL, 0, NULL, NULL);
+            }
+        }
+    }
+    clFinish(ctx->queue);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "bitonic_sort_step hiba: %d\n", err);
+    }
+    return err;
+}
@@ -0,0 +1,72 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+#define SELECTION_GROUP_SIZE 256
+
+/**
+ * Up to this k the top-k is kept in local memory (bitonic tiles of
+ * next_pow2(k) candidates) and the result is sorted. Above it the k-th key
+ * is found by radix-select and the result is filtered in no particular order.
+ */
+#define SELECTION_BITONIC_MAX_K 1024
+#define SELECTION_MIN_TILE 256
+
+/**
+ * Number of tiles one work-group scans in a round of the bitonic top-k,
+ * so every round shrinks the candidates by this factor.
+ */
+#define SELECTION_TILES_PER_GROUP 16
+
+typedef enum {
+    SELECTION_INT = 0,
+    SELECTION_FLOAT = 1
+} SelectionKeyType;
+
+typedef struct {
+    cl_context context;
+    cl_command_queue queue;
+    cl_kernel kernel_tiles;
+    cl_kernel kernel_unpack;
+    cl_kernel kernel_histogram;
+    cl_kernel kernel_filter;
+    cl_kernel kernel_sort_step;
+    size_t group_size;
+    size_t max_groups;
+} SelectionContext;
+
+/**
+ * program: Built from randomsort.cl
+ */
+cl_int selection_init(SelectionContext* ctx, cl_context context, cl_device_id device_id,
+                      cl_command_queue queue, cl_program program);
+
+void selection_release(SelectionContext* ctx);
+
+/**
+ * The k smallest (largest != 0: largest) of n 32 bit int or float keys.
+ *
+ * out_keys: k keys, sorted when k <= SELECTION_BITONIC_MAX_K
+ * out_indices: Positions of the keys in the input (may be NULL)
+ *
+ * Returns CL_INVALID_VALUE unless 1 <= k <= n
+ */
+cl_int select_top_k(SelectionContext* ctx, cl_mem keys, int n, SelectionKeyType type, int largest, int k,
+                    cl_mem out_keys, cl_mem out_indices);
+
+/**
+ * The key that would be at position nth (0 based) of the ascending order.
+ *
+ * value: Bits of the int or float key
+ */
+cl_int select_nth(SelectionContext* ctx, cl_mem keys, int n, SelectionKeyType type, int nth, cl_uint* value);
+
+/**
+ * Full ascending sort of n int keys in place with the bitonic_sort_step
+ * kernel (n has to be a power of two). The baseline of the selections.
+ */
+cl_int selection_full_sort(SelectionContext* ctx, cl_mem keys, int n);
+
+#endif
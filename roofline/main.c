@@ -0,0 +1,327 @@
+#include "gemm.h"
+#include "roofline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VECTOR_SIZE (1 << 24)
+#define MATRIX_N 1024
+#define TEXT_SIZE (1 << 24)
+#define HISTOGRAM_GROUP_SIZE 256
+#define SORT_SIZE 8
+#define SORT_THREADS 4096
+// Operations of one random_sort round: SORT_SIZE - 1 swaps with an LCG step
+// (multiply, add), a modulo and an index increment, plus the first
+// comparisons of the sortedness check, which usually stops early.
+#define SORT_ROUND_OPS (4.0 * (SORT_SIZE - 1) + 2.0)
+#define MAX_KERNELS 8
+
+typedef struct {
+    GemmContext gemm;
+    cl_program vector_program;
+    cl_program huffman_program;
+    cl_program sort_program;
+} Programs;
+
+static cl_mem create_filled(GemmContext* ctx, size_t bytes, const void* pattern, size_t pattern_size, cl_int* err)
+{
+    cl_mem buffer = clCreateBuffer(ctx->context, CL_MEM_READ_WRITE, bytes, NULL, err);
+    if (*err != CL_SUCCESS) {
+        printf("[ERROR] Error creating a buffer of %zu bytes. Error code: %d\n", bytes, *err);
+        return NULL;
+    }
+    *err = clEnqueueFillBuffer(ctx->command_queue, buffer, pattern, pattern_size, 0, bytes, 0, NULL, NULL);
+    return buffer;
+}
+
+// C = A + B, one float load per operand and one store per element
+static cl_int measure_vector(Programs* programs, RooflineKernel* result)
+{
+    GemmContext* ctx = &programs->gemm;
+    size_t n = VECTOR_SIZE;
+    float one = 1.0f;
+    cl_int err;
+
+    cl_kernel kernel = clCreateKernel(programs->vector_program, "sample_kernel", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    cl_mem A = create_filled(ctx, sizeof(float) * n, &one, sizeof(one), &err);
+    cl_mem B = err == CL_SUCCESS ? create_filled(ctx, sizeof(float) * n, &one, sizeof(one), &err) : NULL;
+    cl_mem C = err == CL_SUCCESS ? create_filled(ctx, sizeof(float) * n, &one, sizeof(one), &err) : NULL;
+    if (err == CL_SUCCESS) {
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), &A);
+        clSetKernelArg(kernel, 1, sizeof(cl_mem), &B);
+        clSetKernelArg(kernel, 2, sizeof(cl_mem), &C);
+        err = roofline_time_kernel(ctx->command_queue, kernel, 1, &n, NULL, &result->ms);
+    }
+    result->name = "sample_kernel";
+    result->type = ROOFLINE_FLOAT;
+    result->ops = (double)n;
+    result->bytes = 3.0 * sizeof(float) * n;
+
+    if (A != NULL) clReleaseMemObject(A);
+    if (B != NULL) clReleaseMemObject(B);
+    if (C != NULL) clReleaseMemObject(C);
+    clReleaseKernel(kernel);
+    return err;
+}
+
+// Tiled GEMM: every work-item loads one element of A and of B per tile step.
+static cl_int measure_matrix(Programs* programs, RooflineKernel* result)
+{
+    GemmContext* ctx = &programs->gemm;
+    double N = MATRIX_N;
+    int n = MATRIX_N;
+    size_t bytes = sizeof(float) * MATRIX_N * MATRIX_N;
+    size_t global_size[2] = {MATRIX_N, MATRIX_N};
+    size_t local_size[2] = {GEMM_TILE_SIZE, GEMM_TILE_SIZE};
+    float one = 1.0f;
+    cl_int err;
+
+    cl_mem A = create_filled(ctx, bytes, &one, sizeof(one), &err);
+    cl_mem B = err == CL_SUCCESS ? create_filled(ctx, bytes, &one, sizeof(one), &err) : NULL;
+    cl_mem C = err == CL_SUCCESS ? create_filled(ctx, bytes, &one, sizeof(one), &err) : NULL;
+    if (err == CL_SUCCESS) {
+        clSetKernelArg(ctx->kernel_fp32, 0, sizeof(cl_mem), &A);
+        clSetKernelArg(ctx->kernel_fp32, 1, sizeof(cl_mem), &B);
+        clSetKernelArg(ctx->kernel_fp32, 2, sizeof(cl_mem), &C);
+        clSetKernelArg(ctx->kernel_fp32, 3, sizeof(int), &n);
+        err = roofline_time_kernel(ctx->command_queue, ctx->kernel_fp32, 2, global_size, local_size, &result->ms);
+    }
+    result->name = "matrix";
+    result->type = ROOFLINE_FLOAT;
+    result->ops = 2.0 * N * N * N;
+    result->bytes = sizeof(float) * (2.0 * N * N * (N / GEMM_TILE_SIZE) + N * N);
+
+    if (A != NULL) clReleaseMemObject(A);
+    if (B != NULL) clReleaseMemObject(B);
+    if (C != NULL) clReleaseMemObject(C);
+    return err;
+}
+
+// Huffman kernels on A-Z text: one byte in and one atomic increment
+// (read-modify-write of an int) per character for the histogram, one byte
+// in, a code table lookup and an int out per character for the encoding.
+static cl_int measure_huffman(Programs* programs, RooflineKernel* frequencies_result, RooflineKernel* encode_result)
+{
+    GemmContext* ctx = &programs->gemm;
+    size_t n = TEXT_SIZE;
+    size_t histogram_size = (n + HISTOGRAM_GROUP_SIZE - 1) / HISTOGRAM_GROUP_SIZE * HISTOGRAM_GROUP_SIZE;
+    size_t histogram_local = HISTOGRAM_GROUP_SIZE;
+    int input_size = TEXT_SIZE;
+    int codes[256];
+    unsigned char lengths[256];
+    int zero = 0;
+    cl_int err;
+
+    unsigned char* text = (unsigned char*)malloc(n);
+    if (text == NULL) {
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    for (size_t i = 0; i < n; i++) {
+        text[i] = (unsigned char)('A' + rand() % 26);
+    }
+    for (int s = 0; s < 256; s++) {
+        codes[s] = s;
+        lengths[s] = 8;
+    }
+
+    cl_kernel frequencies_kernel = clCreateKernel(programs->huffman_program, "calculate_frequencies", &err);
+    cl_kernel encode_kernel = err == CL_SUCCESS ? clCreateKernel(programs->huffman_program, "encode_input", &err) : NULL;
+    cl_mem input = err == CL_SUCCESS
+        ? clCreateBuffer(ctx->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, n, text, &err) : NULL;
+    cl_mem frequencies = err == CL_SUCCESS ? create_filled(ctx, sizeof(int) * 256, &zero, sizeof(zero), &err) : NULL;
+    cl_mem codes_buffer = err == CL_SUCCESS
+        ? clCreateBuffer(ctx->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(codes), codes, &err) : NULL;
+    cl_mem lengths_buffer = err == CL_SUCCESS
+        ? clCreateBuffer(ctx->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(lengths), lengths, &err) : NULL;
+    cl_mem encoded = err == CL_SUCCESS ? create_filled(ctx, sizeof(int) * n, &zero, sizeof(zero), &err) : NULL;
+
+    if (err == CL_SUCCESS) {
+        clSetKernelArg(frequencies_kernel, 0, sizeof(cl_mem), &input);
+        clSetKernelArg(frequencies_kernel, 1, sizeof(cl_mem), &frequencies);
+        clSetKernelArg(frequencies_kernel, 2, sizeof(int), &input_size);
+        err = roofline_time_kernel(ctx->command_queue, frequencies_kernel, 1, &histogram_size, &histogram_local,
+                                   &frequencies_result->ms);
+    }
+    if (err == CL_SUCCESS) {
+        clSetKernelArg(encode_kernel, 0, sizeof(cl_mem), &input);
+        clSetKernelArg(encode_kernel, 1, sizeof(cl_mem), &codes_buffer);
+        clSetKernelArg(encode_kernel, 2, sizeof(cl_mem), &lengths_buffer);
+        clSetKernelArg(encode_kernel, 3, sizeof(cl_mem), &encoded);
+        clSetKernelArg(encode_kernel, 4, sizeof(int), &input_size);
+        err = roofline_time_kernel(ctx->command_queue, encode_kernel, 1, &n, NULL, &encode_result->ms);
+    }
+    frequencies_result->name = "calculate_frequencies";
+    frequencies_result->type = ROOFLINE_INT;
+    frequencies_result->ops = (double)n;
+    frequencies_result->bytes = (1.0 + 2.0 * sizeof(int)) * n;
+    encode_result->name = "encode_input";
+    encode_result->type = ROOFLINE_INT;
+    encode_result->ops = (double)n;
+    encode_result->bytes = (1.0 + 2.0 * sizeof(int)) * n;
+
+    if (input != NULL) clReleaseMemObject(input);
+    if (frequencies != NULL) clReleaseMemObject(frequencies);
+    if (codes_buffer != NULL) clReleaseMemObject(codes_buffer);
+    if (lengths_buffer != NULL) clReleaseMemObject(lengths_buffer);
+    if (encoded != NULL) clReleaseMemObject(encoded);
+    if (encode_kernel != NULL) clReleaseKernel(encode_kernel);
+    if (frequencies_kernel != NULL) clReleaseKernel(frequencies_kernel);
+    free(text);
+    return err;
+}
+
+// The work of random_sort depends on luck, so it is counted: the program is
+// built with -DCOUNT_ROUNDS and the kernel adds up the shuffle rounds of its
+// work-items. The runs are summed, since every run does a different amount.
+static cl_int measure_sort(Programs* programs, RooflineKernel* result)
+{
+    GemmContext* ctx = &programs->gemm;
+    int data[SORT_SIZE];
+    int size = SORT_SIZE;
+    int zero = 0;
+    size_t global_size = SORT_THREADS;
+    size_t local_size = 1;
+    double rounds_total = 0.0;
+    cl_int err;
+
+    result->name = "random_sort";
+    result->type = ROOFLINE_INT;
+    result->ops = 0.0;
+    result->bytes = 0.0;
+    result->ms = 0.0;
+
+    cl_kernel kernel = clCreateKernel(programs->sort_program, "random_sort", &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    cl_mem input = clCreateBuffer(ctx->context, CL_MEM_READ_WRITE, sizeof(data), NULL, &err);
+    cl_mem flag = err == CL_SUCCESS ? clCreateBuffer(ctx->context, CL_MEM_READ_WRITE, sizeof(int), NULL, &err) : NULL;
+    cl_mem rounds = err == CL_SUCCESS ? clCreateBuffer(ctx->context, CL_MEM_READ_WRITE, sizeof(int), NULL, &err) : NULL;
+    if (err == CL_SUCCESS) {
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+        clSetKernelArg(kernel, 1, sizeof(cl_mem), &flag);
+        clSetKernelArg(kernel, 2, sizeof(int), &size);
+        clSetKernelArg(kernel, 3, sizeof(cl_mem), &rounds);
+    }
+
+    for (int r = 0; r <= ROOFLINE_REPEATS && err == CL_SUCCESS; r++) {
+        cl_event event;
+        int round_count = 0;
+        for (int i = 0; i < SORT_SIZE; i++) {
+            data[i] = SORT_SIZE - i;
+        }
+        clEnqueueWriteBuffer(ctx->command_queue, input, CL_FALSE, 0, sizeof(data), data, 0, NULL, NULL);
+        clEnqueueWriteBuffer(ctx->command_queue, flag, CL_FALSE, 0, sizeof(int), &zero, 0, NULL, NULL);
+        clEnqueueWriteBuffer(ctx->command_queue, rounds, CL_FALSE, 0, sizeof(int), &zero, 0, NULL, NULL);
+        err = clEnqueueNDRangeKernel(ctx->command_queue, kernel, 1, NULL, &global_size, &local_size, 0, NULL, &event);
+        if (err != CL_SUCCESS) {
+            printf("[ERROR] Error calling clEnqueueNDRangeKernel. Error code: %d\n", err);
+            break;
+        }
+        err = clEnqueueReadBuffer(ctx->command_queue, rounds, CL_TRUE, 0, sizeof(int), &round_count, 1, &event, NULL);
+        // The first run is a warm-up like in roofline_time_kernel.
+        if (err == CL_SUCCESS && r > 0) {
+            result->ms += getEventTime(event);
+            rounds_total += round_count;
+        }
+        clReleaseEvent(event);
+    }
+    // Per round the flag is loaded once, every work-item loads the array and the winner stores it.
+    result->ops = rounds_total * SORT_ROUND_OPS;
+    result->bytes = rounds_total * sizeof(int)
+                  + (double)ROOFLINE_REPEATS * (SORT_THREADS + 1) * sizeof(int) * SORT_SIZE;
+
+    if (input != NULL) clReleaseMemObject(input);
+    if (flag != NULL) clReleaseMemObject(flag);
+    if (rounds != NULL) clReleaseMemObject(rounds);
+    clReleaseKernel(kernel);
+    return err;
+}
+
+static cl_int programs_init(Programs* programs)
+{
+    GemmContext* ctx = &programs->gemm;
+    cl_int err;
+
+    memset(programs, 0, sizeof(Programs));
+    err = gemm_init(ctx, "../matrixok/matrix.cl");
+    if (err != CL_SUCCESS) return err;
+    err = roofline_build_program(ctx->context, ctx->device_id, "../vektorok/sample.cl", NULL, &programs->vector_program);
+    if (err != CL_SUCCESS) return err;
+    err = roofline_build_program(ctx->context, ctx->device_id, "../huffman/huffman.cl", NULL, &programs->huffman_program);
+    if (err != CL_SUCCESS) return err;
+    return roofline_build_program(ctx->context, ctx->device_id, "../randomsort/randomsort.cl", "-DCOUNT_ROUNDS",
+                                  &programs->sort_program);
+}
+
+static void programs_release(Programs* programs)
+{
+    if (programs->vector_program) clReleaseProgram(programs->vector_program);
+    if (programs->huffman_program) clReleaseProgram(programs->huffman_program);
+    if (programs->sort_program) clReleaseProgram(programs->sort_program);
+    gemm_release(&programs->gemm);
+}
+
+static void write_output(const char* path, const RooflinePeaks* peaks, const RooflineKernel* kernels, int count,
+                         void (*write)(FILE*, const RooflinePeaks*, const RooflineKernel*, int))
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("[ERROR] Cannot write %s\n", path);
+        return;
+    }
+    write(file, peaks, kernels, count);
+    fclose(file);
+    printf("%s written\n", path);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* prefix = argc > 1 ? argv[1] : "roofline";
+    RooflineKernel kernels[MAX_KERNELS];
+    RooflinePeaks peaks;
+    Programs programs;
+    int count = 0;
+    cl_int err;
+
+    if (programs_init(&programs) != CL_SUCCESS) {
+        programs_release(&programs);
+        return 1;
+    }
+    GemmContext* ctx = &programs.gemm;
+
+    err = roofline_measure_peaks(ctx->context, ctx->device_id, ctx->command_queue, "roofline.cl", &peaks);
+    if (err != CL_SUCCESS) {
+        programs_release(&programs);
+        return 1;
+    }
+
+    memset(kernels, 0, sizeof(kernels));
+    if (measure_vector(&programs, &kernels[count]) == CL_SUCCESS) {
+        count++;
+    }
+    if (measure_matrix(&programs, &kernels[count]) == CL_SUCCESS) {
+        count++;
+    }
+    if (measure_huffman(&programs, &kernels[count], &kernels[count + 1]) == CL_SUCCESS) {
+        count += 2;
+    }
+    if (measure_sort(&programs, &kernels[count]) == CL_SUCCESS) {
+        count++;
+    }
+
+    roofline_print(stdout, &peaks, kernels, count);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s.csv", prefix);
+    write_output(path, &peaks, kernels, count, roofline_write_csv);
+    snprintf(path, sizeof(path), "%s.svg", prefix);
+    write_output(path, &peaks, kernels, count, roofline_write_svg);
+
+    programs_release(&programs);
+    return 0;
+}
@@ -0,0 +1,349 @@
+#include "roofline.h"
+#include "kernel_loader.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PEAK_FLOPS_WORK_ITEMS ((size_t)1 << 20)
+#define PEAK_BANDWIDTH_MAX_BYTES ((size_t)256 * 1024 * 1024)
+// Operations of one peak_flops / peak_iops work-item: 8 chains, 4 lanes, multiply and add.
+#define PEAK_OPS_PER_WORK_ITEM (ROOFLINE_PEAK_ITERATIONS * 8.0 * 4.0 * 2.0)
+
+#define SVG_WIDTH 800
+#define SVG_HEIGHT 520
+#define SVG_LEFT 80
+#define SVG_RIGHT 30
+#define SVG_TOP 40
+#define SVG_BOTTOM 60
+
+cl_int roofline_build_program(cl_context context, cl_device_id device_id, const char* path, const char* options,
+                              cl_program* program)
+{
+    cl_int err;
+    int error_code;
+
+    char* source = load_kernel_source(path, &error_code);
+    if (error_code != 0) {
+        printf("[ERROR] Cannot load the kernel source %s\n", path);
+        return CL_INVALID_VALUE;
+    }
+    *program = clCreateProgramWithSource(context, 1, (const char**)&source, NULL, &err);
+    free(source);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error calling clCreateProgramWithSource. Error code: %d\n", err);
+        return err;
+    }
+
+    err = clBuildProgram(*program, 1, &device_id, options, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        size_t log_size;
+        clGetProgramBuildInfo(*program, device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+        char* log = (char*)malloc(log_size + 1);
+        clGetProgramBuildInfo(*program, device_id, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
+        log[log_size] = 0;
+        printf("[ERROR] %s build log:\n%s\n", path, log);
+        free(log);
+        clReleaseProgram(*program);
+        *program = NULL;
+    }
+    return err;
+}
+
+cl_int roofline_time_kernel(cl_command_queue queue, cl_kernel kernel, cl_uint work_dim, const size_t* global_size,
+                            const size_t* local_size, double* best_ms)
+{
+    *best_ms = 0.0;
+    // The first launch is a warm-up (lazy compilation, page faults), it is not timed.
+    for (int r = 0; r <= ROOFLINE_REPEATS; r++) {
+        cl_event event;
+        cl_ulong start, end;
+        cl_int err = clEnqueueNDRangeKernel(queue, kernel, work_dim, NULL, global_size, local_size, 0, NULL, &event);
+        if (err != CL_SUCCESS) {
+            printf("[ERROR] Error calling clEnqueueNDRangeKernel. Error code: %d\n", err);
+            return err;
+        }
+        clWaitForEvents(1, &event);
+        clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+        clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+        clReleaseEvent(event);
+        double ms = (double)(end - start) * 1e-6;
+        if (r > 0 && (*best_ms == 0.0 || ms < *best_ms)) {
+            *best_ms = ms;
+        }
+    }
+    return CL_SUCCESS;
+}
+
+static cl_int measure_bandwidth(cl_context context, cl_device_id device_id, cl_command_queue queue,
+                                cl_program program, double* gbs)
+{
+    cl_ulong max_alloc = 0;
+    cl_int err;
+
+    clGetDeviceInfo(device_id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc), &max_alloc, NULL);
+    size_t bytes = PEAK_BANDWIDTH_MAX_BYTES;
+    if (max_alloc > 0 && bytes > max_alloc) {
+        bytes = (size_t)max_alloc / 16 * 16;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, "peak_bandwidth", &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating kernel peak_bandwidth. Error code: %d\n", err);
+        return err;
+    }
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY, bytes, NULL, &err);
+    cl_mem output = err == CL_SUCCESS ? clCreateBuffer(context, CL_MEM_WRITE_ONLY, bytes, NULL, &err) : NULL;
+    if (err == CL_SUCCESS) {
+        // Touch the input once, so no run pays for the first allocation of the pages.
+        float zero = 0.0f;
+        err = clEnqueueFillBuffer(queue, input, &zero, sizeof(zero), 0, bytes, 0, NULL, NULL);
+    }
+    if (err == CL_SUCCESS) {
+        double ms;
+        size_t global_size = bytes / 16;
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+        clSetKernelArg(kernel, 1, sizeof(cl_mem), &output);
+        err = roofline_time_kernel(queue, kernel, 1, &global_size, NULL, &ms);
+        *gbs = ms > 0.0 ? 2.0 * bytes / (ms * 1e6) : 0.0;
+    } else {
+        printf("[ERROR] Error creating the bandwidth buffers. Error code: %d\n", err);
+    }
+
+    if (input != NULL) clReleaseMemObject(input);
+    if (output != NULL) clReleaseMemObject(output);
+    clReleaseKernel(kernel);
+    return err;
+}
+
+static cl_int measure_compute(cl_context context, cl_command_queue queue, cl_program program, const char* name,
+                              double* gops)
+{
+    cl_int err;
+    size_t global_size = PEAK_FLOPS_WORK_ITEMS;
+
+    cl_kernel kernel = clCreateKernel(program, name, &err);
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Error creating kernel %s. Error code: %d\n", name, err);
+        return err;
+    }
+    cl_mem output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * global_size, NULL, &err);
+    if (err == CL_SUCCESS) {
+        double ms;
+        // a and b are kernel arguments, so the chains cannot be folded at compile time.
+        if (strcmp(name, "peak_iops") == 0) {
+            cl_int a = 3, b = 1;
+            clSetKernelArg(kernel, 1, sizeof(a), &a);
+            clSetKernelArg(kernel, 2, sizeof(b), &b);
+        } else {
+            cl_float a = 0.999f, b = 0.001f;
+            clSetKernelArg(kernel, 1, sizeof(a), &a);
+            clSetKernelArg(kernel, 2, sizeof(b), &b);
+        }
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), &output);
+        err = roofline_time_kernel(queue, kernel, 1, &global_size, NULL, &ms);
+        *gops = ms > 0.0 ? PEAK_OPS_PER_WORK_ITEM * global_size / (ms * 1e6) : 0.0;
+        clReleaseMemObject(output);
+    } else {
+        printf("[ERROR] Error creating the %s buffer. Error code: %d\n", name, err);
+    }
+    clReleaseKernel(kernel);
+    return err;
+}
+
+cl_int roofline_measure_peaks(cl_context context, cl_device_id device_id, cl_command_queue queue,
+                              const char* path, RooflinePeaks* peaks)
+{
+    cl_program program;
+    char options[64];
+    cl_int err;
+
+    memset(peaks, 0, sizeof(RooflinePeaks));
+    snprintf(options, sizeof(options), "-cl-mad-enable -DPEAK_ITERATIONS=%d", ROOFLINE_PEAK_ITERATIONS);
+    err = roofline_build_program(context, device_id, path, options, &program);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    err = measure_bandwidth(context, device_id, queue, program, &peaks->bandwidth_gbs);
+    if (err == CL_SUCCESS) {
+        err = measure_compute(context, queue, program, "peak_flops", &peaks->gflops);
+    }
+    if (err == CL_SUCCESS) {
+        err = measure_compute(context, queue, program, "peak_iops", &peaks->giops);
+    }
+    clReleaseProgram(program);
+    return err;
+}
+
+double roofline_intensity(const RooflineKernel* kernel)
+{
+    return kernel->bytes > 0.0 ? kernel->ops / kernel->bytes : 0.0;
+}
+
+static double compute_roof(const RooflinePeaks* peaks, RooflineOpType type)
+{
+    return type == ROOFLINE_INT ? peaks->giops : peaks->gflops;
+}
+
+double roofline_bound(const RooflinePeaks* peaks, const RooflineKernel* kernel)
+{
+    double memory_roof = roofline_intensity(kernel) * peaks->bandwidth_gbs;
+    double roof = compute_roof(peaks, kernel->type);
+    return memory_roof < roof ? memory_roof : roof;
+}
+
+static double achieved_gops(const RooflineKernel* kernel)
+{
+    return kernel->ms > 0.0 ? kernel->ops / (kernel->ms * 1e6) : 0.0;
+}
+
+static double achieved_gbs(const RooflineKernel* kernel)
+{
+    return kernel->ms > 0.0 ? kernel->bytes / (kernel->ms * 1e6) : 0.0;
+}
+
+static const char* limiter(const RooflinePeaks* peaks, const RooflineKernel* kernel)
+{
+    return roofline_intensity(kernel) * peaks->bandwidth_gbs < compute_roof(peaks, kernel->type) ? "memory" : "compute";
+}
+
+static double percent_of_bound(const RooflinePeaks* peaks, const RooflineKernel* kernel)
+{
+    double bound = roofline_bound(peaks, kernel);
+    return bound > 0.0 ? 100.0 * achieved_gops(kernel) / bound : 0.0;
+}
+
+void roofline_print(FILE* file, const RooflinePeaks* peaks, const RooflineKernel* kernels, int count)
+{
+    fprintf(file, "Peaks: %.1f GB/s, %.1f GFLOP/s, %.1f GIOP/s (ridge points %.2f and %.2f op/byte)\n",
+            peaks->bandwidth_gbs, peaks->gflops, peaks->giops,
+            peaks->bandwidth_gbs > 0.0 ? peaks->gflops / peaks->bandwidth_gbs : 0.0,
+            peaks->bandwidth_gbs > 0.0 ? peaks->giops / peaks->bandwidth_gbs : 0.0);
+    fprintf(file, "%-22s %5s %12s %12s %9s %10s %10s %10s %10s %7s %8s\n", "kernel", "type", "Gop", "GB",
+            "op/byte", "ms", "GOP/s", "GB/s", "bound", "%bound", "limit");
+    for (int i = 0; i < count; i++) {
+        const RooflineKernel* kernel = &kernels[i];
+        fprintf(file, "%-22s %5s %12.4f %12.4f %9.3f %10.3f %10.2f %10.2f %10.2f %6.1f%% %8s\n",
+                kernel->name, kernel->type == ROOFLINE_INT ? "int" : "float", kernel->ops / 1e9, kernel->bytes / 1e9,
+                roofline_intensity(kernel), kernel->ms, achieved_gops(kernel), achieved_gbs(kernel),
+                roofline_bound(peaks, kernel), percent_of_bound(peaks, kernel), limiter(peaks, kernel));
+    }
+}
+
+void roofline_write_csv(FILE* file, const RooflinePeaks* peaks, const RooflineKernel* kernels, int count)
+{
+    fprintf(file, "# peak_gbs=%.3f,peak_gflops=%.3f,peak_giops=%.3f\n",
+            peaks->bandwidth_gbs, peaks->gflops, peaks->giops);
+    fprintf(file, "kernel,type,ops,bytes,intensity,ms,gops,gbs,bound_gops,percent_of_bound,limit\n");
+    for (int i = 0; i < count; i++) {
+        const RooflineKernel* kernel = &kernels[i];
+        fprintf(file, "%s,%s,%.0f,%.0f,%.6f,%.6f,%.6f,%.6f,%.6f,%.3f,%s\n",
+                kernel->name, kernel->type == ROOFLINE_INT ? "int" : "float", kernel->ops, kernel->bytes,
+                roofline_intensity(kernel), kernel->ms, achieved_gops(kernel), achieved_gbs(kernel),
+                roofline_bound(peaks, kernel), percent_of_bound(peaks, kernel), limiter(peaks, kernel));
+    }
+}
+
+typedef struct {
+    double x_min, x_max;
+    double y_min, y_max;
+} PlotRange;
+
+static double plot_x(const PlotRange* range, double intensity)
+{
+    double t = (log2(intensity) - log2(range->x_min)) / (log2(range->x_max) - log2(range->x_min));
+    return SVG_LEFT + t * (SVG_WIDTH - SVG_LEFT - SVG_RIGHT);
+}
+
+static double plot_y(const PlotRange* range, double gops)
+{
+    double t = (log10(gops) - log10(range->y_min)) / (log10(range->y_max) - log10(range->y_min));
+    return SVG_HEIGHT - SVG_BOTTOM - t * (SVG_HEIGHT - SVG_TOP - SVG_BOTTOM);
+}
+
+static void svg_roof(FILE* file, const PlotRange* range, double bandwidth, double roof, const char* label,
+                     const char* dash)
+{
+    double ridge = roof / bandwidth;
+    double x_start = range->x_min;
+    // The slope starts where it enters the plot.
+    if (bandwidth * x_start < range->y_min) {
+        x_start = range->y_min / bandwidth;
+    }
+    fprintf(file, "<polyline fill=\"none\" stroke=\"#333\" stroke-width=\"2\"%s points=\"%.1f,%.1f %.1f,%.1f %.1f,%.1f\"/>\n",
+            dash, plot_x(range, x_start), plot_y(range, bandwidth * x_start), plot_x(range, ridge),
+            plot_y(range, roof), plot_x(range, range->x_max), plot_y(range, roof));
+    fprintf(file, "<text x=\"%.1f\" y=\"%.1f\" font-size=\"12\" text-anchor=\"end\">%s %.1f</text>\n",
+            plot_x(range, range->x_max) - 4, plot_y(range, roof) - 6, label, roof);
+}
+
+void roofline_write_svg(FILE* file, const RooflinePeaks* peaks, const RooflineKernel* kernels, int count)
+{
+    PlotRange range = {1.0 / 16.0, 256.0, 0.0, 0.0};
+    double top = peaks->gflops > peaks->giops ? peaks->gflops : peaks->giops;
+    double bottom = peaks->bandwidth_gbs * range.x_min;
+
+    if (peaks->bandwidth_gbs <= 0.0 || top <= 0.0) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        double intensity = roofline_intensity(&kernels[i]);
+        double gops = achieved_gops(&kernels[i]);
+        while (intensity > 0.0 && intensity < range.x_min) {
+            range.x_min /= 2.0;
+        }
+        while (intensity > range.x_max) {
+            range.x_max *= 2.0;
+        }
+        if (gops > 0.0 && gops < bottom) {
+            bottom = gops;
+        }
+    }
+    bottom = peaks->bandwidth_gbs * range.x_min < bottom ? peaks->bandwidth_gbs * range.x_min : bottom;
+    range.y_min = pow(10.0, floor(log10(bottom)));
+    range.y_max = pow(10.0, ceil(log10(top * 1.5)));
+
+    fprintf(file, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" font-family=\"sans-serif\">\n",
+            SVG_WIDTH, SVG_HEIGHT);
+    fprintf(file, "<rect width=\"100%%\" height=\"100%%\" fill=\"white\"/>\n");
+    fprintf(file, "<text x=\"%d\" y=\"24\" font-size=\"16\" text-anchor=\"middle\">Roofline (%.1f GB/s)</text>\n",
+            SVG_WIDTH / 2, peaks->bandwidth_gbs);
+
+    // Grid: every power of two of the intensity, every decade of the throughput.
+    for (double x = range.x_min; x <= range.x_max * 1.001; x *= 2.0) {
+        double px = plot_x(&range, x);
+        fprintf(file, "<line x1=\"%.1f\" y1=\"%d\" x2=\"%.1f\" y2=\"%d\" stroke=\"#ddd\"/>\n",
+                px, SVG_TOP, px, SVG_HEIGHT - SVG_BOTTOM);
+        fprintf(file, "<text x=\"%.1f\" y=\"%d\" font-size=\"11\" text-anchor=\"middle\">%g</text>\n",
+                px, SVG_HEIGHT - SVG_BOTTOM + 16, x);
+    }
+    for (double y = range.y_min; y <= range.y_max * 1.001; y *= 10.0) {
+        double py = plot_y(&range, y);
+        fprintf(file, "<line x1=\"%d\" y1=\"%.1f\" x2=\"%d\" y2=\"%.1f\" stroke=\"#ddd\"/>\n",
+                SVG_LEFT, py, SVG_WIDTH - SVG_RIGHT, py);
+        fprintf(file, "<text x=\"%d\" y=\"%.1f\" font-size=\"11\" text-anchor=\"end\">%g</text>\n",
+                SVG_LEFT - 6, py + 4, y);
+    }
+    fprintf(file, "<text x=\"%d\" y=\"%d\" font-size=\"13\" text-anchor=\"middle\">operations / byte</text>\n",
+            (SVG_LEFT + SVG_WIDTH - SVG_RIGHT) / 2, SVG_HEIGHT - 20);
+    fprintf(file, "<text x=\"20\" y=\"%d\" font-size=\"13\" text-anchor=\"middle\" transform=\"rotate(-90 20 %d)\">GOP/s</text>\n",
+            (SVG_TOP + SVG_HEIGHT - SVG_BOTTOM) / 2, (SVG_TOP + SVG_HEIGHT - SVG_BOTTOM) / 2);
+
+    svg_roof(file, &range, peaks->bandwidth_gbs, peaks->gflops, "GFLOP/s", "");
+    svg_roof(file, &range, peaks->bandwidth_gbs, peaks->giops, "GIOP/s", " stroke-dasharray=\"6,4\"");
+
+    for (int i = 0; i < count; i++) {
+        double intensity = roofline_intensity(&kernels[i]);
+        double gops = achieved_gops(&kernels[i]);
+        if (intensity <= 0.0 || gops <= 0.0) {
+            continue;
+        }
+        double px = plot_x(&range, intensity);
+        double py = plot_y(&range, gops);
+        fprintf(file, "<circle cx=\"%.1f\" cy=\"%.1f\" r=\"5\" fill=\"%s\"/>\n",
+                px, py, kernels[i].type == ROOFLINE_INT ? "#e67e22" : "#2e86c1");
+        fprintf(file, "<text x=\"%.1f\" y=\"%.1f\" font-size=\"12\">%s (%.0f%%)</text>\n",
+                px + 8, py + 4, kernels[i].name, percent_of_bound(peaks, &kernels[i]));
+    }
+    fprintf(file, "</svg>\n");
+}
@@ -0,0 +1,34 @@
+#ifndef PEAK_ITERATIONS
+#define PEAK_ITERATIONS 256
+#endif
+
+// Device memory bandwidth: one float4 load and one store per work-item.
+__kernel void peak_bandwidth(__global const float4* input, __global float4* output)
+{
+    size_t i = get_global_id(0);
+    output[i] = input[i];
+}
+
+// Eight independent mad chains on four lanes, so the latency of one chain
+// is hidden by the others: 8 * 4 * 2 operations per iteration.
+#define PEAK_BODY(type)                                                      \
+    type x0 = (type)(get_global_id(0)) * b;                                 \
+    type x1 = x0 + b, x2 = x0 - b, x3 = x1 + b;                             \
+    type x4 = x2 - b, x5 = x3 + b, x6 = x4 - b, x7 = x5 + b;                \
+    for (int i = 0; i < PEAK_ITERATIONS; i++) {                             \
+        x0 = x0 * a + b; x1 = x1 * a + b; x2 = x2 * a + b; x3 = x3 * a + b; \
+        x4 = x4 * a + b; x5 = x5 * a + b; x6 = x6 * a + b; x7 = x7 * a + b; \
+    }                                                                       \
+    type sum = ((x0 + x1) + (x2 + x3)) + ((x4 + x5) + (x6 + x7));
+
+__kernel void peak_flops(__global float* output, float a, float b)
+{
+    PEAK_BODY(float4)
+    output[get_global_id(0)] = sum.s0 + sum.s1 + sum.s2 + sum.s3;
+}
+
+__kernel void peak_iops(__global int* output, int a, int b)
+{
+    PEAK_BODY(int4)
+    output[get_global_id(0)] = sum.s0 + sum.s1 + sum.s2 + sum.s3;
+}
@@ -0,0 +1,85 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#define CL_TARGET_OPENCL_VERSION 220
+#include <CL/cl.h>
+
+#include <stdio.h>
+
+#define ROOFLINE_PEAK_ITERATIONS 256
+#define ROOFLINE_REPEATS 5
+
+typedef enum {
+    ROOFLINE_FLOAT,
+    ROOFLINE_INT
+} RooflineOpType;
+
+/**
+ * Peaks of the device, measured by the microbenchmark kernels of
+ * roofline.cl. Integer and floating point kernels are placed under their
+ * own compute roof, the memory roof is shared.
+ */
+typedef struct {
+    double bandwidth_gbs;
+    double gflops;
+    double giops;
+} RooflinePeaks;
+
+/**
+ * One measured kernel. ops and bytes are declared per kernel from its
+ * launch size (or counted by the kernel), bytes are the global memory
+ * requests of the kernel: caches may serve part of them.
+ */
+typedef struct {
+    const char* name;
+    RooflineOpType type;
+    double ops;
+    double bytes;
+    double ms;
+} RooflineKernel;
+
+/**
+ * Build a program from a kernel source file, printing the build log on
+ * failure.
+ *
+ * options: Build options (may be NULL)
+ */
+cl_int roofline_build_program(cl_context context, cl_device_id device_id, const char* path, const char* options,
+                              cl_program* program);
+
+/**
+ * Run a kernel ROOFLINE_REPEATS times (its arguments already set) and
+ * return the shortest execution time in milliseconds.
+ *
+ * local_size: NULL lets the runtime choose
+ */
+cl_int roofline_time_kernel(cl_command_queue queue, cl_kernel kernel, cl_uint work_dim, const size_t* global_size,
+                            const size_t* local_size, double* best_ms);
+
+/**
+ * Run the microbenchmarks, each ROOFLINE_REPEATS times, keeping the best.
+ *
+ * path: Path of roofline.cl
+ *
+ * Returns CL_SUCCESS or the OpenCL error code of the failing call
+ */
+cl_int roofline_measure_peaks(cl_context context, cl_device_id device_id, cl_command_queue queue,
+                              const char* path, RooflinePeaks* peaks);
+
+double roofline_intensity(const RooflineKernel* kernel);
+
+/**
+ * Attainable GOP/s at the intensity of the kernel:
+ * min(compute roof, intensity * bandwidth).
+ */
+double roofline_bound(const RooflinePeaks* peaks, const RooflineKernel* kernel);
+
+void roofline_print(FILE* file, const RooflinePeaks* peaks, const RooflineKernel* kernels, int count);
+void roofline_write_csv(FILE* file, const RooflinePeaks* peaks, const RooflineKernel* kernels, int count);
+
+/**
+ * Log-log roofline plot: the roofs as lines, the kernels as labelled points.
+ */
+void roofline_write_svg(FILE* file, const RooflinePeaks* peaks, const RooflineKernel* kernels, int count);
+
+#endif
@@ -0,0 +1,358 @@
+#include "protocol.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char* socket_path = SERVICE_SOCKET_PATH;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static int read_full(int fd, void* buffer, size_t size)
+{
+    unsigned char* p = (unsigned char*)buffer;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void* buffer, size_t size)
+{
+    const unsigned char* p = (const unsigned char*)buffer;
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int connect_service(void)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Send one job and wait for its result.
+ *
+ * result: Newly allocated result payload, the caller frees it
+ *
+ * Returns 0 on success, -1 on a connection error
+ */
+static int request(int fd, JobType type, uint32_t job_id, uint32_t param, const void* payload, size_t size,
+                   ResultHeader* header, unsigned char** result)
+{
+    JobHeader job = {SERVICE_MAGIC, (uint32_t)type, job_id, param, size};
+
+    if (write_full(fd, &job, sizeof(job)) != 0 || (size > 0 && write_full(fd, payload, size) != 0)) {
+        return -1;
+    }
+    if (read_full(fd, header, sizeof(ResultHeader)) != 0 || header->magic != SERVICE_MAGIC) {
+        return -1;
+    }
+    *result = (unsigned char*)malloc(header->payload_size + 1);
+    if (read_full(fd, *result, header->payload_size) != 0) {
+        free(*result);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Random payload of the given job type. The size is the vector length,
+ * matrix dimension, number of bytes or number of keys.
+ */
+static void* make_payload(JobType type, uint32_t size, size_t* payload_size)
+{
+    size_t count;
+    switch (type) {
+    case JOB_VECTOR_ADD:
+        count = 2 * (size_t)size;
+        break;
+    case JOB_GEMM:
+        count = 2 * (size_t)size * size;
+        break;
+    case JOB_SORT:
+        count = size;
+        break;
+    default: {
+        unsigned char* text = (unsigned char*)malloc(size + 1);
+        for (uint32_t i = 0; i < size; i++) {
+            text[i] = (unsigned char)('A' + rand() % 26);
+        }
+        *payload_size = size;
+        return text;
+    }
+    }
+
+    *payload_size = count * 4;
+    if (type == JOB_SORT) {
+        int* keys = (int*)malloc(*payload_size + 4);
+        for (size_t i = 0; i < count; i++) {
+            keys[i] = rand();
+        }
+        return keys;
+    }
+    float* values = (float*)malloc(*payload_size + 4);
+    for (size_t i = 0; i < count; i++) {
+        values[i] = (float)rand() / (float)RAND_MAX;
+    }
+    return values;
+}
+
+static int check_result(JobType type, uint32_t size, const void* payload, const unsigned char* result)
+{
+    if (type == JOB_VECTOR_ADD) {
+        const float* A = (const float*)payload;
+        const float* C = (const float*)result;
+        for (uint32_t i = 0; i < size; i++) {
+            if (fabsf(C[i] - (A[i] + A[size + i])) > 1e-5f) {
+                return 0;
+            }
+        }
+    } else if (type == JOB_SORT) {
+        const int* keys = (const int*)result;
+        for (uint32_t i = 1; i < size; i++) {
+            if (keys[i - 1] > keys[i]) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static JobType parse_type(const char* name)
+{
+    if (strcmp(name, "vector") == 0) return JOB_VECTOR_ADD;
+    if (strcmp(name, "gemm") == 0) return JOB_GEMM;
+    if (strcmp(name, "huffman") == 0) return JOB_HUFFMAN_ENCODE;
+    if (strcmp(name, "sort") == 0) return JOB_SORT;
+    if (strcmp(name, "stats") == 0) return JOB_STATS;
+    return (JobType)0;
+}
+
+static int run_single(JobType type, uint32_t size)
+{
+    int fd = connect_service();
+    if (fd < 0) {
+        fprintf(stderr, "Nem sikerult csatlakozni: %s\n", socket_path);
+        return 1;
+    }
+
+    size_t payload_size = 0;
+    void* payload = type == JOB_STATS ? NULL : make_payload(type, size, &payload_size);
+    uint32_t param = type == JOB_HUFFMAN_ENCODE ? 0 : size;
+    ResultHeader header;
+    unsigned char* result;
+    int ok = 1;
+
+    double start = now_ms();
+    if (request(fd, type, 1, param, payload, payload_size, &header, &result) != 0) {
+        fprintf(stderr, "Kapcsolati hiba\n");
+        close(fd);
+        free(payload);
+        return 1;
+    }
+    double elapsed = now_ms() - start;
+
+    if (type == JOB_STATS) {
+        printf("%s", (const char*)result);
+    } else if (type == JOB_HUFFMAN_ENCODE && header.status == 0) {
+        // Korbe: a kodolt folyamot visszakuldjuk dekodolasra.
+        ResultHeader decoded_header;
+        unsigned char* decoded;
+        const HuffmanStreamHeader* stream = (const HuffmanStreamHeader*)result;
+        printf("huffman: %u -> %llu bajt (%.3f bit/szimbolum), %.3f ms\n", size,
+               (unsigned long long)(header.payload_size - sizeof(HuffmanStreamHeader)),
+               size ? (double)stream->bit_count / size : 0.0, elapsed);
+        if (request(fd, JOB_HUFFMAN_DECODE, 2, 0, result, header.payload_size, &decoded_header, &decoded) == 0) {
+            ok = decoded_header.status == 0 && decoded_header.payload_size == size
+                 && memcmp(decoded, payload, size) == 0;
+            printf("dekodolas: %s\n", ok ? "OK" : "HIBAS");
+            free(decoded);
+        } else {
+            fprintf(stderr, "Kapcsolati hiba\n");
+            ok = 0;
+        }
+    } else {
+        ok = header.status == 0 && check_result(type, size, payload, result);
+        printf("%s: status %d, %.3f ms (szolgaltatas: %.3f ms, batch: %u), eredmeny %s\n",
+               type == JOB_VECTOR_ADD ? "vector" : type == JOB_GEMM ? "gemm" : "sort",
+               header.status, elapsed, header.service_us / 1000.0, header.batch_size, ok ? "OK" : "HIBAS");
+    }
+
+    free(result);
+    free(payload);
+    close(fd);
+    return ok ? 0 : 1;
+}
+
+typedef struct {
+    JobType type;
+    uint32_t size;
+    int jobs;
+    double* latencies;
+    int completed;
+    int errors;
+    unsigned long batched;
+} LoadWorker;
+
+static void* load_worker(void* arg)
+{
+    LoadWorker* worker = (LoadWorker*)arg;
+    int fd = connect_service();
+    if (fd < 0) {
+        worker->errors = worker->jobs;
+        return NULL;
+    }
+
+    size_t payload_size;
+    void* payload = make_payload(worker->type, worker->size, &payload_size);
+    uint32_t param = worker->type == JOB_HUFFMAN_ENCODE ? 0 : worker->size;
+
+    for (int i = 0; i < worker->jobs; i++) {
+        ResultHeader header;
+        unsigned char* result;
+        double start = now_ms();
+        if (request(fd, worker->type, (uint32_t)i, param, payload, payload_size, &header, &result) != 0) {
+            worker->errors += worker->jobs - i;
+            break;
+        }
+        worker->latencies[worker->completed++] = now_ms() - start;
+        worker->errors += header.status != 0;
+        worker->batched += header.batch_size > 1;
+        free(result);
+    }
+
+    free(payload);
+    close(fd);
+    return NULL;
+}
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Load generator: every thread keeps one job in flight on its own
+ * connection, so the number of threads is the offered concurrency.
+ */
+static int run_load(int threads, int jobs, JobType type, uint32_t size)
+{
+    pthread_t* ids = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+    LoadWorker* workers = (LoadWorker*)calloc(threads, sizeof(LoadWorker));
+
+    double start = now_ms();
+    for (int t = 0; t < threads; t++) {
+        workers[t].type = type;
+        workers[t].size = size;
+        workers[t].jobs = jobs;
+        workers[t].latencies = (double*)malloc(sizeof(double) * jobs);
+        pthread_create(&ids[t], NULL, load_worker, &workers[t]);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    double elapsed = now_ms() - start;
+
+    int completed = 0;
+    int errors = 0;
+    unsigned long batched = 0;
+    for (int t = 0; t < threads; t++) {
+        completed += workers[t].completed;
+        errors += workers[t].errors;
+        batched += workers[t].batched;
+    }
+    double* latencies = (double*)malloc(sizeof(double) * (completed > 0 ? completed : 1));
+    int k = 0;
+    for (int t = 0; t < threads; t++) {
+        memcpy(latencies + k, workers[t].latencies, sizeof(double) * workers[t].completed);
+        k += workers[t].completed;
+        free(workers[t].latencies);
+    }
+    qsort(latencies, completed, sizeof(double), compare_double);
+
+    printf("szalak: %d, feladat: %d, hiba: %d, batch-ben: %lu\n", threads, completed, errors, batched);
+    if (completed > 0) {
+        printf("atbocsatas: %.1f feladat/s\n", completed / (elapsed / 1000.0));
+        printf("kesleltetes ms: p50 %.3f, p95 %.3f, p99 %.3f, max %.3f\n",
+               latencies[completed / 2], latencies[(int)(completed * 0.95)],
+               latencies[(int)(completed * 0.99)], latencies[completed - 1]);
+    }
+
+    free(latencies);
+    free(workers);
+    free(ids);
+    return errors > 0;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* env_path = getenv("SERVICE_SOCKET");
+    if (env_path != NULL) {
+        socket_path = env_path;
+    }
+    srand((unsigned int)time(NULL));
+
+    if (argc >= 2 && strcmp(argv[1], "load") == 0 && argc >= 6) {
+        JobType type = parse_type(argv[4]);
+        if (type == 0 || type == JOB_STATS) {
+            fprintf(stderr, "Ismeretlen feladat: %s\n", argv[4]);
+            return 1;
+        }
+        return run_load(atoi(argv[2]), atoi(argv[3]), type, (uint32_t)atoi(argv[5]));
+    }
+
+    if (argc >= 2) {
+        JobType type = parse_type(argv[1]);
+        if (type != 0) {
+            return run_single(type, argc >= 3 ? (uint32_t)atoi(argv[2]) : 1024);
+        }
+    }
+
+    printf("Hasznalat: %s vector|gemm|huffman|sort [meret]\n", argv[0]);
+    printf("           %s stats\n", argv[0]);
+    printf("           %s load <szalak> <feladat/szal> vector|gemm|huffman|sort <meret>\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,55 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+
+#define SERVICE_SOCKET_PATH "/tmp/parhuzamos_service.sock"
+#define SERVICE_MAGIC 0x4f50434cu
+
+/**
+ * Job types. The payload of every request and response follows its header
+ * directly on the socket, all values are in host byte order.
+ *
+ * JOB_VECTOR_ADD   param: n, payload: A[n], B[n] floats        -> C[n] floats
+ * JOB_GEMM         param: N, payload: A[N*N], B[N*N] floats    -> C[N*N] floats
+ * JOB_HUFFMAN_ENCODE        payload: raw bytes                 -> HuffmanStreamHeader + packed bits
+ * JOB_HUFFMAN_DECODE        payload: HuffmanStreamHeader + bits -> raw bytes
+ * JOB_SORT         param: n, payload: int32[n]                 -> int32[n] ascending
+ * JOB_STATS                 no payload                         -> text table of the counters
+ */
+typedef enum {
+    JOB_VECTOR_ADD = 1,
+    JOB_GEMM = 2,
+    JOB_HUFFMAN_ENCODE = 3,
+    JOB_HUFFMAN_DECODE = 4,
+    JOB_SORT = 5,
+    JOB_STATS = 6,
+    JOB_TYPE_COUNT
+} JobType;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t type;
+    uint32_t job_id;
+    uint32_t param;
+    uint64_t payload_size;
+} JobHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t job_id;
+    int32_t status;
+    uint32_t batch_size;
+    uint64_t payload_size;
+    uint64_t service_us;
+} ResultHeader;
+
+typedef struct {
+    uint32_t original_size;
+    uint32_t reserved;
+    uint64_t bit_count;
+    int32_t codes[256];
+    uint8_t code_lengths[256];
+} HuffmanStreamHeader;
+
+#endif
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Korbeutas a szolgaltatason: a szerver egy ideiglenes socketen indul, a
+# kliens minden feladattipust egyszer elkuld es ellenoriz, vegul a szerver leall.
+# Hasznalat: roundtrip_test.sh <szerver> <kliens>
+# A szerver a ../matrixok, ../vektorok stb. kernelfajlokat tolti be, ezert a
+# service konyvtarbol kell futtatni.
+
+server="$1"
+client="$2"
+socket="${TMPDIR:-/tmp}/parhuzamos_test_$$.sock"
+
+"$server" "$socket" &
+pid=$!
+trap 'kill $pid 2>/dev/null; wait $pid 2>/dev/null; rm -f "$socket"' EXIT
+
+# A socket a kernelek forditasa utan jon letre.
+tries=0
+while [ ! -S "$socket" ]; do
+    tries=$((tries + 1))
+    if [ $tries -gt 600 ] || ! kill -0 $pid 2>/dev/null; then
+        echo "A szolgaltatas nem indult el" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+status=0
+for job in "vector 100000" "gemm 256" "huffman 100000" "sort 1000"; do
+    SERVICE_SOCKET="$socket" "$client" $job || status=1
+done
+exit $status
@@ -0,0 +1,731 @@
+#include "protocol.h"
+#include "gemm.h"
+#include "device_pool.h"
+#include "kernel_loader.h"
+#include "huffman_tree.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_CLIENTS 64
+#define MAX_PENDING 256
+#define DEFAULT_BATCH_WINDOW_MS 1
+#define MAX_PAYLOAD ((uint64_t)INT_MAX)
+#define MAX_GEMM_SIZE 16384
+#define SORT_BATCH_LIMIT 65536
+
+/**
+ * Everything that stays warm between jobs: the GEMM context owns the
+ * OpenCL context, the queue and the device pool, the other programs are
+ * built into the same context once at startup.
+ */
+typedef struct {
+    GemmContext gemm;
+    cl_program vector_program;
+    cl_kernel vector_kernel;
+    cl_program huffman_program;
+    cl_kernel frequencies_kernel;
+    cl_kernel encode_kernel;
+    cl_program sort_program;
+    cl_kernel sort_kernel;
+} Service;
+
+typedef struct {
+    int fd;
+    JobHeader header;
+    unsigned char* payload;
+    double received_ms;
+} Job;
+
+typedef struct {
+    unsigned long jobs;
+    unsigned long batches;
+    unsigned long errors;
+    double total_latency_ms;
+    double max_latency_ms;
+    unsigned long long bytes_in;
+    unsigned long long bytes_out;
+} JobCounters;
+
+static const char* job_names[JOB_TYPE_COUNT] = {
+    "?", "vector_add", "gemm", "huffman_enc", "huffman_dec", "sort", "stats"
+};
+
+static JobCounters counters[JOB_TYPE_COUNT];
+static double service_start_ms;
+static volatile sig_atomic_t running = 1;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static void stop_service(int sig)
+{
+    (void)sig;
+    running = 0;
+}
+
+static int write_full(int fd, const void* buffer, size_t size)
+{
+    const unsigned char* p = (const unsigned char*)buffer;
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static cl_int build_program(Service* service, const char* path, cl_program* program)
+{
+    cl_int err;
+    int error_code;
+
+    char* source = load_kernel_source(path, &error_code);
+    if (error_code != 0) {
+        fprintf(stderr, "Nem sikerult betolteni a kernelt: %s\n", path);
+        return CL_INVALID_VALUE;
+    }
+    *program = clCreateProgramWithSource(service->gemm.context, 1, (const char**)&source, NULL, &err);
+    free(source);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    err = clBuildProgram(*program, 1, &service->gemm.device_id, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        size_t log_size;
+        clGetProgramBuildInfo(*program, service->gemm.device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+        char* log = (char*)malloc(log_size);
+        clGetProgramBuildInfo(*program, service->gemm.device_id, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
+        fprintf(stderr, "%s build log:\n%s\n", path, log);
+        free(log);
+    }
+    return err;
+}
+
+static cl_int service_init(Service* service)
+{
+    cl_int err;
+
+    memset(service, 0, sizeof(Service));
+    err = gemm_init(&service->gemm, "../matrixok/matrix.cl");
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    if ((err = build_program(service, "../vektorok/sample.cl", &service->vector_program)) != CL_SUCCESS) return err;
+    if ((err = build_program(service, "../huffman/huffman.cl", &service->huffman_program)) != CL_SUCCESS) return err;
+    if ((err = build_program(service, "../randomsort/randomsort.cl", &service->sort_program)) != CL_SUCCESS) return err;
+
+    service->vector_kernel = clCreateKernel(service->vector_program, "sample_kernel", &err);
+    if (err != CL_SUCCESS) return err;
+    service->frequencies_kernel = clCreateKernel(service->huffman_program, "calculate_frequencies", &err);
+    if (err != CL_SUCCESS) return err;
+    service->encode_kernel = clCreateKernel(service->huffman_program, "encode_input", &err);
+    if (err != CL_SUCCESS) return err;
+    service->sort_kernel = clCreateKernel(service->sort_program, "bitonic_sort_step", &err);
+    return err;
+}
+
+static void service_release(Service* service)
+{
+    if (service->vector_kernel) clReleaseKernel(service->vector_kernel);
+    if (service->frequencies_kernel) clReleaseKernel(service->frequencies_kernel);
+    if (service->encode_kernel) clReleaseKernel(service->encode_kernel);
+    if (service->sort_kernel) clReleaseKernel(service->sort_kernel);
+    if (service->vector_program) clReleaseProgram(service->vector_program);
+    if (service->huffman_program) clReleaseProgram(service->huffman_program);
+    if (service->sort_program) clReleaseProgram(service->sort_program);
+    gemm_release(&service->gemm);
+}
+
+static void send_result(Job* job, cl_int status, const void* payload, size_t size, uint32_t batch_size)
+{
+    ResultHeader result;
+    double latency = now_ms() - job->received_ms;
+    JobCounters* counter = &counters[job->header.type < JOB_TYPE_COUNT ? job->header.type : 0];
+
+    result.magic = SERVICE_MAGIC;
+    result.job_id = job->header.job_id;
+    result.status = status;
+    result.batch_size = batch_size;
+    result.payload_size = status == CL_SUCCESS ? size : 0;
+    result.service_us = (uint64_t)(latency * 1e3);
+
+    if (write_full(job->fd, &result, sizeof(result)) == 0 && result.payload_size > 0) {
+        write_full(job->fd, payload, size);
+    }
+
+    counter->jobs++;
+    counter->errors += status != CL_SUCCESS;
+    counter->total_latency_ms += latency;
+    if (latency > counter->max_latency_ms) {
+        counter->max_latency_ms = latency;
+    }
+    counter->bytes_in += job->header.payload_size;
+    counter->bytes_out += result.payload_size;
+}
+
+/**
+ * Every pending vector addition is concatenated into one A and one B
+ * buffer and computed with a single sample_kernel launch.
+ */
+static void run_vector_batch(Service* service, Job** jobs, int count)
+{
+    cl_int err;
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += jobs[i]->header.param;
+    }
+    size_t bytes = sizeof(float) * total;
+
+    float* C = (float*)malloc(bytes > 0 ? bytes : 1);
+    cl_mem d_A = NULL;
+    cl_mem d_B = NULL;
+    cl_mem d_C = NULL;
+    if (C == NULL) {
+        err = CL_OUT_OF_HOST_MEMORY;
+    } else {
+        d_A = pool_acquire(&service->gemm.pool, bytes, &err);
+        d_B = err == CL_SUCCESS ? pool_acquire(&service->gemm.pool, bytes, &err) : NULL;
+        d_C = err == CL_SUCCESS ? pool_acquire(&service->gemm.pool, bytes, &err) : NULL;
+    }
+
+    size_t offset = 0;
+    for (int i = 0; i < count && err == CL_SUCCESS; i++) {
+        size_t n = jobs[i]->header.param;
+        err = clEnqueueWriteBuffer(service->gemm.command_queue, d_A, CL_FALSE, offset * sizeof(float),
+                                   n * sizeof(float), jobs[i]->payload, 0, NULL, NULL);
+        err |= clEnqueueWriteBuffer(service->gemm.command_queue, d_B, CL_FALSE, offset * sizeof(float),
+                                    n * sizeof(float), jobs[i]->payload + n * sizeof(float), 0, NULL, NULL);
+        offset += n;
+    }
+
+    if (err == CL_SUCCESS && total > 0) {
+        err = clSetKernelArg(service->vector_kernel, 0, sizeof(cl_mem), &d_A);
+        err |= clSetKernelArg(service->vector_kernel, 1, sizeof(cl_mem), &d_B);
+        err |= clSetKernelArg(service->vector_kernel, 2, sizeof(cl_mem), &d_C);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueNDRangeKernel(service->gemm.command_queue, service->vector_kernel, 1, NULL, &total, NULL, 0, NULL, NULL);
+        }
+        if (err == CL_SUCCESS) {
+            err = clEnqueueReadBuffer(service->gemm.command_queue, d_C, CL_TRUE, 0, bytes, C, 0, NULL, NULL);
+        }
+    }
+    clFinish(service->gemm.command_queue);
+    counters[JOB_VECTOR_ADD].batches++;
+
+    offset = 0;
+    for (int i = 0; i < count; i++) {
+        size_t n = jobs[i]->header.param;
+        send_result(jobs[i], err, err == CL_SUCCESS ? C + offset : NULL, n * sizeof(float), (uint32_t)count);
+        offset += n;
+    }
+
+    if (d_A) pool_release(&service->gemm.pool, d_A);
+    if (d_B) pool_release(&service->gemm.pool, d_B);
+    if (d_C) pool_release(&service->gemm.pool, d_C);
+    free(C);
+}
+
+/**
+ * Every pending sort job is padded with INT_MAX to the same power of two
+ * segment and the whole batch is sorted by one bitonic network.
+ */
+static void run_sort_batch(Service* service, Job** jobs, int count)
+{
+    cl_int err = CL_SUCCESS;
+    int segment = 1;
+    for (int i = 0; i < count; i++) {
+        while ((uint32_t)segment < jobs[i]->header.param) {
+            segment *= 2;
+        }
+    }
+    size_t total = (size_t)segment * count;
+    int* data = (int*)malloc(sizeof(int) * total);
+    if (data == NULL) {
+        for (int i = 0; i < count; i++) {
+            send_result(jobs[i], CL_OUT_OF_HOST_MEMORY, NULL, 0, (uint32_t)count);
+        }
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        size_t n = jobs[i]->header.param;
+        memcpy(data + (size_t)i * segment, jobs[i]->payload, n * sizeof(int));
+        for (size_t j = n; j < (size_t)segment; j++) {
+            data[(size_t)i * segment + j] = INT_MAX;
+        }
+    }
+
+    if (segment > 1) {
+        cl_mem d_data = pool_acquire(&service->gemm.pool, sizeof(int) * total, &err);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueWriteBuffer(service->gemm.command_queue, d_data, CL_FALSE, 0, sizeof(int) * total, data, 0, NULL, NULL);
+            err |= clSetKernelArg(service->sort_kernel, 0, sizeof(cl_mem), &d_data);
+            err |= clSetKernelArg(service->sort_kernel, 3, sizeof(int), &segment);
+            for (int k = 2; k <= segment && err == CL_SUCCESS; k *= 2) {
+                for (int j = k / 2; j > 0 && err == CL_SUCCESS; j /= 2) {
+                    err = clSetKernelArg(service->sort_kernel, 1, sizeof(int), &j);
+                    err |= clSetKernelArg(service->sort_kernel, 2, sizeof(int), &k);
+                    err |= clEnqueueNDRangeKernel(service->gemm.command_queue, service->sort_kernel, 1, NULL, &total, NULL, 0, NULL, NULL);
+                }
+            }
+            if (err == CL_SUCCESS) {
+                err = clEnqueueReadBuffer(service->gemm.command_queue, d_data, CL_TRUE, 0, sizeof(int) * total, data, 0, NULL, NULL);
+            }
+            clFinish(service->gemm.command_queue);
+            pool_release(&service->gemm.pool, d_data);
+        }
+    }
+    counters[JOB_SORT].batches++;
+
+    for (int i = 0; i < count; i++) {
+        send_result(jobs[i], err, data + (size_t)i * segment, jobs[i]->header.param * sizeof(int), (uint32_t)count);
+    }
+    free(data);
+}
+
+static void run_gemm(Service* service, Job* job)
+{
+    int size = (int)job->header.param;
+    int N = gemm_padded_size(size);
+    size_t padded = (size_t)N * N;
+    const float* A_in = (const float*)job->payload;
+    const float* B_in = A_in + (size_t)size * size;
+
+    float* A = (float*)calloc(padded, sizeof(float));
+    float* B = (float*)calloc(padded, sizeof(float));
+    float* C = (float*)malloc(sizeof(float) * padded);
+    if (A == NULL || B == NULL || C == NULL) {
+        send_result(job, CL_OUT_OF_HOST_MEMORY, NULL, 0, 1);
+        free(A);
+        free(B);
+        free(C);
+        return;
+    }
+    for (int i = 0; i < size; i++) {
+        memcpy(A + (size_t)i * N, A_in + (size_t)i * size, sizeof(float) * size);
+        memcpy(B + (size_t)i * N, B_in + (size_t)i * size, sizeof(float) * size);
+    }
+
+    cl_int err = gemm_run(&service->gemm, GEMM_FP32, A, B, C, N, NULL);
+    counters[JOB_GEMM].batches++;
+
+    // The padding is dropped in place: row i moves to i * size.
+    for (int i = 0; i < size; i++) {
+        memmove(C + (size_t)i * size, C + (size_t)i * N, sizeof(float) * size);
+    }
+    send_result(job, err, C, sizeof(float) * (size_t)size * size, 1);
+
+    free(A);
+    free(B);
+    free(C);
+}
+
+static void run_huffman_encode(Service* service, Job* job)
+{
+    cl_int err;
+    int input_size = (int)job->header.payload_size;
+    int frequencies[256] = {0};
+    HuffmanStreamHeader header;
+    memset(&header, 0, sizeof(header));
+    header.original_size = (uint32_t)input_size;
+
+    cl_command_queue queue = service->gemm.command_queue;
+    DevicePool* pool = &service->gemm.pool;
+    size_t global_work_size = input_size;
+    int* encoded_data = (int*)malloc(sizeof(int) * (input_size > 0 ? input_size : 1));
+    if (encoded_data == NULL) {
+        send_result(job, CL_OUT_OF_HOST_MEMORY, NULL, 0, 1);
+        return;
+    }
+
+    cl_mem input_buffer = pool_acquire(pool, input_size > 0 ? input_size : 1, &err);
+    cl_mem frequencies_buffer = err == CL_SUCCESS ? pool_acquire(pool, sizeof(int) * 256, &err) : NULL;
+    cl_mem codes_buffer = err == CL_SUCCESS ? pool_acquire(pool, sizeof(int) * 256, &err) : NULL;
+    cl_mem lengths_buffer = err == CL_SUCCESS ? pool_acquire(pool, 256, &err) : NULL;
+    cl_mem encoded_buffer = err == CL_SUCCESS ? pool_acquire(pool, sizeof(int) * (input_size > 0 ? input_size : 1), &err) : NULL;
+
+    if (err == CL_SUCCESS && input_size > 0) {
+        err = clEnqueueWriteBuffer(queue, input_buffer, CL_FALSE, 0, input_size, job->payload, 0, NULL, NULL);
+        err |= clEnqueueWriteBuffer(queue, frequencies_buffer, CL_FALSE, 0, sizeof(int) * 256, frequencies, 0, NULL, NULL);
+        err |= clSetKernelArg(service->frequencies_kernel, 0, sizeof(cl_mem), &input_buffer);
+        err |= clSetKernelArg(service->frequencies_kernel, 1, sizeof(cl_mem), &frequencies_buffer);
+        err |= clSetKernelArg(service->frequencies_kernel, 2, sizeof(int), &input_size);
+        err |= clEnqueueNDRangeKernel(queue, service->frequencies_kernel, 1, NULL, &global_work_size, NULL, 0, NULL, NULL);
+        err |= clEnqueueReadBuffer(queue, frequencies_buffer, CL_TRUE, 0, sizeof(int) * 256, frequencies, 0, NULL, NULL);
+    }
+    if (err == CL_SUCCESS && input_size > 0) {
+        buildHuffmanCodes(frequencies, header.codes, header.code_lengths);
+        err = clEnqueueWriteBuffer(queue, codes_buffer, CL_FALSE, 0, sizeof(int) * 256, header.codes, 0, NULL, NULL);
+        err |= clEnqueueWriteBuffer(queue, lengths_buffer, CL_FALSE, 0, 256, header.code_lengths, 0, NULL, NULL);
+        err |= clSetKernelArg(service->encode_kernel, 0, sizeof(cl_mem), &input_buffer);
+        err |= clSetKernelArg(service->encode_kernel, 1, sizeof(cl_mem), &codes_buffer);
+        err |= clSetKernelArg(service->encode_kernel, 2, sizeof(cl_mem), &lengths_buffer);
+        err |= clSetKernelArg(service->encode_kernel, 3, sizeof(cl_mem), &encoded_buffer);
+        err |= clSetKernelArg(service->encode_kernel, 4, sizeof(int), &input_size);
+        err |= clEnqueueNDRangeKernel(queue, service->encode_kernel, 1, NULL, &global_work_size, NULL, 0, NULL, NULL);
+        err |= clEnqueueReadBuffer(queue, encoded_buffer, CL_TRUE, 0, sizeof(int) * input_size, encoded_data, 0, NULL, NULL);
+    }
+    clFinish(queue);
+    counters[JOB_HUFFMAN_ENCODE].batches++;
+
+    size_t packed_size = packedHuffmanSize(job->payload, input_size, header.code_lengths);
+    unsigned char* output = (unsigned char*)calloc(sizeof(header) + packed_size + 1, 1);
+    if (output == NULL) {
+        send_result(job, CL_OUT_OF_HOST_MEMORY, NULL, 0, 1);
+    } else {
+        if (err == CL_SUCCESS) {
+            header.bit_count = packHuffmanBits(encoded_data, job->payload, input_size, header.code_lengths, output + sizeof(header));
+        }
+        memcpy(output, &header, sizeof(header));
+        send_result(job, err, output, sizeof(header) + packed_size, 1);
+    }
+
+    if (input_buffer) pool_release(pool, input_buffer);
+    if (frequencies_buffer) pool_release(pool, frequencies_buffer);
+    if (codes_buffer) pool_release(pool, codes_buffer);
+    if (lengths_buffer) pool_release(pool, lengths_buffer);
+    if (encoded_buffer) pool_release(pool, encoded_buffer);
+    free(encoded_data);
+    free(output);
+}
+
+// A dekodolas bitsoros, ezt a host vegzi.
+static void run_huffman_decode(Job* job)
+{
+    HuffmanStreamHeader header;
+    if (job->header.payload_size < sizeof(header)) {
+        send_result(job, CL_INVALID_VALUE, NULL, 0, 1);
+        return;
+    }
+    memcpy(&header, job->payload, sizeof(header));
+    // A kodhosszak a klienstol jonnek: 31 bitnel hosszabb kod nem lehet (mint a readHuffmanBlocks-ban).
+    for (int s = 0; s < 256; s++) {
+        if (header.code_lengths[s] > 31) {
+            send_result(job, CL_INVALID_VALUE, NULL, 0, 1);
+            return;
+        }
+    }
+    // Minden szimbolum legalabb egy bit, igy a kimenet merete a bitszamot sem haladhatja meg.
+    if ((header.bit_count + 7) / 8 > job->header.payload_size - sizeof(header)
+        || header.original_size > MAX_PAYLOAD || header.original_size > header.bit_count) {
+        send_result(job, CL_INVALID_VALUE, NULL, 0, 1);
+        return;
+    }
+
+    unsigned char* output = (unsigned char*)malloc((size_t)header.original_size + 1);
+    if (output == NULL) {
+        send_result(job, CL_OUT_OF_HOST_MEMORY, NULL, 0, 1);
+        return;
+    }
+    int status = decodeHuffmanBits(job->payload + sizeof(header), header.bit_count,
+                                   header.codes, header.code_lengths, output, (int)header.original_size);
+    counters[JOB_HUFFMAN_DECODE].batches++;
+    if (status == 0) {
+        send_result(job, CL_SUCCESS, output, header.original_size, 1);
+    } else {
+        send_result(job, CL_INVALID_VALUE, NULL, 0, 1);
+    }
+    free(output);
+}
+
+static void run_stats(Service* service, Job* job)
+{
+    char text[4096];
+    int length = 0;
+    double uptime_s = (now_ms() - service_start_ms) / 1000.0;
+
+    length += snprintf(text + length, sizeof(text) - length,
+                       "%-12s %8s %8s %7s %12s %12s %10s %10s\n",
+                       "job", "count", "batches", "errors", "avg lat ms", "max lat ms", "jobs/s", "MB in");
+    for (int t = 1; t < JOB_TYPE_COUNT; t++) {
+        JobCounters* c = &counters[t];
+        length += snprintf(text + length, sizeof(text) - length,
+                           "%-12s %8lu %8lu %7lu %12.3f %12.3f %10.1f %10.2f\n",
+                           job_names[t], c->jobs, c->batches, c->errors,
+                           c->jobs ? c->total_latency_ms / c->jobs : 0.0, c->max_latency_ms,
+                           uptime_s > 0 ? c->jobs / uptime_s : 0.0, c->bytes_in / 1048576.0);
+    }
+    DevicePool* pool = &service->gemm.pool;
+    length += snprintf(text + length, sizeof(text) - length,
+                       "device pool: %lu acquires, %lu reused, peak %.1f MB, reserved %.1f MB\n",
+                       pool->acquire_count, pool->reuse_count,
+                       pool->peak_bytes / 1048576.0, pool->reserved_bytes / 1048576.0);
+    send_result(job, CL_SUCCESS, text, (size_t)length + 1, 1);
+}
+
+static int validate_job(const JobHeader* header)
+{
+    uint64_t n = header->param;
+    switch (header->type) {
+    // n is bounded first, so the products below cannot wrap around.
+    case JOB_VECTOR_ADD:
+        return n > 0 && n <= MAX_PAYLOAD / (2 * sizeof(float)) && header->payload_size == 2 * n * sizeof(float);
+    case JOB_GEMM:
+        return n > 0 && n <= MAX_GEMM_SIZE && n * n <= MAX_PAYLOAD / (2 * sizeof(float))
+            && header->payload_size == 2 * n * n * sizeof(float);
+    case JOB_SORT:
+        return n <= (1u << 26) && header->payload_size == n * sizeof(int);
+    case JOB_HUFFMAN_ENCODE:
+    case JOB_HUFFMAN_DECODE:
+    case JOB_STATS:
+        return 1;
+    }
+    return 0;
+}
+
+static void process_pending(Service* service, Job* pending, int count)
+{
+    Job* batch[MAX_PENDING];
+    int batch_count;
+
+    batch_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (pending[i].header.type == JOB_VECTOR_ADD) {
+            batch[batch_count++] = &pending[i];
+        }
+    }
+    if (batch_count > 0) {
+        run_vector_batch(service, batch, batch_count);
+    }
+
+    // Small sorts share one padded launch, large ones would only inflate the padding.
+    batch_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (pending[i].header.type != JOB_SORT) {
+            continue;
+        }
+        if (pending[i].header.param <= SORT_BATCH_LIMIT) {
+            batch[batch_count++] = &pending[i];
+        } else {
+            Job* single = &pending[i];
+            run_sort_batch(service, &single, 1);
+        }
+    }
+    if (batch_count > 0) {
+        run_sort_batch(service, batch, batch_count);
+    }
+
+    for (int i = 0; i < count; i++) {
+        switch (pending[i].header.type) {
+        case JOB_GEMM:
+            run_gemm(service, &pending[i]);
+            break;
+        case JOB_HUFFMAN_ENCODE:
+            run_huffman_encode(service, &pending[i]);
+            break;
+        case JOB_HUFFMAN_DECODE:
+            run_huffman_decode(&pending[i]);
+            break;
+        case JOB_STATS:
+            run_stats(service, &pending[i]);
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(pending[i].payload);
+    }
+}
+
+/**
+ * A connected client and the job it is sending. The socket is read
+ * without blocking, so a client that sends slowly or stalls in the middle
+ * of a job holds only its own state, not the service thread.
+ */
+typedef struct {
+    Job job;
+    size_t received;
+} Client;
+
+static void reset_client(Client* client, int fd)
+{
+    memset(client, 0, sizeof(Client));
+    client->job.fd = fd;
+}
+
+/**
+ * Read what a readable client has sent so far. Returns 1 when the job is
+ * complete, 0 when more data is needed and -1 when the client is gone or
+ * sent something that is not a valid job.
+ */
+static int receive_job(Client* client)
+{
+    Job* job = &client->job;
+    for (;;) {
+        unsigned char* target;
+        size_t remaining;
+        if (client->received < sizeof(JobHeader)) {
+            target = (unsigned char*)&job->header + client->received;
+            remaining = sizeof(JobHeader) - client->received;
+        } else {
+            size_t offset = client->received - sizeof(JobHeader);
+            if (offset == job->header.payload_size) {
+                return 1;
+            }
+            target = job->payload + offset;
+            remaining = job->header.payload_size - offset;
+        }
+
+        ssize_t n = recv(job->fd, target, remaining, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        client->received += (size_t)n;
+
+        if (client->received == sizeof(JobHeader)) {
+            job->received_ms = now_ms();
+            if (job->header.magic != SERVICE_MAGIC || job->header.type == 0 || job->header.type >= JOB_TYPE_COUNT
+                || job->header.payload_size > MAX_PAYLOAD || !validate_job(&job->header)) {
+                return -1;
+            }
+            job->payload = (unsigned char*)malloc(job->header.payload_size + 1);
+            if (job->payload == NULL) {
+                return -1;
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* socket_path = SERVICE_SOCKET_PATH;
+    int batch_window_ms = DEFAULT_BATCH_WINDOW_MS;
+
+    if (argc > 1) {
+        socket_path = argv[1];
+    }
+    if (argc > 2) {
+        batch_window_ms = atoi(argv[2]);
+    }
+
+    Service service;
+    if (service_init(&service) != CL_SUCCESS) {
+        fprintf(stderr, "A szolgaltatas inicializalasa nem sikerult\n");
+        service_release(&service);
+        return 1;
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+    unlink(socket_path);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0
+        || listen(listen_fd, MAX_CLIENTS) != 0) {
+        perror("socket");
+        service_release(&service);
+        return 1;
+    }
+
+    signal(SIGINT, stop_service);
+    signal(SIGTERM, stop_service);
+    service_start_ms = now_ms();
+    printf("Szolgaltatas fut: %s (batch ablak: %d ms)\n", socket_path, batch_window_ms);
+    fflush(stdout);
+
+    struct pollfd fds[MAX_CLIENTS + 1];
+    // clients[i] belongs to fds[i + 1].
+    Client clients[MAX_CLIENTS];
+    int client_count = 0;
+    Job* pending = (Job*)malloc(sizeof(Job) * MAX_PENDING);
+    if (pending == NULL) {
+        fprintf(stderr, "Nincs eleg memoria\n");
+        close(listen_fd);
+        unlink(socket_path);
+        service_release(&service);
+        return 1;
+    }
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+
+    while (running) {
+        int pending_count = 0;
+        int timeout = -1;
+
+        // The first wait blocks, the second one collects concurrent jobs for the batch.
+        for (int round = 0; round < 2 && running; round++) {
+            int ready = poll(fds, client_count + 1, timeout);
+            if (ready <= 0) {
+                break;
+            }
+            if (fds[0].revents & POLLIN) {
+                int client = accept(listen_fd, NULL, NULL);
+                if (client >= 0 && client_count < MAX_CLIENTS) {
+                    fds[client_count + 1].fd = client;
+                    fds[client_count + 1].events = POLLIN;
+                    fds[client_count + 1].revents = 0;
+                    reset_client(&clients[client_count], client);
+                    client_count++;
+                } else if (client >= 0) {
+                    close(client);
+                }
+            }
+            for (int i = 1; i <= client_count; i++) {
+                if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)) || pending_count == MAX_PENDING) {
+                    continue;
+                }
+                fds[i].revents = 0;
+                Client* client = &clients[i - 1];
+                int status = receive_job(client);
+                if (status == 1) {
+                    // The payload now belongs to the pending job.
+                    pending[pending_count++] = client->job;
+                    reset_client(client, fds[i].fd);
+                } else if (status < 0) {
+                    free(client->job.payload);
+                    close(fds[i].fd);
+                    fds[i] = fds[client_count];
+                    clients[i - 1] = clients[client_count - 1];
+                    client_count--;
+                    i--;
+                }
+            }
+            timeout = batch_window_ms;
+        }
+
+        if (pending_count > 0) {
+            process_pending(&service, pending, pending_count);
+        }
+    }
+
+    for (int i = 1; i <= client_count; i++) {
+        free(clients[i - 1].job.payload);
+        close(fds[i].fd);
+    }
+    close(listen_fd);
+    unlink(socket_path);
+    free(pending);
+    service_release(&service);
+    return 0;
+}
@@ -1,12 +1,308 @@
 #include "kernel_loader.h"
+#include "numa_topology.h"
 #define CL_TARGET_OPENCL_VERSION 220
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <CL/cl.h>
+#ifndef DEVICE_TYPE
+#define DEVICE_TYPE CL_DEVICE_TYPE_GPU
+#endif
 
 const int SAMPLE_SIZE = 20000000;
 
-int main(void)
+#define NUMA_REPEATS 5
+#define NUMA_LOCAL_SIZE 64
+
+static double nowMs(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static double eventMs(cl_event event)
+{
+    cl_ulong start, end;
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+    return (end - start) * 1e-6;
+}
+
+/**
+ * The vectors of one NUMA node: elements [start, start + count) of A, B and C,
+ * allocated untouched and first written by a thread of the node.
+ */
+typedef struct {
+    int start;
+    int count;
+    float* A;
+    float* B;
+    float* C;
+    cl_command_queue queue;
+    cl_kernel kernel;
+    cl_mem buffers[3];
+} NumaPartition;
+
+static void touchPartition(int node, void* arg)
+{
+    NumaPartition* part = (NumaPartition*)arg;
+    (void)node;
+    for (int i = 0; i < part->count; i++) {
+        part->A[i] = part->start + i;
+        part->B[i] = part->start + i + 1;
+        part->C[i] = 0.0f;
+    }
+}
+
+static int checkPartition(const NumaPartition* part)
+{
+    cl_int err;
+    float* C = (float*)clEnqueueMapBuffer(part->queue, part->buffers[2], CL_TRUE, CL_MAP_READ, 0,
+                                          sizeof(float) * part->count, 0, NULL, NULL, &err);
+    if (err != CL_SUCCESS) {
+        return 0;
+    }
+    int correct = 1;
+    for (int i = 0; i < part->count && correct; i++) {
+        correct = C[i] == part->A[i] + part->B[i];
+    }
+    clEnqueueUnmapMemObject(part->queue, part->buffers[2], C, 0, NULL, NULL);
+    clFinish(part->queue);
+    return correct;
+}
+
+/**
+ * Run the kernel on the first node_count partitions at once and return the
+ * best wall time in ms. kernel_ms gets the kernel time of every partition.
+ */
+static double runPartitions(NumaPartition* parts, int node_count, double* kernel_ms, cl_int* err)
+{
+    double best = 0.0;
+    for (int r = 0; r <= NUMA_REPEATS; r++) {
+        cl_event events[NUMA_MAX_NODES];
+        double start = nowMs();
+        for (int node = 0; node < node_count; node++) {
+            size_t global_size = parts[node].count;
+            size_t local_size = NUMA_LOCAL_SIZE;
+            *err = clEnqueueNDRangeKernel(parts[node].queue, parts[node].kernel, 1, NULL, &global_size, &local_size, 0, NULL, &events[node]);
+            if (*err != CL_SUCCESS) {
+                for (int i = 0; i < node; i++) {
+                    clWaitForEvents(1, &events[i]);
+                    clReleaseEvent(events[i]);
+                }
+                return 0.0;
+            }
+            clFlush(parts[node].queue);
+        }
+        clWaitForEvents(node_count, events);
+        double elapsed = nowMs() - start;
+        for (int node = 0; node < node_count; node++) {
+            // The first run only warms up.
+            if (r == 1 || (r > 1 && elapsed < best)) {
+                kernel_ms[node] = eventMs(events[node]);
+            }
+            clReleaseEvent(events[node]);
+        }
+        if (r == 1 || (r > 1 && elapsed < best)) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+static double bandwidth(long long elements, double ms)
+{
+    // A and B read, C written
+    return 3.0 * sizeof(float) * elements / (ms * 1e6);
+}
+
+/**
+ * The default placement (malloc, initialized by one thread, whole device)
+ * and the NUMA aware one (one sub-device and node local vectors per node).
+ */
+static int runNuma(cl_device_id device_id, const char* kernel_code)
+{
+    NumaTopology topology;
+    NumaPartition parts[NUMA_MAX_NODES];
+    cl_device_id sub_devices[NUMA_MAX_NODES];
+    cl_uint sub_device_count = 0;
+    cl_int err;
+    int result = 1;
+
+    numa_detect(&topology);
+    numa_print(&topology);
+    memset(parts, 0, sizeof(parts));
+
+    // Default: pages of the whole vectors on the node of the main thread.
+    size_t bytes = sizeof(float) * SAMPLE_SIZE;
+    float* A = (float*)malloc(bytes);
+    float* B = (float*)malloc(bytes);
+    float* C = (float*)malloc(bytes);
+    if (A == NULL || B == NULL || C == NULL) {
+        printf("[ERROR] Memory allocation failed\n");
+        free(A);
+        free(B);
+        free(C);
+        return 1;
+    }
+    NumaPartition whole = {0, SAMPLE_SIZE, A, B, C};
+    touchPartition(0, &whole);
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    cl_program program = NULL;
+    double default_ms = 0.0;
+    double kernel_ms[NUMA_MAX_NODES];
+    if (err == CL_SUCCESS) {
+        program = clCreateProgramWithSource(context, 1, &kernel_code, NULL, &err);
+    }
+    if (err == CL_SUCCESS) {
+        err = clBuildProgram(program, 1, &device_id, "", NULL, NULL);
+    }
+    if (err == CL_SUCCESS) {
+        whole.queue = clCreateCommandQueue(context, device_id, CL_QUEUE_PROFILING_ENABLE, &err);
+    }
+    if (err == CL_SUCCESS) {
+        whole.kernel = clCreateKernel(program, "sample_kernel", &err);
+    }
+    for (int i = 0; i < 3 && err == CL_SUCCESS; i++) {
+        float* host = i == 0 ? A : (i == 1 ? B : C);
+        whole.buffers[i] = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, bytes, host, &err);
+        if (err == CL_SUCCESS) {
+            err = clSetKernelArg(whole.kernel, i, sizeof(cl_mem), &whole.buffers[i]);
+        }
+    }
+    if (err == CL_SUCCESS) {
+        default_ms = runPartitions(&whole, 1, kernel_ms, &err);
+    }
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] Default run failed. Error code: %d\n", err);
+        goto cleanup;
+    }
+    printf("default: %.3f ms, %.2f GB/s %s\n", default_ms, bandwidth(SAMPLE_SIZE, default_ms),
+           checkPartition(&whole) ? "OK" : "WRONG");
+
+    err = numa_create_sub_devices(device_id, sub_devices, NUMA_MAX_NODES, &sub_device_count);
+    if (err != CL_SUCCESS || sub_device_count < 2) {
+        printf("The device cannot be partitioned by NUMA node (error code: %d, sub-devices: %u)\n", err, sub_device_count);
+        result = 0;
+        goto cleanup;
+    }
+    int node_count = (int)sub_device_count < topology.node_count ? (int)sub_device_count : topology.node_count;
+    if (node_count != topology.node_count || (int)sub_device_count != topology.node_count) {
+        printf("%u sub-devices for %d nodes, using %d\n", sub_device_count, topology.node_count, node_count);
+    }
+
+    // Node local vectors: equal index ranges (multiples of the work-group size) per node.
+    int chunk = (SAMPLE_SIZE / node_count + NUMA_LOCAL_SIZE - 1) / NUMA_LOCAL_SIZE * NUMA_LOCAL_SIZE;
+    void* args[NUMA_MAX_NODES];
+    for (int node = 0; node < node_count; node++) {
+        NumaPartition* part = &parts[node];
+        part->start = node * chunk;
+        part->count = node == node_count - 1 ? SAMPLE_SIZE - part->start : chunk;
+        part->A = (float*)numa_alloc(sizeof(float) * part->count);
+        part->B = (float*)numa_alloc(sizeof(float) * part->count);
+        part->C = (float*)numa_alloc(sizeof(float) * part->count);
+        if (part->A == NULL || part->B == NULL || part->C == NULL) {
+            printf("[ERROR] Memory allocation failed\n");
+            goto cleanup_nodes;
+        }
+        args[node] = part;
+    }
+    if (numa_run_on_nodes(&topology, node_count, touchPartition, args) != 0) {
+        printf("[ERROR] Could not start the first touch threads\n");
+        goto cleanup_nodes;
+    }
+
+    cl_context numa_context = clCreateContext(NULL, node_count, sub_devices, NULL, NULL, &err);
+    cl_program numa_program = NULL;
+    if (err == CL_SUCCESS) {
+        numa_program = clCreateProgramWithSource(numa_context, 1, &kernel_code, NULL, &err);
+    }
+    if (err == CL_SUCCESS) {
+        err = clBuildProgram(numa_program, node_count, sub_devices, "", NULL, NULL);
+    }
+    for (int node = 0; node < node_count && err == CL_SUCCESS; node++) {
+        NumaPartition* part = &parts[node];
+        size_t part_bytes = sizeof(float) * part->count;
+        part->queue = clCreateCommandQueue(numa_context, sub_devices[node], CL_QUEUE_PROFILING_ENABLE, &err);
+        if (err == CL_SUCCESS) {
+            part->kernel = clCreateKernel(numa_program, "sample_kernel", &err);
+        }
+        for (int i = 0; i < 3 && err == CL_SUCCESS; i++) {
+            float* host = i == 0 ? part->A : (i == 1 ? part->B : part->C);
+            part->buffers[i] = clCreateBuffer(numa_context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, part_bytes, host, &err);
+            if (err == CL_SUCCESS) {
+                err = clSetKernelArg(part->kernel, i, sizeof(cl_mem), &part->buffers[i]);
+            }
+        }
+    }
+
+    // Scaling: the first 1, 2, ... nodes each work on their own partition.
+    for (int used = 1; used <= node_count && err == CL_SUCCESS; used++) {
+        long long elements = 0;
+        for (int node = 0; node < used; node++) {
+            elements += parts[node].count;
+        }
+        double ms = runPartitions(parts, used, kernel_ms, &err);
+        if (err != CL_SUCCESS) {
+            break;
+        }
+        printf("%d node(s): %.3f ms, %.2f GB/s\n", used, ms, bandwidth(elements, ms));
+        for (int node = 0; node < used; node++) {
+            printf("    node %d: %.2f GB/s\n", topology.node_ids[node], bandwidth(parts[node].count, kernel_ms[node]));
+        }
+        if (used == node_count) {
+            printf("NUMA aware: %.2fx the default bandwidth\n", bandwidth(elements, ms) / bandwidth(SAMPLE_SIZE, default_ms));
+        }
+    }
+    if (err != CL_SUCCESS) {
+        printf("[ERROR] NUMA run failed. Error code: %d\n", err);
+    } else {
+        int correct = 1;
+        for (int node = 0; node < node_count; node++) {
+            correct &= checkPartition(&parts[node]);
+        }
+        printf("NUMA results %s\n", correct ? "OK" : "WRONG");
+        result = !correct;
+    }
+
+    for (int node = 0; node < node_count; node++) {
+        for (int i = 0; i < 3; i++) {
+            if (parts[node].buffers[i] != NULL) clReleaseMemObject(parts[node].buffers[i]);
+        }
+        if (parts[node].kernel != NULL) clReleaseKernel(parts[node].kernel);
+        if (parts[node].queue != NULL) clReleaseCommandQueue(parts[node].queue);
+    }
+    if (numa_program != NULL) clReleaseProgram(numa_program);
+    if (numa_context != NULL) clReleaseContext(numa_context);
+
+cleanup_nodes:
+    for (int node = 0; node < node_count; node++) {
+        numa_free(parts[node].A, sizeof(float) * parts[node].count);
+        numa_free(parts[node].B, sizeof(float) * parts[node].count);
+        numa_free(parts[node].C, sizeof(float) * parts[node].count);
+    }
+
+cleanup:
+    for (cl_uint i = 0; i < sub_device_count; i++) {
+        clReleaseDevice(sub_devices[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        if (whole.buffers[i] != NULL) clReleaseMemObject(whole.buffers[i]);
+    }
+    if (whole.kernel != NULL) clReleaseKernel(whole.kernel);
+    if (whole.queue != NULL) clReleaseCommandQueue(whole.queue);
+    if (program != NULL) clReleaseProgram(program);
+    if (context != NULL) clReleaseContext(context);
+    free(A);
+    free(B);
+    free(C);
+    return result;
+}
+
+int main(int argc, char* argv[])
 {
     float *A = (float *)malloc(SAMPLE_SIZE * sizeof(float));
     float *B = (float *)malloc(SAMPLE_SIZE * sizeof(float));
@@ -42,7 +338,7 @@ int main(void)
     cl_uint n_devices;
     err = clGetDeviceIDs(
         platform_id,
-        CL_DEVICE_TYPE_GPU,
+        DEVICE_TYPE,
         1,
         &device_id,
         &n_devices);
@@ -66,6 +362,17 @@ int main(void)
         free(C);
         return 0;
     }
+
+    // "numa": default vs. NUMA aware placement on a CPU device
+    if (argc > 1 && strcmp(argv[1], "numa") == 0) {
+        free(A);
+        free(B);
+        free(C);
+        clReleaseContext(context);
+        int result = runNuma(device_id, kernel_code);
+        free((char *)kernel_code);
+        return result;
+    }
     cl_program program = clCreateProgramWithSource(context, 1, &kernel_code, NULL, NULL);
     const char options[] = "";
     err = clBuildProgram(
@@ -147,9 +454,15 @@ int main(void)
 
     err = clEnqueueNDRangeKernel(command_queue, kernel, 1, NULL, &global_size, &local_size, 0, NULL, &event);
     clFinish(command_queue);
-    err = clEnqueueReadBuffer(command_queue, bufferC, CL_TRUE, 0, sizeof(float)*SAMPLE_SIZE, C, 0, NULL, NULL);
+    if (err == CL_SUCCESS) {
+        err = clEnqueueReadBuffer(command_queue, bufferC, CL_TRUE, 0, sizeof(float)*SAMPLE_SIZE, C, 0, NULL, NULL);
+    }
 
-    printf("lefutott");
+    int correct = err == CL_SUCCESS;
+    for (i = 0; i < SAMPLE_SIZE && correct; i++) {
+        correct = C[i] == A[i] + B[i];
+    }
+    printf("lefutott: %s\n", correct ? "OK" : "WRONG");
 
     clReleaseMemObject(bufferA);
     clReleaseMemObject(bufferB);
@@ -163,5 +476,5 @@ int main(void)
     free(B);
     free(C);
 
-    return 0;
+    return correct ? 0 : 1;
 }
\ No newline at end of file